@@ -1,8 +1,48 @@
 #include <benchmark/benchmark.h>
+#include "column_pool.h"
 #include "world.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+#include <random>
+#include <thread>
+
 using namespace nid;
 
+namespace {
+std::atomic<usize> allocation_count{0}; ///< The number of calls to the global `operator new`.
+std::atomic<usize> allocation_bytes{0}; ///< The number of bytes requested from the global `operator new`.
+} // namespace
+
+// Counting replacements of the global allocation functions, used to report allocations per operation
+auto operator new(const std::size_t size) -> void* {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+auto operator new(const std::size_t size, const std::align_val_t alignment) -> void* {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    const auto align = static_cast<std::size_t>(alignment);
+    if (void* ptr = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+auto operator delete(void* ptr) noexcept -> void { std::free(ptr); }
+auto operator delete(void* ptr, std::size_t /*unused*/) noexcept -> void { std::free(ptr); }
+auto operator delete(void* ptr, std::align_val_t /*unused*/) noexcept -> void { std::free(ptr); }
+auto operator delete(void* ptr, std::size_t /*unused*/, std::align_val_t /*unused*/) noexcept -> void { std::free(ptr); }
+
 namespace {
 struct T1 {
     f32 x{0}, y{0};
@@ -43,6 +83,39 @@ class WorldBench : public benchmark::Fixture {
         }
     }
 };
+
+struct Stunned {
+    u32 ticks{0};
+};
+
+struct SparseStunned {
+    using is_sparse = void;
+    u32 ticks{0};
+};
+
+struct EnableableStunned {
+    using is_enableable = void;
+    u32 ticks{0};
+};
+
+struct Enemy {};
+
+template<usize N>
+struct Flag {};
+
+template<usize N>
+struct Wide {
+    f32 x{0};
+};
+
+/// Spawns one entity for every mask in `[0, count)`, with the `Wide` components selected by the bits of the mask.
+template<usize... Is>
+auto spawn_archetypes(World& world, const usize count, std::index_sequence<Is...> /*unused*/) -> void {
+    for (usize mask{0}; mask < count; ++mask) {
+        const auto entity = world.spawn();
+        (..., ((mask >> Is & 1) != 0 ? world.add(entity, Wide<Is>{}) : void()));
+    }
+}
 } // namespace
 
 static void BM_world_spawn(benchmark::State& state) {
@@ -93,4 +166,536 @@ BENCHMARK_DEFINE_F(WorldBench, add_full_overlap)
     }
 }
 
-BENCHMARK_REGISTER_F(WorldBench, add_full_overlap);
\ No newline at end of file
+BENCHMARK_REGISTER_F(WorldBench, add_full_overlap);
+static void BM_world_spawn_loop(benchmark::State& state) {
+    T1 t1{.x = 1, .y = 1};
+    T2 t2{.x = 2, .y = 2, .z = 2, .w = 2};
+    const auto count = static_cast<usize>(state.range(0));
+    const StorageConfig config{.storage = static_cast<ArchetypeStorage>(state.range(1))};
+    for (auto _ : state) {
+        World world(config);
+        for (usize i{0}; i < count; ++i) {
+            world.spawn(t1, t2);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// The second argument is the storage mode: 0 is contiguous, 1 is chunked, 2 is packed
+BENCHMARK(BM_world_spawn_loop)->Args({100'000, 0})->Args({100'000, 1})->Args({100'000, 2});
+
+template<usize... Is>
+static auto spawn_wide(World& world, const usize count, std::index_sequence<Is...> /*unused*/) -> void {
+    if (count == 1) {
+        world.spawn(Wide<Is>{.x = static_cast<f32>(Is)}...);
+    } else {
+        world.spawn_n(count, Wide<Is>{.x = static_cast<f32>(Is)}...);
+    }
+}
+
+static void BM_wide_spawn(benchmark::State& state) {
+    constexpr usize count{100'000};
+    const StorageConfig config{.storage = static_cast<ArchetypeStorage>(state.range(0))};
+    usize allocations{0};
+    for (auto _ : state) {
+        const usize before{allocation_count.load(std::memory_order_relaxed)};
+        World world(config);
+        for (usize i{0}; i < count; ++i) {
+            spawn_wide(world, 1, std::make_index_sequence<12>{});
+        }
+        allocations += allocation_count.load(std::memory_order_relaxed) - before;
+    }
+    state.counters["allocs"] = static_cast<f64>(allocations) / static_cast<f64>(state.iterations());
+    state.SetItemsProcessed(state.iterations() * static_cast<i64>(count));
+}
+
+static void BM_wide_query(benchmark::State& state) {
+    constexpr usize count{1'000'000};
+    World world(StorageConfig{.storage = static_cast<ArchetypeStorage>(state.range(0))});
+    spawn_wide(world, count, std::make_index_sequence<12>{});
+
+    auto query = world.query<Wide<0>, const Wide<4>, const Wide<8>, const Wide<11>>();
+    for (auto _ : state) {
+        query.run([](const usize len, Wide<0>* w0, const Wide<4>* w4, const Wide<8>* w8, const Wide<11>* w11) {
+            for (usize i{0}; i < len; ++i) {
+                w0[i].x += w4[i].x * w8[i].x + w11[i].x;
+            }
+        });
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<i64>(count));
+}
+
+// Archetypes with twelve components, the argument is the storage mode: 0 is contiguous, 1 is chunked, 2 is packed
+BENCHMARK(BM_wide_spawn)->Arg(0)->Arg(1)->Arg(2)->Arg(3)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_wide_query)->Arg(0)->Arg(1)->Arg(2)->Arg(3)->Unit(benchmark::kMillisecond);
+
+static void BM_snapshot_load(benchmark::State& state) {
+    constexpr usize count{1'000'000};
+    const auto path = std::filesystem::temp_directory_path() / "nidavellir_bench.snap";
+    const StorageConfig config{.storage = static_cast<ArchetypeStorage>(state.range(0))};
+    {
+        World world(config);
+        spawn_wide(world, count, std::make_index_sequence<12>{});
+        world.save(path);
+    }
+
+    for (auto _ : state) {
+        World world(config);
+        [&]<usize... Is>(std::index_sequence<Is...> /*unused*/) { world.load<Wide<Is>...>(path); }(std::make_index_sequence<12>{});
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<i64>(count));
+    std::filesystem::remove(path);
+}
+BENCHMARK(BM_snapshot_load)->Arg(0)->Arg(3)->Unit(benchmark::kMillisecond);
+
+static void BM_world_pool(benchmark::State& state) {
+    constexpr usize count{10'000};
+    ColumnPoolResource pool;
+    const StorageConfig config{.resource = state.range(0) != 0 ? static_cast<std::pmr::memory_resource*>(&pool) : std::pmr::get_default_resource()};
+    usize allocations{0};
+    for (auto _ : state) {
+        const usize before{allocation_count.load(std::memory_order_relaxed)};
+        World world(config);
+        for (usize i{0}; i < count; ++i) {
+            spawn_wide(world, 1, std::make_index_sequence<12>{});
+        }
+        allocations += allocation_count.load(std::memory_order_relaxed) - before;
+    }
+    state.counters["allocs"] = static_cast<f64>(allocations) / static_cast<f64>(state.iterations());
+    state.SetItemsProcessed(state.iterations() * static_cast<i64>(count));
+}
+BENCHMARK(BM_world_pool)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+static void BM_fork(benchmark::State& state) {
+    World world;
+    world.spawn_n(100'000, T1{}, T2{});
+    for (auto _ : state) {
+        world.release_fork(world.fork());
+    }
+}
+BENCHMARK(BM_fork);
+
+// Forks, changes 5% of 100k entities and restores: 0 writes a table of its own through a query, 1 writes scattered
+// entities with `get`, 2 despawns scattered entities
+static void BM_fork_cycle(benchmark::State& state) {
+    constexpr usize count{100'000};
+    constexpr usize changed{count / 20};
+    World world;
+    const auto entities = world.spawn_n(count - changed, T1{}, T2{});
+    world.spawn_n(changed, T1{}, T2{}, Enemy{});
+    auto enemies = world.query<T1, const T2, const Enemy>();
+    const ForkId fork{world.fork()};
+
+    usize bytes{0};
+    for (auto _ : state) {
+        const usize before{allocation_bytes.load(std::memory_order_relaxed)};
+        if (state.range(0) == 0) {
+            enemies.run([](const usize len, T1* positions, const T2* velocities, const Enemy*) {
+                for (usize i{0}; i < len; ++i) {
+                    positions[i].x += velocities[i].x;
+                }
+            });
+        } else {
+            for (usize i{0}; i < changed; ++i) {
+                const EntityId entity{entities[i * 7'919 % entities.size()]};
+                if (state.range(0) == 1) {
+                    world.get<T1>(entity).x += 1;
+                } else {
+                    world.despawn(entity);
+                }
+            }
+        }
+        world.restore(fork);
+        bytes += allocation_bytes.load(std::memory_order_relaxed) - before;
+    }
+    state.counters["bytes"] = static_cast<f64>(bytes) / static_cast<f64>(state.iterations());
+    state.SetItemsProcessed(state.iterations() * static_cast<i64>(changed));
+}
+BENCHMARK(BM_fork_cycle)->Arg(0)->Arg(1)->Arg(2)->Unit(benchmark::kMicrosecond);
+
+static void BM_world_spawn_allocations(benchmark::State& state) {
+    T1 t1{.x = 1, .y = 1};
+    T2 t2{.x = 2, .y = 2, .z = 2, .w = 2};
+    const auto count = static_cast<usize>(state.range(0));
+    World world;
+    std::vector<EntityId> entities;
+    entities.reserve(count);
+
+    // Warms up the storage, so the measured spawns only reuse capacity
+    for (usize i{0}; i < count; ++i) {
+        entities.push_back(world.spawn(t1, t2));
+    }
+
+    usize allocations{0};
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (const auto entity : entities) {
+            world.despawn(entity);
+        }
+        entities.clear();
+        const usize before{allocation_count.load(std::memory_order_relaxed)};
+        state.ResumeTiming();
+
+        for (usize i{0}; i < count; ++i) {
+            entities.push_back(world.spawn(t1, t2));
+        }
+
+        state.PauseTiming();
+        allocations += allocation_count.load(std::memory_order_relaxed) - before;
+        state.ResumeTiming();
+    }
+    state.counters["allocs_per_spawn"] = static_cast<f64>(allocations) / static_cast<f64>(state.iterations() * count);
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_world_spawn_allocations)->Arg(10'000);
+
+template<typename Status>
+static void BM_toggle_status(benchmark::State& state) {
+    constexpr usize count{10'000};
+    World world;
+    std::vector<EntityId> entities;
+    for (usize i{0}; i < count; ++i) {
+        entities.push_back(world.spawn(T1{.x = 1, .y = 1}, T2{.x = 2, .y = 2, .z = 2, .w = 2}, T3{.x = 3, .y = 3, .floats = {1, 2, 3}}, T4{.x = 4, .y = 4, .message = "1234"}));
+    }
+
+    for (auto _ : state) {
+        for (const auto entity : entities) {
+            world.add(entity, Status{});
+        }
+        for (const auto entity : entities) {
+            world.remove<Status>(entity);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<i64>(2 * count));
+}
+
+// A table status moves all components of the entity on every toggle, a sparse status moves none and a tag status has no storage of its own
+BENCHMARK(BM_toggle_status<Stunned>);
+BENCHMARK(BM_toggle_status<SparseStunned>);
+BENCHMARK(BM_toggle_status<Enemy>);
+
+static void BM_toggle_enabled(benchmark::State& state) {
+    constexpr usize count{10'000};
+    World world;
+    std::vector<EntityId> entities;
+    for (usize i{0}; i < count; ++i) {
+        entities.push_back(world.spawn(T1{.x = 1, .y = 1}, T2{.x = 2, .y = 2, .z = 2, .w = 2}, T3{.x = 3, .y = 3, .floats = {1, 2, 3}}, T4{.x = 4, .y = 4, .message = "1234"}, EnableableStunned{}));
+    }
+
+    for (auto _ : state) {
+        for (const auto entity : entities) {
+            world.disable<EnableableStunned>(entity);
+        }
+        for (const auto entity : entities) {
+            world.enable<EnableableStunned>(entity);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<i64>(2 * count));
+}
+
+// Disabling only flips a bit, compare with BM_toggle_status
+BENCHMARK(BM_toggle_enabled);
+
+static void BM_query_enabled(benchmark::State& state) {
+    constexpr usize count{1'000'000};
+    World world;
+    const auto entities = world.spawn_n(count, T1{.x = 1, .y = 1}, EnableableStunned{.ticks = 1});
+    // The argument is the number of disabled entities per 1'000, spread evenly
+    const auto disabled = static_cast<usize>(state.range(0));
+    for (usize i{0}; i < count; ++i) {
+        if (disabled > 0 and i % (1'000 / disabled) == 0) {
+            world.disable<EnableableStunned>(entities[i]);
+        }
+    }
+
+    auto query = world.query<T1, const EnableableStunned>();
+    for (auto _ : state) {
+        query.run([](const usize len, T1* t1, const EnableableStunned* stunned) {
+            for (usize i{0}; i < len; ++i) {
+                t1[i].x += static_cast<f32>(stunned[i].ticks);
+            }
+        });
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<i64>(count));
+}
+
+BENCHMARK(BM_query_enabled)->Arg(0)->Arg(10)->Arg(500)->Unit(benchmark::kMillisecond);
+
+static void BM_toggle_tagged(benchmark::State& state) {
+    constexpr usize count{10'000};
+    World world;
+    std::vector<EntityId> entities;
+    for (usize i{0}; i < count; ++i) {
+        entities.push_back(world.spawn(T1{.x = 1, .y = 1}, Flag<0>{}, Flag<1>{}, Flag<2>{}, Flag<3>{}, Flag<4>{}, Flag<5>{}, Flag<6>{}, Flag<7>{}));
+    }
+
+    for (auto _ : state) {
+        for (const auto entity : entities) {
+            world.add(entity, T2{.x = 2, .y = 2, .z = 2, .w = 2});
+        }
+        for (const auto entity : entities) {
+            world.remove<T2>(entity);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<i64>(2 * count));
+}
+
+// Entities with eight tags, the tags are carried along on every move
+BENCHMARK(BM_toggle_tagged);
+
+template<bool Bulk>
+static void BM_add_frozen(benchmark::State& state) {
+    constexpr usize count{200'000};
+    World world;
+    const auto entities = world.spawn_n(count, T1{.x = 1, .y = 1}, T2{.x = 2, .y = 2, .z = 2, .w = 2}, T3{.x = 3, .y = 3, .floats = {1, 2, 3}});
+    auto frozen = world.query<const Stunned>();
+    auto thawed = world.query<const T1>();
+
+    for (auto _ : state) {
+        if constexpr (Bulk) {
+            world.add_all(thawed, Stunned{.ticks = 1});
+            world.remove_all<Stunned>(frozen);
+        } else {
+            for (const auto entity : entities) {
+                world.add(entity, Stunned{.ticks = 1});
+            }
+            for (const auto entity : entities) {
+                world.remove<Stunned>(entity);
+            }
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<i64>(2 * count));
+}
+
+// Adding and removing a component for every entity one by one and table by table
+BENCHMARK(BM_add_frozen<false>)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_add_frozen<true>)->Unit(benchmark::kMillisecond);
+
+static void BM_query_sparse_join(benchmark::State& state) {
+    constexpr usize count{100'000};
+    World world;
+    const auto entities = world.spawn_n(count, T1{.x = 1, .y = 1}, T2{.x = 2, .y = 2, .z = 2, .w = 2});
+    // The argument is the number of entities with the sparse component per 1'000
+    const auto stride = static_cast<usize>(1'000 / state.range(0));
+    for (usize i{0}; i < count; i += stride) {
+        world.add(entities[i], SparseStunned{.ticks = 1});
+    }
+
+    auto query = world.query<const T1, SparseStunned>();
+    for (auto _ : state) {
+        u32 sum{0};
+        query.run([&](const usize, const T1*, SparseStunned* stunned) { sum += stunned->ticks; });
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<i64>(count / stride));
+}
+
+BENCHMARK(BM_query_sparse_join)->Arg(1)->Arg(100)->Arg(1'000);
+
+static void BM_world_spawn_n(benchmark::State& state) {
+    T1 t1{.x = 1, .y = 1};
+    T2 t2{.x = 2, .y = 2, .z = 2, .w = 2};
+    const auto count = static_cast<usize>(state.range(0));
+    for (auto _ : state) {
+        World world;
+        benchmark::DoNotOptimize(world.spawn_n(count, t1, t2));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(BM_world_spawn_n)->Arg(100'000);
+
+// Pushes 500k columns one at a time into a table and reports the slowest push: 0 grows the table in one relocation, 1
+// moves the columns to the grown buffers in steps of 4'096
+static void BM_archetype_push_latency(benchmark::State& state) {
+    CompTypeList infos{get_component_info<T1>(), get_component_info<T2>()};
+    sort_component_list(infos);
+    const usize step{state.range(0) == 0 ? usize{0} : usize{4'096}};
+    f64 worst{0};
+    for (auto _ : state) {
+        Archetype arch(infos, StorageConfig{.migration_step = step});
+        for (usize i{0}; i < 500'000; ++i) {
+            const auto start = std::chrono::steady_clock::now();
+            benchmark::DoNotOptimize(arch.emplace_back(T1{.x = 1, .y = 1}, T2{.x = 2, .y = 2, .z = 2, .w = 2}));
+            worst = std::max(worst, std::chrono::duration<f64, std::micro>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+    state.counters["worst_us"] = worst;
+}
+BENCHMARK(BM_archetype_push_latency)->Arg(0)->Arg(1)->Iterations(5)->Unit(benchmark::kMillisecond);
+
+static void BM_query_run(benchmark::State& state) {
+    World world(StorageConfig{.storage = static_cast<ArchetypeStorage>(state.range(0))});
+    world.spawn_n(2'000'000, T1{.x = 1, .y = 1}, T2{.x = 2, .y = 2, .z = 2, .w = 2});
+    auto query = world.query<T1, T2>();
+    for (auto _ : state) {
+        query.run([](const usize len, T1* t1, T2* t2) {
+            for (usize i{0}; i < len; ++i) {
+                t1[i].x += t2[i].x * t2[i].w;
+                t1[i].y += t2[i].y * t2[i].z;
+            }
+        });
+    }
+    state.SetItemsProcessed(state.iterations() * 2'000'000);
+}
+
+BENCHMARK(BM_query_run)->Arg(0)->Arg(1)->Arg(2)->Unit(benchmark::kMillisecond);
+
+static void BM_query_run_parallel(benchmark::State& state) {
+    ThreadPool pool(static_cast<usize>(state.range(0)));
+    World world;
+    world.set_thread_pool(&pool);
+    world.spawn_n(2'000'000, T1{.x = 1, .y = 1}, T2{.x = 2, .y = 2, .z = 2, .w = 2});
+    auto query = world.query<T1, T2>();
+    for (auto _ : state) {
+        query.run_parallel([](const usize len, T1* t1, T2* t2) {
+            for (usize i{0}; i < len; ++i) {
+                t1[i].x += t2[i].x * t2[i].w;
+                t1[i].y += t2[i].y * t2[i].z;
+            }
+        });
+    }
+    state.SetItemsProcessed(state.iterations() * 2'000'000);
+}
+
+BENCHMARK(BM_query_run_parallel)->RangeMultiplier(2)->Range(1, static_cast<i64>(std::max(1u, std::thread::hardware_concurrency())))->UseRealTime()->Unit(benchmark::kMillisecond);
+
+static void BM_query_changed(benchmark::State& state) {
+    constexpr usize count{1'000'000};
+    World world;
+    const auto entities = world.spawn_n(count, T1{.x = 1, .y = 1}, T2{.x = 2, .y = 2, .z = 2, .w = 2});
+    auto query = world.query<const T1, const T2>();
+    query.filter<Changed<T1>>();
+    query.run([](const usize, const T1*, const T2*) {});
+
+    // The argument is the number of changed entities per 10'000
+    const auto stride = static_cast<usize>(10'000 / state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (usize i{0}; i < count; i += stride) {
+            world.get<T1>(entities[i]).x += 1;
+        }
+        state.ResumeTiming();
+
+        f32 sum{0};
+        query.run([&](const usize len, const T1* t1, const T2* t2) {
+            for (usize i{0}; i < len; ++i) {
+                sum += t1[i].x * t2[i].w;
+            }
+        });
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+BENCHMARK(BM_query_changed)->Arg(1)->Arg(100)->Arg(10'000)->Unit(benchmark::kMicrosecond);
+
+static void BM_query_build(benchmark::State& state) {
+    const auto count = static_cast<usize>(state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto world = std::make_unique<World>();
+        spawn_archetypes(*world, count, std::make_index_sequence<14>{});
+        state.ResumeTiming();
+
+        usize matched{0};
+        world->query<Wide<0>, Wide<3>, Wide<7>>().run([&](const usize len, Wide<0>*, Wide<3>*, Wide<7>*) { matched += len; });
+        benchmark::DoNotOptimize(matched);
+
+        state.PauseTiming();
+        world.reset();
+        state.ResumeTiming();
+    }
+}
+
+// The argument is the number of archetypes
+BENCHMARK(BM_query_build)->Arg(1'000)->Arg(10'000)->Iterations(20)->Unit(benchmark::kMicrosecond);
+
+static void BM_archetype_memory(benchmark::State& state) {
+    const auto count = static_cast<usize>(state.range(0));
+    usize bytes{0};
+    for (auto _ : state) {
+        const usize before{allocation_bytes.load(std::memory_order_relaxed)};
+        auto world = std::make_unique<World>();
+        spawn_archetypes(*world, count, std::make_index_sequence<14>{});
+        bytes += allocation_bytes.load(std::memory_order_relaxed) - before;
+
+        state.PauseTiming();
+        world.reset();
+        state.ResumeTiming();
+    }
+    state.counters["bytes_per_archetype"] = static_cast<f64>(bytes) / static_cast<f64>(state.iterations() * count);
+    state.counters["type_info_bytes"] = static_cast<f64>(sizeof(CompTypeInfo));
+}
+
+// The argument is the number of archetypes
+BENCHMARK(BM_archetype_memory)->Arg(1'000)->Arg(10'000)->Iterations(20)->Unit(benchmark::kMicrosecond);
+
+static void BM_world_get(benchmark::State& state) {
+    constexpr usize count{100'000};
+    World world;
+    const auto entities = world.spawn_n(count, T1{.x = 1, .y = 1}, T2{.x = 2, .y = 2, .z = 2, .w = 2});
+    for (auto _ : state) {
+        f32 sum{0};
+        for (const auto entity : entities) {
+            const auto& [t1, t2] = world.get<const T1, const T2>(entity);
+            sum += t1.x * t2.w;
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<i64>(count));
+}
+
+BENCHMARK(BM_world_get);
+
+// Follows 1M shuffled handles into 1M entities: 0 calls get per handle, 1 resolves batches of 256 handles with get_many
+static void BM_world_get_random(benchmark::State& state) {
+    constexpr usize count{1'000'000};
+    constexpr usize batch{256};
+    World world;
+    auto entities = world.spawn_n(count, T1{.x = 1, .y = 1}, T2{.x = 2, .y = 2, .z = 2, .w = 2});
+    std::ranges::shuffle(entities, std::mt19937_64{42});
+    std::vector<ComponentPointers<const T1, const T2>> pointers(batch);
+    for (auto _ : state) {
+        f32 sum{0};
+        if (state.range(0) == 0) {
+            for (const auto entity : entities) {
+                const auto& [t1, t2] = world.get<const T1, const T2>(entity);
+                sum += t1.x * t2.w;
+            }
+        } else {
+            for (usize first{0}; first < count; first += batch) {
+                const usize len{std::min(batch, count - first)};
+                world.get_many<const T1, const T2>(std::span(entities).subspan(first, len), pointers);
+                for (const auto [t1, t2] : std::span(pointers).first(len)) {
+                    sum += t1->x * t2->w;
+                }
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<i64>(count));
+}
+BENCHMARK(BM_world_get_random)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+// Checks and reads two components of every entity: 0 with has and get on the world, 1 through one EntityRef per entity
+static void BM_world_entity_ref(benchmark::State& state) {
+    constexpr usize count{100'000};
+    World world;
+    const auto entities = world.spawn_n(count, T1{.x = 1, .y = 1}, T2{.x = 2, .y = 2, .z = 2, .w = 2});
+    for (auto _ : state) {
+        f32 sum{0};
+        for (const auto entity : entities) {
+            if (state.range(0) == 0) {
+                if (world.has<T2>(entity)) {
+                    sum += world.get<const T1>(entity).x * world.get<const T2>(entity).w;
+                }
+            } else if (auto ref = world.entity_ref(entity); ref.has<T2>()) {
+                sum += ref.get<const T1>().x * ref.get<const T2>().w;
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<i64>(count));
+}
+BENCHMARK(BM_world_entity_ref)->Arg(0)->Arg(1);
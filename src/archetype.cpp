@@ -1,161 +1,789 @@
-// ReSharper disable CppUseStructuredBinding
-#include "archetype.h"
-
-#include <cassert>
-
-namespace nid {
-Archetype::Archetype(CompTypeList comp_infos) : rows(comp_infos.size()), infos(std::move(comp_infos)), capacity(start_capacity) {
-    for (usize row{0}; row < rows.size(); ++row) {
-        rows[row] = operator new(infos[row].size * start_capacity, std::align_val_t{infos[row].alignment});
-        comp_map.insert({infos[row].id, row});
-    }
-}
-
-Archetype::~Archetype() {
-    for (usize row{0}; row < rows.size(); ++row) {
-        infos[row].dtor(rows[row], size);
-        operator delete(rows[row], std::align_val_t{infos[row].alignment});
-    }
-}
-
-Archetype::Archetype(Archetype&& other) noexcept
-    : rows(std::move(other.rows)), infos(std::move(other.infos)), comp_map(std::move(other.comp_map)), capacity(other.capacity), size(other.size) {
-    other.capacity = 0;
-    other.size = 0;
-    NIDAVELLIR_ASSERT(other.rows.empty(), "The rows of the other archetype should be empty after move");
-    NIDAVELLIR_ASSERT(other.infos.empty(), "The infos of the other archetype should be empty after move");
-}
-
-auto Archetype::operator=(Archetype&& other) noexcept -> Archetype& {
-    for (usize row{0}; row < rows.size(); ++row) {
-        infos[row].dtor(rows[row], size);
-        operator delete(rows[row], std::align_val_t{infos[row].alignment});
-    }
-
-    rows = std::move(other.rows);
-    infos = std::move(other.infos);
-    comp_map = std::move(other.comp_map);
-    capacity = other.capacity;
-    size = other.size;
-
-    other.capacity = 0;
-    other.size = 0;
-    NIDAVELLIR_ASSERT(other.rows.empty(), "The rows of the other archetype should be empty after move");
-    NIDAVELLIR_ASSERT(other.infos.empty(), "The infos of the other archetype should be empty after move");
-
-    return *this;
-}
-
-auto Archetype::reserve(const usize new_capacity) -> void {
-    NIDAVELLIR_ASSERT(new_capacity > capacity, "The reserve function is expected to be called with a larger capacity than the current one");
-    std::vector<void*> new_rows(rows.size());
-
-    for (usize row{0}; row < new_rows.size(); ++row) {
-        new_rows[row] = operator new(infos[row].size * new_capacity, std::align_val_t{infos[row].alignment});
-        infos[row].move_ctor_dtor(new_rows[row], rows[row], size);
-        operator delete(rows[row], std::align_val_t{infos[row].alignment});
-    }
-
-    rows = std::move(new_rows);
-    capacity = new_capacity;
-}
-auto Archetype::grow() -> void {
-    reserve(capacity * 2);
-}
-
-auto Archetype::prepare_push(const usize count) -> void {
-    if (size + count > capacity) {
-        if (size + count > 2 * capacity) {
-            reserve(size + count);
-        } else {
-            grow();
-        }
-    }
-}
-
-auto Archetype::swap(const usize first, const usize second) noexcept -> void {
-    NIDAVELLIR_ASSERT(first < size and second < size, "A swap can only be made between initialized columns");
-    if (first == second) {
-        return;
-    }
-
-    if (capacity == size) {
-        grow();
-    }
-
-    for (usize row{0}; row < rows.size(); ++row) {
-        void* end = get_raw(size, row);
-        void* ptr_first = get_raw(first, row);
-        void* ptr_second = get_raw(second, row);
-
-        // Move construct first element at the back of buffer
-        infos[row].move_ctor_dtor(end, ptr_first, 1);
-
-        // Move assign from second to first
-        infos[row].move_ctor_dtor(ptr_first, ptr_second, 1);
-
-        // Move assign and destroy from end to second
-        infos[row].move_ctor_dtor(ptr_second, end, 1);
-    }
-}
-
-auto Archetype::remove(const usize col) -> usize {
-    const auto last_col = --size;
-    NIDAVELLIR_ASSERT(col <= last_col, "Only an initialized column can be removed");
-    for (usize row{0}; row < rows.size(); ++row) {
-        if (col == last_col) {
-            void* last = get_raw(last_col, row);
-            infos[row].dtor(last, 1);
-        } else {
-            void* dst = get_raw(col, row);
-            void* src = get_raw(last_col, row);
-
-            infos[row].move_assign_dtor(dst, src, 1);
-        }
-    }
-
-    return last_col;
-}
-
-auto Archetype::partial_match(const std::span<CompTypeInfo> type_list) const -> bool {
-    if (type_list.size() > infos.size()) {
-        return false;
-    }
-
-    for (const auto& type : type_list) {
-        bool found = false;
-        for (const auto& info : infos) {
-            if (type.id == info.id) {
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
-            return false;
-        }
-    }
-
-    return true;
-}
-
-auto Archetype::match(const std::span<CompTypeInfo> type_list) const -> bool {
-    if (type_list.size() != infos.size()) {
-        return false;
-    }
-
-    for (const auto& type : type_list) {
-        bool found = false;
-        for (const auto& info : infos) {
-            if (type.id == info.id) {
-                found = true;
-                break;
-            }
-        }
-        if (!found) {
-            return false;
-        }
-    }
-
-    return true;
-}
-} // namespace nid
+// ReSharper disable CppUseStructuredBinding
+#include "archetype.h"
+#include "virtual_memory.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <limits>
+#include <new>
+#include <utility>
+
+namespace nid {
+Archetype::Archetype(CompTypeList comp_infos, const StorageConfig& config, const u32* tick_source)
+    : infos(std::move(comp_infos)), capacity(start_capacity), storage(config.storage), chunk_shift(63), chunk_mask((usize{1} << 63) - 1),
+      migration_step(config.migration_step), resource(config.resource), tick_block_shift(max_tick_block_shift), change_tick(tick_source == nullptr ? &no_tick : tick_source) {
+    data_rows = static_cast<usize>(std::ranges::count_if(infos, [](const CompTypeInfo& info) { return info.size != 0; }));
+    NIDAVELLIR_ASSERT(std::ranges::all_of(infos.begin() + static_cast<std::ptrdiff_t>(data_rows), infos.end(), [](const CompTypeInfo& info) { return info.size == 0; }),
+                      "Tag components have to follow all components with storage");
+    ticks.reserve(data_rows);
+    enabled.reserve(data_rows);
+    for (usize row{0}; row < data_rows; ++row) {
+        ticks.emplace_back(resource);
+        enabled.emplace_back(resource);
+    }
+    for (usize row{0}; row < data_rows; ++row) {
+        if (infos[row].ops->enableable) {
+            enableable_rows.push_back(row);
+        }
+    }
+
+    for (usize row{0}; row < infos.size(); ++row) {
+        comp_map.insert({infos[row].id, row});
+        if (const usize index{infos[row].index}; index != no_component_index) {
+            if (index >= index_rows.size()) {
+                index_rows.resize(index + 1, no_row);
+            }
+            index_rows[index] = row;
+        }
+    }
+
+    // An archetype without components or with only tags has nothing to store in chunks
+    if (data_rows == 0 or (storage == ArchetypeStorage::mapped and !virtual_memory_supported)) {
+        storage = ArchetypeStorage::contiguous;
+    }
+
+    if (storage == ArchetypeStorage::mapped) {
+        huge_pages = config.huge_pages;
+        const usize granularity{commit_granularity(huge_pages)};
+        mapped_bytes = (config.mapped_bytes + granularity - 1) & ~(granularity - 1);
+        storage = ArchetypeStorage::contiguous;
+        if (config.mapped_threshold <= start_capacity) {
+            capacity = 0;
+            map_rows(start_capacity);
+            return;
+        }
+
+        // Small archetypes stay contiguous until they grow to the threshold
+        mapped_threshold = config.mapped_threshold;
+    }
+
+    if (storage == ArchetypeStorage::contiguous) {
+        rows.resize(data_rows);
+        for (usize row{0}; row < rows.size(); ++row) {
+            rows[row] = resource->allocate(infos[row].size * start_capacity, infos[row].alignment);
+        }
+        return;
+    }
+
+    if (storage == ArchetypeStorage::packed) {
+        for (usize row{0}; row < data_rows; ++row) {
+            chunk_alignment = std::max(chunk_alignment, infos[row].alignment);
+        }
+        rows.resize(data_rows);
+        block = allocate_block(start_capacity, rows);
+        return;
+    }
+
+    // Find the largest power of two of columns whose rows fit in a chunk when laid out one after another
+    usize row_bytes{0};
+    for (usize row{0}; row < data_rows; ++row) {
+        row_bytes += infos[row].size;
+        chunk_alignment = std::max(chunk_alignment, infos[row].alignment);
+    }
+
+    offsets.resize(data_rows);
+    chunk_shift = std::bit_width(std::max(config.chunk_bytes / row_bytes, usize{1})) - 1;
+    while (true) {
+        usize offset{0};
+        for (usize row{0}; row < data_rows; ++row) {
+            offset = (offset + infos[row].alignment - 1) & ~(infos[row].alignment - 1);
+            offsets[row] = offset;
+            offset += infos[row].size << chunk_shift;
+        }
+
+        // A single column that does not fit gets a chunk of its own size
+        if (offset <= config.chunk_bytes or chunk_shift == 0) {
+            chunk_bytes = std::max(offset, config.chunk_bytes);
+            break;
+        }
+        --chunk_shift;
+    }
+
+    chunk_mask = (usize{1} << chunk_shift) - 1;
+    tick_block_shift = std::min(tick_block_shift, chunk_shift);
+    capacity = 0;
+    allocate_chunk();
+}
+
+Archetype::~Archetype() {
+    release();
+}
+
+Archetype::Archetype(Archetype&& other) noexcept
+    : rows(std::move(other.rows)), infos(std::move(other.infos)), comp_map(std::move(other.comp_map)), index_rows(std::move(other.index_rows)), data_rows(other.data_rows),
+      capacity(other.capacity), size(other.size),
+      storage(other.storage), chunk_shift(other.chunk_shift), chunk_mask(other.chunk_mask), chunk_bytes(other.chunk_bytes),
+      chunk_alignment(other.chunk_alignment), offsets(std::move(other.offsets)), chunks(std::move(other.chunks)), block(other.block), mapped_bytes(other.mapped_bytes),
+      huge_pages(other.huge_pages), mapped_threshold(other.mapped_threshold), migration_step(other.migration_step), old_rows(std::move(other.old_rows)), old_block(other.old_block),
+      old_capacity(other.old_capacity), migrated(other.migrated), migration_end(other.migration_end), resource(other.resource), ticks(std::move(other.ticks)),
+      tick_block_shift(other.tick_block_shift), change_tick(other.change_tick), enableable_rows(std::move(other.enableable_rows)), enabled(std::move(other.enabled)), undo(other.undo) {
+    other.capacity = 0;
+    other.size = 0;
+    other.block = nullptr;
+    other.undo = nullptr;
+    other.old_block = nullptr;
+    other.migrated = 0;
+    other.migration_end = 0;
+    NIDAVELLIR_ASSERT(other.rows.empty(), "The rows of the other archetype should be empty after move");
+    NIDAVELLIR_ASSERT(other.infos.empty(), "The infos of the other archetype should be empty after move");
+    NIDAVELLIR_ASSERT(other.chunks.empty(), "The chunks of the other archetype should be empty after move");
+}
+
+auto Archetype::operator=(Archetype&& other) noexcept -> Archetype& {
+    release();
+
+    rows = std::move(other.rows);
+    infos = std::move(other.infos);
+    comp_map = std::move(other.comp_map);
+    index_rows = std::move(other.index_rows);
+    data_rows = other.data_rows;
+    capacity = other.capacity;
+    size = other.size;
+    storage = other.storage;
+    chunk_shift = other.chunk_shift;
+    chunk_mask = other.chunk_mask;
+    chunk_bytes = other.chunk_bytes;
+    chunk_alignment = other.chunk_alignment;
+    offsets = std::move(other.offsets);
+    chunks = std::move(other.chunks);
+    block = other.block;
+    mapped_bytes = other.mapped_bytes;
+    huge_pages = other.huge_pages;
+    mapped_threshold = other.mapped_threshold;
+    migration_step = other.migration_step;
+    old_rows = std::move(other.old_rows);
+    old_block = other.old_block;
+    old_capacity = other.old_capacity;
+    migrated = other.migrated;
+    migration_end = other.migration_end;
+    resource = other.resource;
+    ticks = std::move(other.ticks);
+    tick_block_shift = other.tick_block_shift;
+    change_tick = other.change_tick;
+    enableable_rows = std::move(other.enableable_rows);
+    enabled = std::move(other.enabled);
+    undo = other.undo;
+
+    other.capacity = 0;
+    other.size = 0;
+    other.block = nullptr;
+    other.undo = nullptr;
+    other.old_block = nullptr;
+    other.migrated = 0;
+    other.migration_end = 0;
+    NIDAVELLIR_ASSERT(other.rows.empty(), "The rows of the other archetype should be empty after move");
+    NIDAVELLIR_ASSERT(other.infos.empty(), "The infos of the other archetype should be empty after move");
+    NIDAVELLIR_ASSERT(other.chunks.empty(), "The chunks of the other archetype should be empty after move");
+
+    return *this;
+}
+
+auto Archetype::release() noexcept -> void {
+    for (usize row{0}; row < data_rows; ++row) {
+        for_each_run(0, size, [&](const usize col, const usize len) { infos[row].ops->dtor(get_raw(col, row), len); });
+    }
+    release_old_rows();
+
+    if (storage == ArchetypeStorage::contiguous) {
+        for (usize row{0}; row < rows.size(); ++row) {
+            resource->deallocate(rows[row], infos[row].size * capacity, infos[row].alignment);
+        }
+    } else if (storage == ArchetypeStorage::packed) {
+        if (block != nullptr) {
+            resource->deallocate(block, block_bytes(capacity), chunk_alignment);
+        }
+    } else if (storage == ArchetypeStorage::mapped) {
+        for (void* row : rows) {
+            release_address_space(row, mapped_bytes);
+        }
+    } else {
+        for (void* chunk : chunks) {
+            resource->deallocate(chunk, chunk_bytes, chunk_alignment);
+        }
+    }
+}
+
+auto Archetype::allocate_block(const usize block_capacity, const std::span<void*> block_rows) const -> void* {
+    NIDAVELLIR_ASSERT(block_rows.size() == data_rows, "Every data row needs a start");
+    auto* memory = static_cast<u8*>(resource->allocate(block_bytes(block_capacity), chunk_alignment));
+    for (usize row{0}, offset{0}; row < data_rows; ++row) {
+        offset = (offset + infos[row].alignment - 1) & ~(infos[row].alignment - 1);
+        block_rows[row] = memory + offset;
+        offset += infos[row].size * block_capacity;
+    }
+    return memory;
+}
+
+auto Archetype::block_bytes(const usize block_capacity) const -> usize {
+    usize bytes{0};
+    for (usize row{0}; row < data_rows; ++row) {
+        bytes = ((bytes + infos[row].alignment - 1) & ~(infos[row].alignment - 1)) + infos[row].size * block_capacity;
+    }
+    return bytes;
+}
+
+auto Archetype::commit_rows(const usize new_capacity) -> void {
+    NIDAVELLIR_ASSERT(storage == ArchetypeStorage::mapped, "Pages are only committed in mapped mode");
+    const usize granularity{commit_granularity(huge_pages)};
+    usize committed{std::numeric_limits<usize>::max()};
+    for (usize row{0}; row < data_rows; ++row) {
+        const usize comp_size{infos[row].size};
+        if (new_capacity > mapped_bytes / comp_size) {
+            throw std::bad_alloc();
+        }
+
+        const usize old_bytes{(comp_size * capacity + granularity - 1) & ~(granularity - 1)};
+        const usize new_bytes{(comp_size * new_capacity + granularity - 1) & ~(granularity - 1)};
+        if (new_bytes > old_bytes) {
+            commit_pages(static_cast<u8*>(rows[row]) + old_bytes, new_bytes - old_bytes);
+        }
+        committed = std::min(committed, new_bytes / comp_size);
+    }
+    capacity = committed;
+}
+
+auto Archetype::map_rows(const usize new_capacity) -> void {
+    NIDAVELLIR_ASSERT(storage == ArchetypeStorage::contiguous, "Only contiguous rows are moved to mapped rows");
+    // The mapped rows replace the buffers before a pending growth as well
+    finish_growth();
+
+    std::vector<void*> new_rows(data_rows, nullptr);
+    try {
+        for (usize row{0}; row < data_rows; ++row) {
+            NIDAVELLIR_ASSERT(infos[row].alignment <= commit_granularity(huge_pages), "A mapped row starts at a page boundary");
+            new_rows[row] = reserve_address_space(mapped_bytes, huge_pages);
+        }
+    } catch (...) {
+        for (void* row : new_rows) {
+            if (row != nullptr) {
+                release_address_space(row, mapped_bytes);
+            }
+        }
+        throw;
+    }
+
+    std::vector<void*> contiguous_rows{std::exchange(rows, std::move(new_rows))};
+    const usize contiguous_capacity{std::exchange(capacity, 0)};
+    storage = ArchetypeStorage::mapped;
+    try {
+        commit_rows(new_capacity);
+    } catch (...) {
+        for (void* row : rows) {
+            release_address_space(row, mapped_bytes);
+        }
+        rows = std::move(contiguous_rows);
+        capacity = contiguous_capacity;
+        storage = ArchetypeStorage::contiguous;
+        throw;
+    }
+
+    for (usize row{0}; row < contiguous_rows.size(); ++row) {
+        infos[row].ops->move_ctor_dtor(rows[row], contiguous_rows[row], size);
+        resource->deallocate(contiguous_rows[row], infos[row].size * contiguous_capacity, infos[row].alignment);
+    }
+    mapped_threshold = std::numeric_limits<usize>::max();
+}
+
+auto Archetype::allocate_chunk() -> void {
+    NIDAVELLIR_ASSERT(storage == ArchetypeStorage::chunked, "Chunks are only allocated in chunked mode");
+    auto* chunk = static_cast<u8*>(resource->allocate(chunk_bytes, chunk_alignment));
+    chunks.push_back(chunk);
+    for (usize row{0}; row < data_rows; ++row) {
+        rows.push_back(chunk + offsets[row]);
+    }
+    capacity += chunk_mask + 1;
+}
+
+auto Archetype::reserve(const usize new_capacity) -> void {
+    NIDAVELLIR_ASSERT(new_capacity > capacity, "The reserve function is expected to be called with a larger capacity than the current one");
+    if (storage == ArchetypeStorage::chunked) {
+        while (capacity < new_capacity) {
+            allocate_chunk();
+        }
+        return;
+    }
+
+    if (storage == ArchetypeStorage::mapped) {
+        commit_rows(new_capacity);
+        return;
+    }
+
+    if (new_capacity >= mapped_threshold) {
+        map_rows(new_capacity);
+        return;
+    }
+
+    // There is at most one pending growth, so the buffers before it are never needed again
+    finish_growth();
+
+    // All buffers are allocated before any component moves, so a resource that runs out of memory leaves the Archetype unchanged
+    std::vector<void*> new_rows(rows.size());
+    void* new_block{nullptr};
+    if (storage == ArchetypeStorage::packed) {
+        new_block = allocate_block(new_capacity, new_rows);
+    } else {
+        usize allocated{0};
+        try {
+            for (; allocated < new_rows.size(); ++allocated) {
+                new_rows[allocated] = resource->allocate(infos[allocated].size * new_capacity, infos[allocated].alignment);
+            }
+        } catch (...) {
+            for (usize row{0}; row < allocated; ++row) {
+                resource->deallocate(new_rows[row], infos[row].size * new_capacity, infos[row].alignment);
+            }
+            throw;
+        }
+    }
+
+    if (migration_step != 0 and size > migration_step and data_rows != 0) {
+        // The columns stay in the old buffers and are moved a step at a time by the following operations
+        old_rows = std::move(rows);
+        old_block = block;
+        old_capacity = capacity;
+        migrated = 0;
+        migration_end = size;
+    } else if (storage == ArchetypeStorage::packed) {
+        for (usize row{0}; row < new_rows.size(); ++row) {
+            infos[row].ops->move_ctor_dtor(new_rows[row], rows[row], size);
+        }
+        resource->deallocate(block, block_bytes(capacity), chunk_alignment);
+    } else {
+        for (usize row{0}; row < new_rows.size(); ++row) {
+            infos[row].ops->move_ctor_dtor(new_rows[row], rows[row], size);
+            resource->deallocate(rows[row], infos[row].size * capacity, infos[row].alignment);
+        }
+    }
+
+    block = new_block;
+    rows = std::move(new_rows);
+    capacity = new_capacity;
+}
+
+auto Archetype::finish_growth() -> void {
+    if (migration_end != 0) {
+        migrate(migration_end - migrated);
+    }
+}
+
+auto Archetype::migrate(const usize count) -> void {
+    const usize len{std::min(count, migration_end - migrated)};
+    for (usize row{0}; row < data_rows; ++row) {
+        const usize offset{infos[row].size * migrated};
+        infos[row].ops->move_ctor_dtor(static_cast<u8*>(rows[row]) + offset, static_cast<u8*>(old_rows[row]) + offset, len);
+    }
+    migrated += len;
+    if (migrated == migration_end) {
+        release_old_rows();
+    }
+}
+
+auto Archetype::trim_growth() noexcept -> void {
+    // The removed columns were destroyed in the old buffers, only the columns that are left still have to move
+    migration_end = std::max(size, migrated);
+    if (migration_end == migrated) {
+        release_old_rows();
+    }
+}
+
+auto Archetype::release_old_rows() noexcept -> void {
+    if (old_rows.empty()) {
+        return;
+    }
+    if (storage == ArchetypeStorage::packed) {
+        resource->deallocate(old_block, block_bytes(old_capacity), chunk_alignment);
+    } else {
+        for (usize row{0}; row < old_rows.size(); ++row) {
+            resource->deallocate(old_rows[row], infos[row].size * old_capacity, infos[row].alignment);
+        }
+    }
+    old_rows.clear();
+    old_block = nullptr;
+    old_capacity = 0;
+    migrated = 0;
+    migration_end = 0;
+}
+auto Archetype::grow() -> void {
+    if (storage == ArchetypeStorage::chunked) {
+        allocate_chunk();
+        return;
+    }
+    reserve(capacity * 2);
+}
+
+auto Archetype::prepare_push(const usize count) -> void {
+    if (size + count > capacity) {
+        if (size + count > 2 * capacity or storage == ArchetypeStorage::chunked) {
+            reserve(size + count);
+        } else {
+            grow();
+        }
+    }
+}
+
+auto Archetype::swap(const usize first, const usize second) -> void {
+    NIDAVELLIR_ASSERT(first < size and second < size, "A swap can only be made between initialized columns");
+    if (first == second) {
+        return;
+    }
+
+    for (usize row{0}; row < data_rows; ++row) {
+        infos[row].ops->swap(get_raw(first, row), get_raw(second, row), 1);
+
+        const u32 first_added{added_tick(first, row)};
+        const u32 first_changed{changed_tick(first, row)};
+        set_ticks(first, row, added_tick(second, row), changed_tick(second, row));
+        set_ticks(second, row, first_added, first_changed);
+    }
+
+    for (const auto row : enableable_rows) {
+        const bool first_enabled{is_enabled(first, row)};
+        write_enabled(first, row, is_enabled(second, row));
+        write_enabled(second, row, first_enabled);
+    }
+}
+
+auto Archetype::remove(const usize col) -> usize {
+    const auto last_col = --size;
+    NIDAVELLIR_ASSERT(col <= last_col, "Only an initialized column can be removed");
+    for (usize row{0}; row < data_rows; ++row) {
+        if (col == last_col) {
+            void* last = get_raw(last_col, row);
+            infos[row].ops->dtor(last, 1);
+        } else {
+            void* dst = get_raw(col, row);
+            void* src = get_raw(last_col, row);
+
+            infos[row].ops->move_assign_dtor(dst, src, 1);
+            set_ticks(col, row, ticks[row].added[last_col], std::max(ticks[row].changed[last_col], ticks[row].block_written[last_col >> tick_block_shift]));
+        }
+    }
+    if (col != last_col) {
+        for (const auto row : enableable_rows) {
+            set_enabled(col, row, is_enabled(last_col, row));
+        }
+    }
+    pop_ticks();
+    pop_enabled();
+    if (migration_end > size) {
+        trim_growth();
+    }
+    step_growth();
+
+    return last_col;
+}
+
+auto Archetype::append_columns(Archetype& src, const std::span<const usize> row_map) -> usize {
+    NIDAVELLIR_ASSERT(&src != this, "An Archetype can not append its own columns");
+    NIDAVELLIR_ASSERT(row_map.size() >= src.data_rows, "Every data row of the source needs a target row");
+    const usize first{size};
+    const usize count{src.size};
+    if (count == 0) {
+        return first;
+    }
+
+    // The source is emptied, so its pending growth can not be left with columns in the old buffers
+    src.finish_growth();
+
+    if (size == 0 and storage == ArchetypeStorage::contiguous and src.storage == ArchetypeStorage::contiguous and resource->is_equal(*src.resource)) {
+        NIDAVELLIR_ASSERT(tick_block_shift == src.tick_block_shift, "Contiguous archetypes have the same tick blocks");
+        // The buffers of both sides are exchanged, so they need the same capacity to be returned with the right size
+        if (capacity != src.capacity) {
+            for (usize row{0}; row < data_rows; ++row) {
+                resource->deallocate(rows[row], infos[row].size * capacity, infos[row].alignment);
+                rows[row] = resource->allocate(infos[row].size * src.capacity, infos[row].alignment);
+            }
+            capacity = src.capacity;
+        }
+        size = count;
+        push_ticks(count);
+        push_enabled(count);
+
+        for (usize row{0}; row < src.data_rows; ++row) {
+            if (const usize target_row{row_map[row]}; target_row != no_row) {
+                std::swap(rows[target_row], src.rows[row]);
+                std::swap(ticks[target_row], src.ticks[row]);
+                std::swap(enabled[target_row], src.enabled[row]);
+            } else {
+                src.infos[row].ops->dtor(src.rows[row], count);
+            }
+        }
+    } else {
+        prepare_push(count);
+        increase_size(count);
+
+        for (usize row{0}; row < src.data_rows; ++row) {
+            const usize target_row{row_map[row]};
+            if (target_row == no_row) {
+                src.for_each_run(0, count, [&](const usize col, const usize len) { src.infos[row].ops->dtor(src.get_raw(col, row), len); });
+                continue;
+            }
+
+            // The chunks of both archetypes can have different sizes, so a run ends at the end of either chunk
+            for (usize col{0}; col < count;) {
+                const usize len{std::min({count - col, src.run_len(col), run_len(first + col)})};
+                infos[target_row].ops->move_ctor_dtor(get_raw(first + col, target_row), src.get_raw(col, row), len);
+                col += len;
+            }
+            for (usize col{0}; col < count; ++col) {
+                copy_ticks(first + col, target_row, src, col, row);
+                copy_enabled(first + col, target_row, src, col, row);
+            }
+        }
+    }
+
+    src.size = 0;
+    src.pop_ticks();
+    src.pop_enabled();
+    return first;
+}
+
+auto Archetype::clear() noexcept -> void {
+    for (usize row{0}; row < data_rows; ++row) {
+        for_each_run(0, size, [&](const usize col, const usize len) { infos[row].ops->dtor(get_raw(col, row), len); });
+    }
+    size = 0;
+    pop_ticks();
+    pop_enabled();
+    release_old_rows();
+}
+
+auto Archetype::copy_columns(const Archetype& src) -> void {
+    NIDAVELLIR_ASSERT(infos == src.infos, "Columns can only be copied between archetypes with the same rows");
+    const usize first{size};
+    const usize count{src.size};
+    if (count == 0) {
+        return;
+    }
+    prepare_push(count);
+
+    usize row{0};
+    usize copied{0};
+    try {
+        for (; row < data_rows; ++row) {
+            NIDAVELLIR_ASSERT(infos[row].ops->copy_ctor != nullptr, "Only copyable components can be copied");
+            for (copied = 0; copied < count;) {
+                const usize len{std::min({count - copied, src.run_len(copied), run_len(first + copied)})};
+                infos[row].ops->copy_ctor(get_raw(first + copied, row), src.get_raw(copied, row), len);
+                copied += len;
+            }
+        }
+    } catch (...) {
+        // The copies of the rows before the failing one and the finished runs of the failing row are destroyed
+        for (usize done{0}; done <= row and done < data_rows; ++done) {
+            for_each_run(first, done == row ? copied : count, [&](const usize col, const usize len) { infos[done].ops->dtor(get_raw(col, done), len); });
+        }
+        throw;
+    }
+    increase_size(count);
+
+    for (const usize enableable : enableable_rows) {
+        for (usize col{0}; col < count; ++col) {
+            copy_enabled(first + col, enableable, src, col, enableable);
+        }
+    }
+}
+
+auto Archetype::restore_blocks(const ArchetypeUndo& log) -> void {
+    ArchetypeUndo* const active{std::exchange(undo, nullptr)};
+    for (const auto& block : log.blocks) {
+        NIDAVELLIR_ASSERT(block.begin + block.count <= size, "A block can only be restored onto the columns it was saved from");
+        const auto& ops = *infos[block.row].ops;
+        const Archetype& copy = *log.copies[block.row];
+        for_each_run(block.begin, block.count, [&](const usize col, const usize len) {
+            void* dst = get_raw(col, block.row);
+            ops.dtor(dst, len);
+            ops.copy_ctor(dst, copy.get_raw(block.first + (col - block.begin), 0), len);
+        });
+        mark_written(block.begin, block.count, block.row);
+
+        if (is_enableable(block.row)) {
+            const usize first_word{block.begin / enabled_word_bits};
+            for (usize col{block.begin}; col < block.begin + block.count; ++col) {
+                const u64 word{log.enabled[block.words + col / enabled_word_bits - first_word]};
+                set_enabled(col, block.row, (word >> (col % enabled_word_bits) & 1) != 0);
+            }
+        }
+    }
+    undo = active;
+}
+
+auto Archetype::save_blocks(const usize col, const usize count, const usize row) -> void {
+    NIDAVELLIR_ASSERT(infos[row].ops->copy_ctor != nullptr, "Only copyable components can be saved to an undo log");
+    if (count == 0) {
+        return;
+    }
+    auto& log = *undo;
+    if (log.saved.empty()) {
+        log.saved.resize(data_rows);
+        log.copies.resize(data_rows);
+    }
+
+    auto& saved = log.saved[row];
+    const usize last_block{(col + count - 1) >> tick_block_shift};
+    if (last_block / 64 >= saved.size()) {
+        saved.resize(last_block / 64 + 1);
+    }
+    for (usize block{col >> tick_block_shift}; block <= last_block; ++block) {
+        const u64 bit{u64{1} << (block % 64)};
+        if ((saved[block / 64] & bit) != 0) {
+            continue;
+        }
+
+        const usize begin{block << tick_block_shift};
+        const usize block_count{std::min(begin + tick_block_len(), size) - begin};
+        auto& copy = log.copies[row];
+        if (copy == nullptr) {
+            copy = std::make_unique<Archetype>(CompTypeList{infos[row]}, StorageConfig{.resource = resource});
+            // Every column is saved at most once, so the copy never holds more than the current columns
+            if (size > copy->cap()) {
+                copy->reserve(size);
+            }
+        }
+        const usize first{copy->len()};
+        copy->prepare_push(block_count);
+        for_each_run(begin, block_count, [&](const usize run_col, const usize len) {
+            infos[row].ops->copy_ctor(copy->get_raw(first + (run_col - begin), 0), get_raw(run_col, row), len);
+        });
+        copy->increase_size(block_count);
+
+        const usize words{log.enabled.size()};
+        if (is_enableable(row)) {
+            const auto row_words = enabled_words(row);
+            log.enabled.insert(log.enabled.end(), row_words.begin() + static_cast<std::ptrdiff_t>(begin / enabled_word_bits),
+                               row_words.begin() + static_cast<std::ptrdiff_t>((begin + block_count - 1) / enabled_word_bits + 1));
+        }
+        log.blocks.push_back(ArchetypeUndo::Block{.row = row, .begin = begin, .count = block_count, .first = first, .words = words});
+        saved[block / 64] |= bit;
+    }
+}
+
+auto Archetype::map_file_row(const usize row, const MappedFile& file, const usize offset, const usize count) -> bool {
+    NIDAVELLIR_ASSERT(size == 0 and count <= capacity, "Only the reserved columns of an empty Archetype can be mapped");
+    NIDAVELLIR_ASSERT(infos[row].ops->raw_snapshot, "Only components that are saved as raw bytes can be mapped");
+    const usize page{commit_granularity(false)};
+    const usize bytes{infos[row].size * count};
+    if (storage != ArchetypeStorage::mapped or bytes < page or offset % page != 0) {
+        return false;
+    }
+    return file.map_into(rows[row], offset, bytes);
+}
+
+auto Archetype::assign_enabled(const usize row, const std::span<const u64> words) -> void {
+    auto& row_words = enabled[row];
+    NIDAVELLIR_ASSERT(words.size() == row_words.size(), "Every column needs an enabled bit");
+    std::ranges::copy(words, row_words.begin());
+    if (const usize tail{size % enabled_word_bits}; tail != 0) {
+        row_words.back() &= (u64{1} << tail) - 1;
+    }
+}
+
+auto Archetype::mark_written(usize col, const usize count, const usize row) -> void {
+    NIDAVELLIR_ASSERT(col + count <= size, "Ticks only exist for initialized columns");
+    if (undo != nullptr) [[unlikely]] {
+        save_blocks(col, count, row);
+    }
+    const u32 tick{*change_tick};
+    auto& row_ticks = ticks[row];
+    const usize end{col + count};
+    while (col < end) {
+        const usize block{col >> tick_block_shift};
+        const usize block_begin{block << tick_block_shift};
+        const usize block_end{std::min(block_begin + tick_block_len(), size)};
+        const usize last{std::min(end, block_end)};
+
+        if (col == block_begin and last == block_end) {
+            row_ticks.block_written[block] = tick;
+        } else {
+            std::fill(row_ticks.changed.begin() + static_cast<std::ptrdiff_t>(col), row_ticks.changed.begin() + static_cast<std::ptrdiff_t>(last), tick);
+        }
+        row_ticks.block_changed[block] = tick;
+        col = last;
+    }
+}
+
+auto Archetype::push_ticks(const usize count) -> void {
+    const u32 tick{*change_tick};
+    const usize blocks{(size + tick_block_len() - 1) >> tick_block_shift};
+    const usize first_block{(size - count) >> tick_block_shift};
+    for (auto& row_ticks : ticks) {
+        row_ticks.added.resize(size, tick);
+        row_ticks.changed.resize(size, tick);
+        row_ticks.block_added.resize(blocks, 0);
+        row_ticks.block_changed.resize(blocks, 0);
+        row_ticks.block_written.resize(blocks, 0);
+        for (usize block{first_block}; block < blocks; ++block) {
+            row_ticks.block_added[block] = tick;
+            row_ticks.block_changed[block] = tick;
+        }
+    }
+}
+
+auto Archetype::push_enabled(const usize count) -> void {
+    for (const auto row : enableable_rows) {
+        auto& words = enabled[row];
+        words.resize((size + enabled_word_bits - 1) / enabled_word_bits, 0);
+        for (usize col{size - count}; col < size; ++col) {
+            words[col / enabled_word_bits] |= u64{1} << (col % enabled_word_bits);
+        }
+    }
+}
+
+auto Archetype::pop_enabled() -> void {
+    for (const auto row : enableable_rows) {
+        auto& words = enabled[row];
+        words.resize((size + enabled_word_bits - 1) / enabled_word_bits);
+        // Bits past the end are kept clear, so a scan over the last word never reports removed columns
+        if (const usize tail{size % enabled_word_bits}; tail != 0) {
+            words.back() &= (u64{1} << tail) - 1;
+        }
+    }
+}
+
+auto Archetype::pop_ticks() -> void {
+    const usize blocks{(size + tick_block_len() - 1) >> tick_block_shift};
+    for (auto& row_ticks : ticks) {
+        row_ticks.added.resize(size);
+        row_ticks.changed.resize(size);
+        row_ticks.block_added.resize(blocks);
+        row_ticks.block_changed.resize(blocks);
+        row_ticks.block_written.resize(blocks);
+    }
+}
+
+auto Archetype::set_ticks(const usize col, const usize row, const u32 added, const u32 changed) -> void {
+    auto& row_ticks = ticks[row];
+    const usize block{col >> tick_block_shift};
+    if (row_ticks.block_written[block] != 0) {
+        flatten_block(block, row);
+    }
+
+    row_ticks.added[col] = added;
+    row_ticks.changed[col] = changed;
+    row_ticks.block_added[block] = std::max(row_ticks.block_added[block], added);
+    row_ticks.block_changed[block] = std::max(row_ticks.block_changed[block], changed);
+}
+
+auto Archetype::flatten_block(const usize block, const usize row) -> void {
+    auto& row_ticks = ticks[row];
+    const u32 written{row_ticks.block_written[block]};
+    const usize block_end{std::min((block + 1) << tick_block_shift, size)};
+    for (usize col{block << tick_block_shift}; col < block_end; ++col) {
+        row_ticks.changed[col] = std::max(row_ticks.changed[col], written);
+    }
+    row_ticks.block_changed[block] = std::max(row_ticks.block_changed[block], written);
+    row_ticks.block_written[block] = 0;
+}
+
+auto Archetype::partial_match(const std::span<const CompTypeInfo> type_list) const -> bool {
+    if (type_list.size() > infos.size()) {
+        return false;
+    }
+
+    return std::ranges::all_of(type_list, [&](const CompTypeInfo& type) { return comp_map.contains(type.id); });
+}
+
+auto Archetype::match(const std::span<const CompTypeInfo> type_list) const -> bool {
+    return type_list.size() == infos.size() and partial_match(type_list);
+}
+} // namespace nid
@@ -4,6 +4,11 @@
 #include "identifiers.h"
 
 #include <algorithm>
+#include <array>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <utility>
 #include <vector>
 #include <cassert>
 #include <span>
@@ -11,6 +16,9 @@
 #include <ankerl/unordered_dense.h>
 
 namespace nid {
+class MappedFile;
+struct ArchetypeUndo;
+
 /**
  * @brief Sorts a component type list based on alignment and ID.
  *
@@ -20,11 +28,14 @@ namespace nid {
  * @param lst The vector of component type infos to be sorted.
  *
  * This function uses the `std::ranges::sort` algorithm with a custom comparator.
- * The comparator prioritizes the `alignment` field of the component type infos in descending order,
- * and in case of a tie, it prioritizes the `id` field in descending order.
+ * Tag components, which have a size of 0, are placed after all other components. Within both groups
+ * the components are sorted by their `id` in descending order.
  */
 inline auto sort_component_list(std::span<CompTypeInfo> lst) -> void {
     std::ranges::sort(lst, [](const auto& lhs, const auto& rhs) {
+        if ((lhs.size == 0) != (rhs.size == 0)) {
+            return rhs.size == 0;
+        }
         return lhs.id > rhs.id;
     });
 }
@@ -234,24 +245,117 @@ class RowIterator {
 static_assert(std::contiguous_iterator<RowIterator<usize>>);
 static_assert(std::contiguous_iterator<RowIterator<std::vector<f32>>>);
 
+/**
+ * @brief The ways an Archetype can store its components.
+ */
+enum class ArchetypeStorage : u8 {
+    contiguous, ///< Every row is one buffer that is reallocated when the Archetype grows.
+    chunked,    ///< Fixed-size chunks holding all rows for a power of two of columns, growth appends a chunk.
+    packed,     ///< One buffer holding all rows at aligned offsets, which is reallocated as a whole when the Archetype grows.
+    mapped,     ///< Every row is a reserved range of address space whose pages are committed on growth, contiguous on other platforms than Linux.
+};
+
+/**
+ * @brief Configuration of the component storage of an Archetype.
+ */
+struct StorageConfig {
+    ArchetypeStorage storage{ArchetypeStorage::contiguous}; ///< The storage mode.
+    usize chunk_bytes{16 * 1024};                           ///< The size of a chunk in `ArchetypeStorage::chunked` mode.
+    std::pmr::memory_resource* resource{std::pmr::get_default_resource()}; ///< The resource of the components, ticks and enabled bits, which has to outlive the storage.
+    usize mapped_bytes{usize{1} << 32};                     ///< The address space reserved for every row in `ArchetypeStorage::mapped` mode.
+    bool huge_pages{false};                                 ///< Whether the rows are backed by transparent huge pages in `ArchetypeStorage::mapped` mode.
+    usize mapped_threshold{usize{1} << 14};                 ///< The capacity from which an Archetype maps its rows in `ArchetypeStorage::mapped` mode, smaller ones are contiguous.
+    usize migration_step{0}; ///< The columns moved per operation after growth in contiguous and packed mode, 0 to move all columns at once.
+};
+
 /**
  * @class Archetype
  * @brief Manages a collection of components arranged in a contiguous memory layout.
+ *
+ * The columns are stored in chunks of `1 << chunk_shift` columns. In contiguous mode there is a single chunk that
+ * is reallocated on growth. In chunked mode every chunk is one allocation of `StorageConfig::chunk_bytes`
+ * holding all rows, growth appends a chunk and components never move while they are stored in the Archetype.
+ * Packed mode is a single chunk like contiguous mode, but all rows share one allocation.
+ *
+ * Mapped mode is a single chunk whose rows never move. Every row reserves `StorageConfig::mapped_bytes` of address
+ * space with `mmap` and growth only commits more pages of it, so growing neither copies components nor calls their
+ * move constructors. The component buffers bypass the memory resource, the ticks and enabled bits still use it.
+ * An Archetype in mapped mode starts out contiguous and only maps its rows once it grows to
+ * `StorageConfig::mapped_threshold` columns, so small tables do not reserve address space.
+ *
+ * With a `StorageConfig::migration_step`, growth in contiguous and packed mode allocates the new buffers but leaves
+ * the existing columns in the old ones. Every later push or removal moves at most `migration_step` of them, so no
+ * single operation relocates a whole table. A growth by doubling is always finished before the next one starts.
  */
 class Archetype {
     static constexpr usize start_capacity{10};                 ///< Initial capacity for components.
-    std::vector<void*> rows;                                   ///< Storage for component data.
+    std::vector<void*> rows;                                   ///< The start of every data row in every chunk, indexed by `chunk * data_rows + row`.
     CompTypeList infos;                                        ///< List of component type information.
     ankerl::unordered_dense::map<ComponentId, usize> comp_map; ///< Map from component id to row.
+    std::vector<usize> index_rows;                             ///< The row of every dense component index, `no_row` if absent.
+    usize data_rows{0};                                        ///< The number of rows with storage, the rows of tag components follow them.
     usize capacity;                                            ///< Current capacity of the archetype.
     usize size{0};                                             ///< Number of components currently stored.
 
+    ArchetypeStorage storage;      ///< The storage mode.
+    usize chunk_shift;             ///< Log2 of the number of columns per chunk.
+    usize chunk_mask;              ///< The mask of the column index inside a chunk.
+    usize chunk_bytes{0};          ///< The size of a chunk allocation in chunked mode.
+    usize chunk_alignment{0};      ///< The alignment of a chunk allocation in chunked mode and of the buffer in packed mode.
+    std::vector<usize> offsets;    ///< The offset of every row inside a chunk in chunked mode.
+    std::vector<void*> chunks;     ///< The chunk allocations in chunked mode.
+    void* block{nullptr};          ///< The allocation of all rows in packed mode.
+    usize mapped_bytes{0};         ///< The address space reserved for every row in mapped mode.
+    bool huge_pages{false};        ///< Whether the rows are backed by transparent huge pages in mapped mode.
+    usize mapped_threshold{std::numeric_limits<usize>::max()}; ///< The capacity from which a contiguous Archetype switches to mapped mode.
+    usize migration_step{0};       ///< The columns moved per operation while a growth is pending, 0 to grow at once.
+    std::vector<void*> old_rows;   ///< The start of every data row before a pending growth, empty if no growth is pending.
+    void* old_block{nullptr};      ///< The allocation of `old_rows` in packed mode.
+    usize old_capacity{0};         ///< The capacity of `old_rows`.
+    usize migrated{0};             ///< The columns before this one were moved from `old_rows` to `rows`.
+    usize migration_end{0};        ///< The columns in `[migrated, migration_end)` are still in `old_rows`, 0 if no growth is pending.
+    std::pmr::memory_resource* resource; ///< The resource of the component buffers, ticks and enabled bits.
+
+    /**
+     * @brief The change ticks of the components in one row.
+     *
+     * A tick block is `1 << tick_block_shift` consecutive columns. The block ticks are upper bounds of the ticks
+     * of their columns, which lets a filtered query skip a block without looking at its columns.
+     */
+    struct RowTicks {
+        std::pmr::vector<u32> added;         ///< The tick at which the component of every column was added.
+        std::pmr::vector<u32> changed;       ///< The tick at which the component of every column was last changed.
+        std::pmr::vector<u32> block_added;   ///< An upper bound of the added ticks of every tick block.
+        std::pmr::vector<u32> block_changed; ///< An upper bound of the changed ticks of every tick block.
+        std::pmr::vector<u32> block_written; ///< The tick at which every column of a tick block was written at once, 0 if never.
+
+        explicit RowTicks(std::pmr::memory_resource* resource)
+            : added(resource), changed(resource), block_added(resource), block_changed(resource), block_written(resource) {}
+    };
+
+    static constexpr usize max_tick_block_shift{8}; ///< Log2 of the largest number of columns in a tick block.
+    static constexpr u32 no_tick{0};                ///< The tick of an Archetype without a tick source.
+
+    std::vector<RowTicks> ticks; ///< The change ticks of every row.
+    usize tick_block_shift;      ///< Log2 of the number of columns in a tick block, never larger than `chunk_shift`.
+    const u32* change_tick;      ///< The current tick, which is owned by the World.
+
+    static constexpr usize enabled_word_bits{64};
+    std::vector<usize> enableable_rows;    ///< The rows of enableable components.
+    std::vector<std::pmr::vector<u64>> enabled; ///< The enabled bits of every data row, bit `col % 64` of word `col / 64`, empty for other rows.
+
+    ArchetypeUndo* undo{nullptr}; ///< The log that saves every tick block before its first write, `nullptr` if writes are not logged.
+
   public:
+    static constexpr usize no_row{std::numeric_limits<usize>::max()}; ///< The row of a component the Archetype does not have.
+
     /**
      * @brief Constructs an Archetype with the given component type list.
      * @param comp_infos List of component type information.
+     * @param config The storage configuration.
+     * @param tick_source The current change tick, which has to outlive the Archetype. All ticks are 0 if it is `nullptr`.
      */
-    explicit Archetype(CompTypeList comp_infos);
+    explicit Archetype(CompTypeList comp_infos, const StorageConfig& config = {}, const u32* tick_source = nullptr);
 
     /**
      * @brief Destructor for Archetype.
@@ -286,6 +390,49 @@ class Archetype {
      */
     [[nodiscard]] auto len() const noexcept -> usize { return size; }
 
+    /**
+     * @brief Gets the storage mode of the Archetype.
+     * @return The storage mode.
+     */
+    [[nodiscard]] auto storage_mode() const noexcept -> ArchetypeStorage { return storage; }
+
+    /**
+     * @brief Gets the number of contiguous columns starting at `col`.
+     *
+     * Components of consecutive columns are adjacent in memory up to the end of the chunk of `col`.
+     *
+     * @param col The first column.
+     * @return The number of columns from `col` to the end of its chunk.
+     */
+    [[nodiscard]] auto run_len(const usize col) const noexcept -> usize {
+        if (migration_end != 0) [[unlikely]] {
+            if (col < migrated) {
+                return migrated - col;
+            }
+            if (col < migration_end) {
+                return migration_end - col;
+            }
+        }
+        return (chunk_mask & ~col) + 1;
+    }
+
+    /**
+     * @brief Calls `func` for every contiguous run of columns in `[col, col + count)`.
+     *
+     * @param col The first column.
+     * @param count The number of columns.
+     * @param func The function to call with the first column and the length of every run.
+     */
+    template<typename Func>
+    auto for_each_run(usize col, const usize count, Func&& func) const -> void {
+        const usize end{col + count};
+        while (col < end) {
+            const usize len{std::min(end - col, run_len(col))};
+            func(col, len);
+            col += len;
+        }
+    }
+
     /**
      * @brief Reserves additional capacity for the Archetype.
      * @param new_capacity The new capacity to reserve.
@@ -297,6 +444,17 @@ class Archetype {
      */
     auto grow() -> void;
 
+    /**
+     * @brief Checks if columns of an earlier growth are still waiting to be moved to the new buffers.
+     * @return true if a growth is pending.
+     */
+    [[nodiscard]] auto growth_pending() const noexcept -> bool { return migration_end != 0; }
+
+    /**
+     * @brief Moves all columns that are left of a pending growth, for example at the end of a frame.
+     */
+    auto finish_growth() -> void;
+
     /**
      * @brief Prepares the Archetype to push new components by ensuring sufficient capacity.
      *
@@ -314,7 +472,12 @@ class Archetype {
      *
      * @param count The number of columns to add to the current size.
      */
-    auto increase_size(const usize count) -> void { size += count; }
+    auto increase_size(const usize count) -> void {
+        size += count;
+        push_ticks(count);
+        push_enabled(count);
+        step_growth();
+    }
 
     /**
      * @brief Decrease the current size of the Archetype by the specified count.
@@ -326,14 +489,23 @@ class Archetype {
     auto decrease_size(const usize count) -> void {
         NIDAVELLIR_ASSERT(count <= size and size > 0, "The size needs to be larger than 0 before a decrease and needs to be non-negative after");
         size -= count;
+        pop_ticks();
+        pop_enabled();
+        if (migration_end > size) [[unlikely]] {
+            trim_growth();
+        }
     }
 
     /**
      * @brief Swaps the components at two specified columns.
+     *
+     * The components are swapped in place, so the swap needs no spare column and never grows the Archetype.
+     * Like other column moves the swap is not logged, the caller has to save the whole table while a log is set.
+     *
      * @param first Index of the first column.
      * @param second Index of the second column.
      */
-    auto swap(usize first, usize second) noexcept -> void;
+    auto swap(usize first, usize second) -> void;
 
     /**
      * @brief Removes the component at the specified column.
@@ -342,6 +514,41 @@ class Archetype {
      */
     [[nodiscard]] auto remove(usize col) -> usize;
 
+    /**
+     * @brief Moves all columns of another Archetype to the end of this one, leaving the other Archetype empty.
+     *
+     * The components of every data row of `src` are moved with one `move_ctor_dtor` per contiguous run, their ticks
+     * and enabled bits are carried along. Rows that `row_map` does not map are destroyed. The rows of this Archetype
+     * that no row maps to are left uninitialized and stamped as added.
+     * If this Archetype is empty and both use contiguous storage from the same resource, the buffers of the moved rows
+     * are swapped instead of moving any component.
+     *
+     * @param src The Archetype whose columns are moved, which must not be this one.
+     * @param row_map The row in this Archetype of every row of `src`, `no_row` for rows that are destroyed.
+     * @return The column of the first moved component.
+     */
+    auto append_columns(Archetype& src, std::span<const usize> row_map) -> usize;
+
+    /**
+     * @brief Destroys all components, keeping the capacity.
+     */
+    auto clear() noexcept -> void;
+
+    /**
+     * @brief Backs the first `count` columns of a row with pages of a file in mapped mode.
+     *
+     * The pages are private copies of the file, so the components are taken over without reading or constructing them.
+     * The Archetype has to be empty and have a capacity of at least `count`, and the caller increases its size afterwards.
+     *
+     * @param row Row index of a component that is saved as raw bytes.
+     * @param file The file holding the components.
+     * @param offset The offset of the first component in the file.
+     * @param count The number of components.
+     * @return true if the pages were mapped, false if the Archetype is not in mapped mode, the row is smaller than a page or
+     * the offset is not a multiple of the page size. The row is unchanged in that case.
+     */
+    auto map_file_row(usize row, const MappedFile& file, usize offset, usize count) -> bool;
+
     /**
      * @brief Retrieves the component type list.
      * @return A constant reference to the CompTypeList containing component information.
@@ -356,6 +563,23 @@ class Archetype {
      */
     [[nodiscard]] auto get_row(const ComponentId id) const -> usize { return comp_map.at(id); }
 
+    /**
+     * @brief Checks if the Archetype stores the component with the specified ID.
+     * @param id The component ID to look for.
+     * @return true if the component is part of the Archetype, false otherwise.
+     */
+    [[nodiscard]] auto has_component(const ComponentId id) const -> bool { return comp_map.contains(id); }
+
+    /**
+     * @brief Gets the row of a component by its dense index in the world.
+     *
+     * Only components whose `CompTypeInfo::index` was set when the Archetype was created can be found.
+     *
+     * @param index The dense index of the component.
+     * @return The row of the component, `no_row` if the Archetype does not have it.
+     */
+    [[nodiscard]] auto row_of(const usize index) const noexcept -> usize { return index < index_rows.size() ? index_rows[index] : no_row; }
+
     /**
      * @brief Checks if there is a partial match with the given type list.
      *
@@ -365,7 +589,7 @@ class Archetype {
      * @param type_list A span representing the list of types to be checked.
      * @return true if there is a partial match, false otherwise.
      */
-    [[nodiscard]] auto partial_match(std::span<CompTypeInfo> type_list) const -> bool;
+    [[nodiscard]] auto partial_match(std::span<const CompTypeInfo> type_list) const -> bool;
 
     /**
      * @brief Checks if the given type list matches the types within the archetype.
@@ -373,7 +597,7 @@ class Archetype {
      * @param type_list A span representing the list of types to be matched.
      * @return true if its is a match, false otherwise.
      */
-    [[nodiscard]] auto match(std::span<CompTypeInfo> type_list) const -> bool;
+    [[nodiscard]] auto match(std::span<const CompTypeInfo> type_list) const -> bool;
 
     /**
      * @brief Adds a new column to the Archetype.
@@ -388,19 +612,34 @@ class Archetype {
      */
     template<Component... Ts>
     [[nodiscard]] auto emplace_back(Ts&&... pack) -> usize {
+        return emplace_back_rows(std::array<usize, sizeof...(Ts)>{get_row(type_id<Ts>())...}, std::forward<Ts>(pack)...);
+    }
+
+    /**
+     * @brief Adds components to the end of the Archetype, using rows that were already resolved.
+     * @tparam Ts Types of the components.
+     * @param pack_rows The row of every component in the pack.
+     * @param pack Components to be added.
+     * @return Index of the added column.
+     */
+    template<Component... Ts>
+    [[nodiscard]] auto emplace_back_rows(const std::array<usize, sizeof...(Ts)>& pack_rows, Ts&&... pack) -> usize {
         if (capacity == size) {
             grow();
         }
 
-        if constexpr (sizeof...(Ts) > 0) {
-            auto func = [&]<Component Ty>(const usize index, Ty&& t) {
-                new (static_cast<u8*>(rows[index]) + infos[index].size * size) std::decay_t<Ty>(std::forward<Ty>(t));
-            };
-
-            (..., func(get_row(type_id<Ts>()), std::forward<Ts>(pack)));
-        }
+        [&]<usize... Is>(std::index_sequence<Is...> /*unused*/) {
+            (..., [&] {
+                if constexpr (!TagComponent<Ts>) {
+                    new (get_raw(size, pack_rows[Is])) std::decay_t<Ts>(std::forward<Ts>(pack));
+                }
+            }());
+        }(std::index_sequence_for<Ts...>{});
 
         const auto col = size++;
+        push_ticks(1);
+        push_enabled(1);
+        step_growth();
         return col;
     }
 
@@ -416,17 +655,32 @@ class Archetype {
      * @param pack New components to update the column with.
      */
     template<Component... Ts>
-    [[nodiscard]] auto update(const usize col, Ts&&... pack) {
+    auto update(const usize col, Ts&&... pack) -> void {
+        update_rows(col, std::array<usize, sizeof...(Ts)>{get_row(type_id<Ts>())...}, std::forward<Ts>(pack)...);
+    }
+
+    /**
+     * @brief Updates components in an existing column of the Archetype, using rows that were already resolved.
+     * @tparam Ts Types of the components to update.
+     * @param col The column to be updated.
+     * @param pack_rows The row of every component in the pack.
+     * @param pack New components to update the column with.
+     */
+    template<Component... Ts>
+    auto update_rows(const usize col, const std::array<usize, sizeof...(Ts)>& pack_rows, Ts&&... pack) -> void {
         NIDAVELLIR_ASSERT(col < size, "An update can only happen in an initialized column");
-        if constexpr (sizeof...(Ts) > 0) {
+        [&]<usize... Is>(std::index_sequence<Is...> /*unused*/) {
             auto func = [&]<Component Ty>(const usize index, Ty&& t) {
-                void* dst = static_cast<u8*>(rows[index]) + infos[index].size * col;
-                infos[index].dtor(dst, 1);
-                new (dst) std::decay_t<Ty>(std::forward<Ty>(t));
+                if constexpr (!TagComponent<Ty>) {
+                    mark_changed(col, index);
+                    void* dst = get_raw(col, index);
+                    infos[index].ops->dtor(dst, 1);
+                    new (dst) std::decay_t<Ty>(std::forward<Ty>(t));
+                }
             };
 
-            (..., func(get_row(type_id<Ts>()), std::forward<Ts>(pack)));
-        }
+            (..., func(pack_rows[Is], std::forward<Ts>(pack)));
+        }(std::index_sequence_for<Ts...>{});
     }
 
     /**
@@ -441,15 +695,32 @@ class Archetype {
      * @param pack New components to create in the specified column.
      */
     template<Component... Ts>
-    [[nodiscard]] auto create(const usize col, Ts&&... pack) {
+    auto create(const usize col, Ts&&... pack) -> void {
+        create_rows(col, std::array<usize, sizeof...(Ts)>{get_row(type_id<Ts>())...}, std::forward<Ts>(pack)...);
+    }
+
+    /**
+     * @brief Creates components in an existing column of the Archetype, using rows that were already resolved.
+     * @tparam Ts Types of the components to create.
+     * @param col The column where the components will be created.
+     * @param pack_rows The row of every component in the pack.
+     * @param pack New components to create in the specified column.
+     */
+    template<Component... Ts>
+    auto create_rows(const usize col, const std::array<usize, sizeof...(Ts)>& pack_rows, Ts&&... pack) -> void {
         NIDAVELLIR_ASSERT(col < capacity, "A create can only happen in an initialized column");
-        if constexpr (sizeof...(Ts) > 0) {
+        [&]<usize... Is>(std::index_sequence<Is...> /*unused*/) {
             auto func = [&]<Component Ty>(const usize index, Ty&& t) {
-                new (static_cast<u8*>(rows[index]) + infos[index].size * col) std::decay_t<Ty>(std::forward<Ty>(t));
+                if constexpr (!TagComponent<Ty>) {
+                    new (get_raw(col, index)) std::decay_t<Ty>(std::forward<Ty>(t));
+                    if (col < size) {
+                        set_ticks(col, index, *change_tick, *change_tick);
+                    }
+                }
             };
 
-            (..., func(get_row(type_id<Ts>()), std::forward<Ts>(pack)));
-        }
+            (..., func(pack_rows[Is], std::forward<Ts>(pack)));
+        }(std::index_sequence_for<Ts...>{});
     }
 
     /**
@@ -460,6 +731,7 @@ class Archetype {
      */
     template<Component T>
     [[nodiscard]] auto get_component(const usize col) -> T& {
+        static_assert(!TagComponent<T>, "Tag components have no storage");
         NIDAVELLIR_ASSERT(col < size, "Can only get components from initialized columns");
         return *static_cast<T*>(get_raw(col, comp_map.at(type_id<T>())));
     }
@@ -471,6 +743,9 @@ class Archetype {
      */
     template<Component T>
     [[nodiscard]] auto begin() -> RowIterator<T> {
+        static_assert(!TagComponent<T>, "Tag components have no storage");
+        NIDAVELLIR_ASSERT(storage != ArchetypeStorage::chunked, "Row iterators require a single chunk");
+        finish_growth();
         return RowIterator<T>(static_cast<T*>(get_raw(0, comp_map.at(type_id<T>()))));
     }
 
@@ -481,6 +756,9 @@ class Archetype {
      */
     template<Component T>
     [[nodiscard]] auto end() -> RowIterator<T> {
+        static_assert(!TagComponent<T>, "Tag components have no storage");
+        NIDAVELLIR_ASSERT(storage != ArchetypeStorage::chunked, "Row iterators require a single chunk");
+        finish_growth();
         return RowIterator<T>(static_cast<T*>(get_raw(size, comp_map.at(type_id<T>()))));
     }
 
@@ -491,8 +769,367 @@ class Archetype {
      * @return Pointer to the memory.
      */
     [[nodiscard]] auto get_raw(const usize col, const usize row) const -> void* {
-        NIDAVELLIR_ASSERT(row < rows.size(), "Row should never be less than the amount of rows in the archetype");
-        return static_cast<u8*>(rows[row]) + infos[row].size * col;
+        NIDAVELLIR_ASSERT(row < data_rows, "Only rows with storage have memory");
+        if (col - migrated < migration_end - migrated) [[unlikely]] {
+            return static_cast<u8*>(old_rows[row]) + infos[row].size * col;
+        }
+        return static_cast<u8*>(rows[(col >> chunk_shift) * data_rows + row]) + infos[row].size * (col & chunk_mask);
+    }
+
+    /**
+     * @brief Gets the number of rows with storage.
+     *
+     * The rows of tag components come after the rows with storage and have no memory and no change ticks.
+     *
+     * @return The number of rows that are not tags.
+     */
+    [[nodiscard]] auto data_row_count() const noexcept -> usize { return data_rows; }
+
+    /**
+     * @brief Gets the number of columns in a tick block.
+     * @return The number of columns in a tick block, which is a power of two that never exceeds a chunk.
+     */
+    [[nodiscard]] auto tick_block_len() const noexcept -> usize { return usize{1} << tick_block_shift; }
+
+    /**
+     * @brief Gets the tick at which a component was added.
+     * @param col Column index of the component.
+     * @param row Row index of the component.
+     * @return The added tick.
+     */
+    [[nodiscard]] auto added_tick(const usize col, const usize row) const -> u32 {
+        NIDAVELLIR_ASSERT(col < size, "Ticks only exist for initialized columns");
+        return ticks[row].added[col];
+    }
+
+    /**
+     * @brief Gets the tick at which a component was last changed.
+     * @param col Column index of the component.
+     * @param row Row index of the component.
+     * @return The changed tick.
+     */
+    [[nodiscard]] auto changed_tick(const usize col, const usize row) const -> u32 {
+        NIDAVELLIR_ASSERT(col < size, "Ticks only exist for initialized columns");
+        return std::max(ticks[row].changed[col], ticks[row].block_written[col >> tick_block_shift]);
+    }
+
+    /**
+     * @brief Gets an upper bound of the added ticks of a tick block.
+     * @param block Index of the tick block.
+     * @param row Row index of the components.
+     * @return A tick that is not smaller than the added tick of any column in the block.
+     */
+    [[nodiscard]] auto block_added_tick(const usize block, const usize row) const -> u32 { return ticks[row].block_added[block]; }
+
+    /**
+     * @brief Gets an upper bound of the changed ticks of a tick block.
+     * @param block Index of the tick block.
+     * @param row Row index of the components.
+     * @return A tick that is not smaller than the changed tick of any column in the block.
+     */
+    [[nodiscard]] auto block_changed_tick(const usize block, const usize row) const -> u32 {
+        return std::max(ticks[row].block_changed[block], ticks[row].block_written[block]);
+    }
+
+    /**
+     * @brief Gets the tick at which every column of a tick block was written at once.
+     * @param block Index of the tick block.
+     * @param row Row index of the components.
+     * @return The tick of the last write of the whole block, 0 if there was none.
+     */
+    [[nodiscard]] auto block_written_tick(const usize block, const usize row) const -> u32 { return ticks[row].block_written[block]; }
+
+    /**
+     * @brief Marks a component as changed at the current tick.
+     * @param col Column index of the component.
+     * @param row Row index of the component.
+     */
+    auto mark_changed(const usize col, const usize row) -> void {
+        NIDAVELLIR_ASSERT(col < size, "Ticks only exist for initialized columns");
+        if (undo != nullptr) [[unlikely]] {
+            save_blocks(col, 1, row);
+        }
+        const u32 tick{*change_tick};
+        ticks[row].changed[col] = tick;
+        ticks[row].block_changed[col >> tick_block_shift] = tick;
+    }
+
+    /**
+     * @brief Marks a range of components in a row as changed at the current tick.
+     *
+     * Blocks that are covered completely are marked with a single write. Components have to be marked before they are
+     * written, so an undo log can save them first.
+     *
+     * @param col The first column.
+     * @param count The number of columns.
+     * @param row Row index of the components.
+     */
+    auto mark_written(usize col, usize count, usize row) -> void;
+
+    /**
+     * @brief Copies the change ticks of a component from another column, which may be in another Archetype.
+     * @param dst_col The column receiving the ticks.
+     * @param dst_row The row receiving the ticks.
+     * @param src The Archetype of the source component.
+     * @param src_col The column of the source component.
+     * @param src_row The row of the source component.
+     */
+    auto copy_ticks(const usize dst_col, const usize dst_row, const Archetype& src, const usize src_col, const usize src_row) -> void {
+        set_ticks(dst_col, dst_row, src.added_tick(src_col, src_row), src.changed_tick(src_col, src_row));
+    }
+
+    /**
+     * @brief Checks if a row belongs to an enableable component.
+     * @param row Row index of the component.
+     * @return true if the components of the row can be disabled, false otherwise.
+     */
+    [[nodiscard]] auto is_enableable(const usize row) const noexcept -> bool { return infos[row].ops->enableable; }
+
+    /**
+     * @brief Checks if a component is enabled.
+     * @param col Column index of the component.
+     * @param row Row index of the component.
+     * @return true if the component is enabled or can not be disabled, false otherwise.
+     */
+    [[nodiscard]] auto is_enabled(const usize col, const usize row) const noexcept -> bool {
+        return row >= data_rows or !is_enableable(row) or (enabled[row][col / enabled_word_bits] >> (col % enabled_word_bits) & 1) != 0;
+    }
+
+    /**
+     * @brief Enables or disables a component of an enableable row.
+     * @param col Column index of the component.
+     * @param row Row index of the component.
+     * @param value true to enable the component, false to disable it.
+     */
+    auto set_enabled(const usize col, const usize row, const bool value) -> void {
+        NIDAVELLIR_ASSERT(col < size and is_enableable(row), "Only initialized components of enableable rows can be disabled");
+        if (undo != nullptr) [[unlikely]] {
+            save_blocks(col, 1, row);
+        }
+        write_enabled(col, row, value);
+    }
+
+    /**
+     * @brief Gets the enabled bits of an enableable row.
+     * @param row Row index of the components.
+     * @return One bit per column, bit `col % 64` of word `col / 64`. Bits past the last column are clear.
+     */
+    [[nodiscard]] auto enabled_words(const usize row) const noexcept -> std::span<const u64> { return enabled[row]; }
+
+    /**
+     * @brief Overwrites the enabled bits of an enableable row.
+     * @param row Row index of the components.
+     * @param words One bit per column like `enabled_words`, bits past the last column are ignored.
+     */
+    auto assign_enabled(usize row, std::span<const u64> words) -> void;
+
+    /**
+     * @brief Copies the enabled bit of a component from another column, which may be in another Archetype.
+     * @param dst_col The column receiving the bit.
+     * @param dst_row The row receiving the bit.
+     * @param src The Archetype of the source component.
+     * @param src_col The column of the source component.
+     * @param src_row The row of the source component.
+     */
+    auto copy_enabled(const usize dst_col, const usize dst_row, const Archetype& src, const usize src_col, const usize src_row) -> void {
+        if (is_enableable(dst_row)) {
+            set_enabled(dst_col, dst_row, src.is_enabled(src_col, src_row));
+        }
+    }
+
+    /**
+     * @brief Gets the undo log of the Archetype.
+     * @return The log that saves the tick blocks written from now on, `nullptr` if writes are not logged.
+     */
+    [[nodiscard]] auto undo_log() const noexcept -> ArchetypeUndo* { return undo; }
+
+    /**
+     * @brief Starts or stops logging writes.
+     *
+     * While a log is set, the first write to a tick block of a data row, through `mark_written`, `mark_changed` or
+     * `set_enabled`, copies the components and enabled bits of the block into the log. Adding, removing or moving
+     * columns is not logged, the caller has to save the whole table before it changes its structure.
+     *
+     * @param log The log, which has to outlive its use by the Archetype, or `nullptr` to stop logging.
+     */
+    auto set_undo(ArchetypeUndo* log) noexcept -> void { undo = log; }
+
+    /**
+     * @brief Copies the blocks of an undo log back, undoing every logged write.
+     *
+     * The columns of the Archetype have to be the ones the log was taken of. The restored components are marked as
+     * written at the current tick and writes to them are not logged again.
+     *
+     * @param log The undo log, which may have been taken of another Archetype with the same rows and columns.
+     */
+    auto restore_blocks(const ArchetypeUndo& log) -> void;
+
+    /**
+     * @brief Appends copies of all columns of another Archetype with the same rows.
+     *
+     * The components are copied with `copy_ctor`, the enabled bits are carried along and the copies are stamped as
+     * added at the current tick.
+     *
+     * @param src The Archetype whose columns are copied, whose components have to be copyable.
+     */
+    auto copy_columns(const Archetype& src) -> void;
+
+  private:
+    /**
+     * @brief Moves the next `migration_step` columns of a pending growth.
+     */
+    auto step_growth() -> void {
+        if (migration_end != 0) [[unlikely]] {
+            migrate(migration_step);
+        }
+    }
+
+    /**
+     * @brief Moves columns of a pending growth to the new buffers, freeing the old buffers once all are moved.
+     * @param count The largest number of columns to move.
+     */
+    auto migrate(usize count) -> void;
+
+    /**
+     * @brief Shrinks a pending growth to the current size after columns were removed.
+     */
+    auto trim_growth() noexcept -> void;
+
+    /**
+     * @brief Frees the buffers of a pending growth and marks it as finished.
+     */
+    auto release_old_rows() noexcept -> void;
+
+    /**
+     * @brief Saves the tick blocks of `[col, col + count)` in a row to the undo log, unless they are saved already.
+     * @param col The first column.
+     * @param count The number of columns.
+     * @param row Row index of the components.
+     */
+    auto save_blocks(usize col, usize count, usize row) -> void;
+
+    /**
+     * @brief Sets an enabled bit without logging it.
+     * @param col Column index of the component.
+     * @param row Row index of the component.
+     * @param value true to enable the component, false to disable it.
+     */
+    auto write_enabled(const usize col, const usize row, const bool value) noexcept -> void {
+        const u64 bit{u64{1} << (col % enabled_word_bits)};
+        auto& word = enabled[row][col / enabled_word_bits];
+        word = value ? word | bit : word & ~bit;
     }
+
+    /**
+     * @brief Enables the last `count` columns of every enableable row.
+     * @param count The number of new columns.
+     */
+    auto push_enabled(usize count) -> void;
+
+    /**
+     * @brief Shrinks the enabled bits to the current size.
+     */
+    auto pop_enabled() -> void;
+
+    /**
+     * @brief Stamps the last `count` columns as added at the current tick.
+     * @param count The number of new columns.
+     */
+    auto push_ticks(usize count) -> void;
+
+    /**
+     * @brief Shrinks the ticks to the current size.
+     */
+    auto pop_ticks() -> void;
+
+    /**
+     * @brief Sets the ticks of a single component.
+     * @param col Column index of the component.
+     * @param row Row index of the component.
+     * @param added The added tick.
+     * @param changed The changed tick.
+     */
+    auto set_ticks(usize col, usize row, u32 added, u32 changed) -> void;
+
+    /**
+     * @brief Applies the written tick of a block to every column of the block.
+     * @param block Index of the tick block.
+     * @param row Row index of the components.
+     */
+    auto flatten_block(usize block, usize row) -> void;
+
+    /**
+     * @brief Allocates a buffer holding `block_capacity` columns of every row in packed mode.
+     *
+     * The rows are laid out one after another, every row starting at the alignment of its component.
+     *
+     * @param block_capacity The number of columns of every row.
+     * @param block_rows Set to the start of every row in the buffer.
+     * @return The allocation, which is aligned to `chunk_alignment`.
+     */
+    auto allocate_block(usize block_capacity, std::span<void*> block_rows) const -> void*;
+
+    /**
+     * @brief Gets the size of a buffer holding `block_capacity` columns of every row in packed mode.
+     * @param block_capacity The number of columns of every row.
+     * @return The size of the buffer in bytes.
+     */
+    [[nodiscard]] auto block_bytes(usize block_capacity) const -> usize;
+
+    /**
+     * @brief Commits the pages of every row for at least `new_capacity` columns in mapped mode.
+     *
+     * The capacity is set to the number of columns that fit in the committed pages of every row.
+     *
+     * @param new_capacity The number of columns.
+     * @throws std::bad_alloc If a row does not fit in its reserved address space or its pages could not be committed.
+     */
+    auto commit_rows(usize new_capacity) -> void;
+
+    /**
+     * @brief Switches to mapped mode with at least `new_capacity` columns, moving the stored components into the mapped rows.
+     * @param new_capacity The number of columns.
+     * @throws std::bad_alloc If the address space could not be reserved or its pages could not be committed.
+     */
+    auto map_rows(usize new_capacity) -> void;
+
+    /**
+     * @brief Appends a chunk in chunked mode.
+     */
+    auto allocate_chunk() -> void;
+
+    /**
+     * @brief Destroys all components and frees all memory.
+     */
+    auto release() noexcept -> void;
+};
+
+/**
+ * @brief The components of an Archetype that were written since the log was set, saved one tick block at a time.
+ *
+ * A block is saved before its first write, so the log holds the state of every written block at the time the log was
+ * set. Blocks are saved by their columns rather than their tick block index, so the log can also be restored onto a
+ * copy of the Archetype in another storage mode.
+ */
+struct ArchetypeUndo {
+    /** @brief A range of saved columns of one row. */
+    struct Block {
+        usize row;   ///< The row of the columns.
+        usize begin; ///< The first column.
+        usize count; ///< The number of columns.
+        usize first; ///< The column of the first saved component in the copy of the row.
+        usize words; ///< The index of the first saved enabled word in `enabled`, unused if the row is not enableable.
+    };
+
+    std::vector<std::vector<u64>> saved;            ///< One bit per tick block of every data row, set once the block is saved.
+    std::vector<Block> blocks;                      ///< The saved blocks.
+    std::vector<std::unique_ptr<Archetype>> copies; ///< The saved components of every data row, created on first use.
+    std::vector<u64> enabled;                       ///< The enabled words of the saved blocks of enableable rows.
+
+    /**
+     * @brief Checks if the log holds any block.
+     * @return true if no write was logged.
+     */
+    [[nodiscard]] auto empty() const noexcept -> bool { return blocks.empty(); }
 };
 } // namespace nid
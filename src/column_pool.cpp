@@ -0,0 +1,62 @@
+#include "column_pool.h"
+
+#include <algorithm>
+#include <bit>
+#include <new>
+
+namespace nid {
+ColumnPoolResource::ColumnPoolResource(const usize limit, std::pmr::memory_resource* upstream) : upstream(upstream), limit(limit) {}
+
+ColumnPoolResource::~ColumnPoolResource() {
+    NIDAVELLIR_ASSERT(in_use == 0, "Every allocation has to be deallocated before the pool is destroyed");
+    for (const auto& [block, index] : blocks) {
+        upstream->deallocate(block, min_pooled_bytes << index, block_alignment);
+    }
+}
+
+auto ColumnPoolResource::size_class(const usize bytes, const usize alignment) noexcept -> usize {
+    if (bytes > max_pooled_bytes or alignment > block_alignment) {
+        return class_count;
+    }
+    return static_cast<usize>(std::bit_width(std::max(bytes, min_pooled_bytes) - 1) - std::countr_zero(min_pooled_bytes));
+}
+
+auto ColumnPoolResource::do_allocate(const usize bytes, const usize alignment) -> void* {
+    const usize index{size_class(bytes, alignment)};
+    const usize charged{index == class_count ? bytes : min_pooled_bytes << index};
+    if (charged > limit - in_use) {
+        throw std::bad_alloc();
+    }
+
+    void* ptr{nullptr};
+    if (index == class_count) {
+        ptr = upstream->allocate(bytes, alignment);
+        reserved += bytes;
+    } else if (free_lists[index] != nullptr) {
+        ptr = free_lists[index];
+        free_lists[index] = *static_cast<void**>(ptr);
+    } else {
+        ptr = upstream->allocate(charged, block_alignment);
+        blocks.emplace_back(ptr, index);
+        reserved += charged;
+    }
+
+    in_use += charged;
+    return ptr;
+}
+
+auto ColumnPoolResource::do_deallocate(void* ptr, const usize bytes, const usize alignment) -> void {
+    const usize index{size_class(bytes, alignment)};
+    if (index == class_count) {
+        upstream->deallocate(ptr, bytes, alignment);
+        reserved -= bytes;
+        in_use -= bytes;
+        return;
+    }
+
+    // The free list is threaded through the free blocks, which are at least as large as a pointer
+    *static_cast<void**>(ptr) = free_lists[index];
+    free_lists[index] = ptr;
+    in_use -= min_pooled_bytes << index;
+}
+} // namespace nid
@@ -0,0 +1,101 @@
+#pragma once
+#include "core.h"
+
+#include <array>
+#include <bit>
+#include <limits>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+namespace nid {
+/**
+ * @class ColumnPoolResource
+ * @brief A memory resource with power-of-two size classes for component storage.
+ *
+ * Archetype buffers start small and double when they grow, so their sizes fall into a few size classes, and a buffer
+ * that one archetype frees on growth is reused by the next archetype that grows into the same class. Blocks of up to
+ * `max_pooled_bytes` are rounded up to their class, kept on a free list per class when they are deallocated and only
+ * returned upstream when the resource is destroyed. Larger blocks and blocks with an alignment above `block_alignment`
+ * go straight to the upstream resource.
+ *
+ * The resource counts the bytes it hands out and throws `std::bad_alloc` if an allocation would exceed its limit,
+ * which caps the memory of every world that uses it. It is not thread safe, like `std::pmr::unsynchronized_pool_resource`.
+ *
+ * \code{.cpp}
+ * ColumnPoolResource pool(256 * 1024 * 1024);
+ * World world(StorageConfig{.resource = &pool});
+ * world.spawn_n(100'000, Position{}, Velocity{});
+ * usize used = pool.bytes_in_use();
+ * \endcode
+ */
+class ColumnPoolResource final : public std::pmr::memory_resource {
+  public:
+    static constexpr usize no_limit{std::numeric_limits<usize>::max()};
+    static constexpr usize block_alignment{64};          ///< The alignment of every pooled block, a cache line.
+    static constexpr usize min_pooled_bytes{64};         ///< The size of the smallest size class.
+    static constexpr usize max_pooled_bytes{1024 * 1024}; ///< The size of the largest size class.
+
+  private:
+    static constexpr auto class_count = static_cast<usize>(std::countr_zero(max_pooled_bytes) - std::countr_zero(min_pooled_bytes) + 1);
+
+    std::pmr::memory_resource* upstream;
+    usize limit;
+    usize in_use{0};   ///< The bytes handed out, pooled blocks counted with the size of their class.
+    usize reserved{0}; ///< The bytes held from the upstream resource.
+
+    std::array<void*, class_count> free_lists{}; ///< The first free block of every class, the next one is stored in the block.
+    std::vector<std::pair<void*, usize>> blocks; ///< Every pooled block and its class, returned upstream on destruction.
+
+  public:
+    /**
+     * @brief Constructs a pool resource.
+     * @param limit The largest number of bytes that can be in use at the same time.
+     * @param upstream The resource the blocks are allocated from, which has to outlive the pool.
+     */
+    explicit ColumnPoolResource(usize limit = no_limit, std::pmr::memory_resource* upstream = std::pmr::get_default_resource());
+
+    /**
+     * @brief Destructor, which returns all pooled blocks to the upstream resource.
+     *
+     * Blocks that were allocated straight from the upstream resource have to be deallocated before.
+     */
+    ~ColumnPoolResource() override;
+
+    ColumnPoolResource(const ColumnPoolResource&) = delete;
+    auto operator=(const ColumnPoolResource&) -> ColumnPoolResource& = delete;
+    ColumnPoolResource(ColumnPoolResource&&) = delete;
+    auto operator=(ColumnPoolResource&&) -> ColumnPoolResource& = delete;
+
+    /**
+     * @brief Gets the number of bytes that are currently allocated from the pool.
+     * @return The bytes in use, pooled blocks counted with the size of their class.
+     */
+    [[nodiscard]] auto bytes_in_use() const noexcept -> usize { return in_use; }
+
+    /**
+     * @brief Gets the number of bytes that the pool holds from the upstream resource.
+     * @return The bytes in use plus the bytes of all free pooled blocks.
+     */
+    [[nodiscard]] auto bytes_reserved() const noexcept -> usize { return reserved; }
+
+    /**
+     * @brief Gets the limit of the pool.
+     * @return The largest number of bytes that can be in use at the same time.
+     */
+    [[nodiscard]] auto byte_limit() const noexcept -> usize { return limit; }
+
+  private:
+    /**
+     * @brief Gets the size class of an allocation.
+     * @param bytes The size of the allocation.
+     * @param alignment The alignment of the allocation.
+     * @return The index of the size class, `class_count` if the allocation is not pooled.
+     */
+    [[nodiscard]] static auto size_class(usize bytes, usize alignment) noexcept -> usize;
+
+    auto do_allocate(usize bytes, usize alignment) -> void* override;
+    auto do_deallocate(void* ptr, usize bytes, usize alignment) -> void override;
+    [[nodiscard]] auto do_is_equal(const std::pmr::memory_resource& other) const noexcept -> bool override { return this == &other; }
+};
+} // namespace nid
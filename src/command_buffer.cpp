@@ -0,0 +1,122 @@
+#include "command_buffer.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <tuple>
+
+namespace nid {
+CommandBuffer::~CommandBuffer() {
+    clear();
+}
+
+auto CommandBuffer::despawn(const EntityId entity) -> void {
+    commands.push_back(Command{
+        .entity = entity,
+        .kind = CommandKind::despawn,
+        .key = 0,
+        .payload = nullptr,
+        .apply = [](World& w, const EntityId e, [[maybe_unused]] void* p) { w.despawn(e); },
+        .destroy = nullptr,
+        .reserve = nullptr});
+}
+
+auto CommandBuffer::flush() -> void {
+    // Order the commands by entity, keeping the recorded order of each entity, to find the wave of every command
+    std::vector<usize> order(commands.size());
+    for (usize i{0}; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::ranges::stable_sort(order, [&](const usize lhs, const usize rhs) { return commands[lhs].entity < commands[rhs].entity; });
+
+    std::vector<std::vector<usize>> waves;
+    for (usize i{0}, wave{0}; i < order.size(); ++i) {
+        wave = i > 0 and commands[order[i]].entity == commands[order[i - 1]].entity ? wave + 1 : 0;
+        if (wave == waves.size()) {
+            waves.emplace_back();
+        }
+        waves[wave].push_back(order[i]);
+    }
+
+    struct Pending {
+        usize command;
+        ArchetypeId source;
+    };
+
+    std::vector<Pending> pending;
+    for (const auto& wave : waves) {
+        pending.clear();
+        for (const auto index : wave) {
+            auto& command = commands[index];
+            if (world->is_alive(command.entity)) {
+                pending.push_back(Pending{.command = index, .source = world->entity_record(command.entity).archetype});
+            } else {
+                if (command.destroy != nullptr) {
+                    command.destroy(command.payload);
+                }
+                command.payload = nullptr;
+            }
+        }
+
+        auto group_key = [&](const Pending& p) {
+            const auto& command = commands[p.command];
+            return std::tuple{command.kind, command.key, p.source};
+        };
+        std::ranges::stable_sort(pending, [&](const Pending& lhs, const Pending& rhs) { return group_key(lhs) < group_key(rhs); });
+
+        for (usize begin{0}; begin < pending.size();) {
+            usize end{begin + 1};
+            while (end < pending.size() and group_key(pending[end]) == group_key(pending[begin])) {
+                ++end;
+            }
+
+            const auto& first = commands[pending[begin].command];
+            if (first.reserve != nullptr and end - begin > 1) {
+                first.reserve(*world, pending[begin].source, end - begin);
+            }
+
+            for (usize i{begin}; i < end; ++i) {
+                auto& command = commands[pending[i].command];
+                command.apply(*world, command.entity, command.payload);
+                command.payload = nullptr;
+            }
+            begin = end;
+        }
+    }
+
+    clear();
+}
+
+auto CommandBuffer::allocate(const usize size, const usize alignment) -> void* {
+    while (current_block < blocks.size()) {
+        auto& block = blocks[current_block];
+        const auto base = reinterpret_cast<std::uintptr_t>(block.memory.get());
+        const auto offset = ((base + block_offset + alignment - 1) & ~(alignment - 1)) - base;
+        if (offset + size <= block.size) {
+            block_offset = offset + size;
+            return block.memory.get() + offset;
+        }
+
+        ++current_block;
+        block_offset = 0;
+    }
+
+    const usize new_block_size{std::max(block_size, std::bit_ceil(size + alignment))};
+    blocks.push_back(Block{.memory = std::make_unique<std::byte[]>(new_block_size), .size = new_block_size});
+    current_block = blocks.size() - 1;
+    block_offset = 0;
+    return allocate(size, alignment);
+}
+
+auto CommandBuffer::clear() -> void {
+    for (const auto& command : commands) {
+        if (command.payload != nullptr and command.destroy != nullptr) {
+            command.destroy(command.payload);
+        }
+    }
+
+    commands.clear();
+    current_block = 0;
+    block_offset = 0;
+}
+} // namespace nid
@@ -0,0 +1,199 @@
+#pragma once
+#include "core.h"
+#include "comp_type_info.h"
+#include "identifiers.h"
+#include "world.h"
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace nid {
+/**
+ * @class CommandBuffer
+ * @brief Records structural changes to a world and applies them later in one flush.
+ *
+ * Structural changes invalidate the pointers handed out by `World::Query::run`, so they can not be made
+ * while a query is iterating. A command buffer records them instead and applies them with `flush` once the
+ * iteration is done. Component payloads are stored in a linear arena that is reused between flushes.
+ *
+ * The flush applies the commands in waves, where every wave contains at most one command per entity, so the
+ * commands of an entity are applied in the order they were recorded. Within a wave the commands are grouped
+ * by kind, component pack and source archetype, and the target archetype of every group is grown once.
+ * Commands on entities that are no longer alive when they are applied are dropped.
+ *
+ * \code{.cpp}
+ * World world;
+ * CommandBuffer commands(world);
+ *
+ * world.query<Spawner>().run([&](usize len, Spawner* spawners) {
+ *     for (usize i{0}; i < len; ++i) {
+ *         // Spawning directly could reallocate the table of spawners
+ *         commands.spawn(Projectile{.speed = spawners[i].speed});
+ *     }
+ * });
+ *
+ * commands.flush();
+ * \endcode
+ */
+class CommandBuffer {
+    enum class CommandKind : u8 {
+        add,
+        remove,
+        despawn,
+    };
+
+    struct Command {
+        EntityId entity;
+        CommandKind kind;
+        usize key;     ///< The `pack_id` of the component pack.
+        void* payload; ///< The components of an add, `nullptr` otherwise.
+
+        /// Applies the command and destroys its payload.
+        void (*apply)(World& world, EntityId entity, void* payload);
+        /// Destroys the payload of a command that is not applied, `nullptr` if there is no payload.
+        void (*destroy)(void* payload);
+        /// Grows the target archetype of a group of commands, `nullptr` for despawns.
+        void (*reserve)(World& world, ArchetypeId src_id, usize count);
+    };
+
+    struct Block {
+        std::unique_ptr<std::byte[]> memory;
+        usize size;
+    };
+
+    static constexpr usize block_size{64 * 1024};
+
+    World* world;
+    std::vector<Command> commands;
+    std::vector<Block> blocks;
+    usize current_block{0};
+    usize block_offset{0};
+
+  public:
+    /**
+     * @brief Constructs a command buffer that records changes to the given world.
+     * @param world The world the commands are applied to.
+     */
+    explicit CommandBuffer(World& world) : world(&world) {}
+
+    /**
+     * @brief Destructor, which destroys the payloads of commands that were never flushed.
+     */
+    ~CommandBuffer();
+
+    CommandBuffer(const CommandBuffer&) = delete;
+    auto operator=(const CommandBuffer&) -> CommandBuffer& = delete;
+    CommandBuffer(CommandBuffer&&) = delete;
+    auto operator=(CommandBuffer&&) -> CommandBuffer& = delete;
+
+    /**
+     * @brief Gets the number of recorded commands.
+     * @return The number of commands waiting for a flush.
+     */
+    [[nodiscard]] auto len() const noexcept -> usize { return commands.size(); }
+
+    /**
+     * @brief Spawns an entity whose components are added on the next flush.
+     *
+     * The entity is created immediately without any components, so the returned ID can be used in
+     * further commands. Spawning an entity without components does not touch any queried table.
+     *
+     * @tparam Ts The types of the components.
+     * @param pack The components of the new entity.
+     * @return The ID of the new entity.
+     */
+    template<Component... Ts>
+    auto spawn(Ts&&... pack) -> EntityId {
+        const auto entity = world->spawn();
+        if constexpr (sizeof...(Ts) > 0) {
+            add(entity, std::forward<Ts>(pack)...);
+        }
+        return entity;
+    }
+
+    /**
+     * @brief Records adding components to an entity.
+     * @tparam Ts The types of the components.
+     * @param entity The ID of the entity.
+     * @param pack The components to add.
+     */
+    template<Component... Ts>
+    auto add(const EntityId entity, Ts&&... pack) -> void {
+        static_assert(!pack_has_duplicates<Ts...>());
+        static_assert(sizeof...(Ts) > 0);
+        using Payload = std::tuple<std::decay_t<Ts>...>;
+
+        void* payload = allocate(sizeof(Payload), alignof(Payload));
+        new (payload) Payload(std::forward<Ts>(pack)...);
+
+        commands.push_back(Command{
+            .entity = entity,
+            .kind = CommandKind::add,
+            .key = pack_id<Ts...>(),
+            .payload = payload,
+            .apply = [](World& w, const EntityId e, void* p) {
+                auto* tup = static_cast<Payload*>(p);
+                std::apply([&](auto&... comps) { w.add(e, std::move(comps)...); }, *tup);
+                tup->~Payload();
+            },
+            .destroy = [](void* p) { static_cast<Payload*>(p)->~Payload(); },
+            .reserve = [](World& w, const ArchetypeId src_id, const usize count) {
+                const auto target = w.find_or_create_add_edge<std::decay_t<Ts>...>(src_id).target;
+                w.archetypes[target].archetype.prepare_push(count);
+            }});
+    }
+
+    /**
+     * @brief Records removing components from an entity.
+     * @tparam Ts The types of the components.
+     * @param entity The ID of the entity.
+     */
+    template<Component... Ts>
+    auto remove(const EntityId entity) -> void {
+        static_assert(!pack_has_duplicates<Ts...>());
+        static_assert(sizeof...(Ts) > 0);
+
+        commands.push_back(Command{
+            .entity = entity,
+            .kind = CommandKind::remove,
+            .key = pack_id<Ts...>(),
+            .payload = nullptr,
+            .apply = [](World& w, const EntityId e, [[maybe_unused]] void* p) { w.remove<Ts...>(e); },
+            .destroy = nullptr,
+            .reserve = [](World& w, const ArchetypeId src_id, const usize count) {
+                const auto target = w.find_or_create_remove_edge<std::decay_t<Ts>...>(src_id).target;
+                w.archetypes[target].archetype.prepare_push(count);
+            }});
+    }
+
+    /**
+     * @brief Records despawning an entity.
+     * @param entity The ID of the entity.
+     */
+    auto despawn(EntityId entity) -> void;
+
+    /**
+     * @brief Applies all recorded commands to the world and clears the buffer.
+     */
+    auto flush() -> void;
+
+  private:
+    /**
+     * @brief Allocates memory for a payload from the arena.
+     * @param size The size of the payload.
+     * @param alignment The alignment of the payload.
+     * @return A pointer to the memory, which stays valid until the next flush.
+     */
+    auto allocate(usize size, usize alignment) -> void*;
+
+    /**
+     * @brief Destroys the payloads of all commands and resets the arena.
+     */
+    auto clear() -> void;
+};
+} // namespace nid
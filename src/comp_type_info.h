@@ -2,15 +2,25 @@
 #pragma once
 #include "core.h"
 #include "identifiers.h"
+#include "snapshot.h"
 
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <limits>
 #include <type_traits>
+#include <utility>
 #include <vector>
 #include <cassert>
 #include <cstring>
 
-#include "ankerl/unordered_dense.h"
-
 namespace nid {
+/**
+ * @brief The dense index of a component type that is not registered in a world.
+ */
+inline constexpr usize no_component_index{std::numeric_limits<usize>::max()};
+
 // clang-format off
 /**
  * @brief Concept that defines the requirements for a component type.
@@ -29,24 +39,74 @@ concept Component = std::is_move_assignable_v<std::decay_t<T>>
 // clang-format on
 
 /**
- * @brief A structure containing type information and operations for a component.
+ * @brief Concept for component types that are stored in a sparse set instead of the archetype tables.
+ *
+ * A component opts in with a `using is_sparse = void;` member. Adding or removing a sparse component never
+ * moves an entity to another archetype, which suits short-lived tags that are toggled often.
  *
- * This structure holds metadata and function pointers for managing the lifecycle
- * of a component type. It includes functions for construction, destruction,
- * copy construction, copy assignment, move construction, move assignment, and
- * combined move and destruct operations.
+ * @tparam T The type to check.
  */
-struct CompTypeInfo {
-    /**
-     * @brief The unique identifier for the component type.
-     */
-    ComponentId id;
+template<typename T>
+concept SparseComponent = Component<T> and requires { typename std::decay_t<T>::is_sparse; };
 
-    /**
-     * @brief The alignment of the component type.
-     */
-    usize alignment;
+/**
+ * @brief Concept for component types that can be disabled per entity without removing them.
+ *
+ * A component opts in with a `using is_enableable = void;` member. Archetypes keep an enabled bit per entity for
+ * these components and queries skip entities whose component is disabled. Tags and sparse components can not be enableable.
+ *
+ * @tparam T The type to check.
+ */
+template<typename T>
+concept EnableableComponent = Component<T> and requires { typename std::decay_t<T>::is_enableable; } and !std::is_empty_v<std::decay_t<T>> and !SparseComponent<T>;
+
+/**
+ * @brief Concept for empty component types, which are stored without any memory.
+ *
+ * Tags are part of the archetype signature and can be queried, but they have no storage and no change ticks,
+ * and moving an entity never moves or destroys them.
+ *
+ * @tparam T The type to check.
+ */
+template<typename T>
+concept TagComponent = Component<T> and std::is_empty_v<std::decay_t<T>> and !SparseComponent<T>;
+
+/**
+ * @brief Concept for component types with their own snapshot encoding.
+ *
+ * A component opts in with a `save(SnapshotWriter&) const` member and a static `load(SnapshotReader&)` member that
+ * returns the component. Trivially copyable components without these members are saved as their raw bytes.
+ *
+ * @tparam T The type to check.
+ */
+template<typename T>
+concept SerializableComponent = Component<T> and requires(const std::decay_t<T>& value, SnapshotWriter& out, SnapshotReader& in) {
+    value.save(out);
+    { std::decay_t<T>::load(in) } -> std::same_as<std::decay_t<T>>;
+};
+
+/**
+ * @brief The shared instance of a tag component, which every entity with the tag refers to.
+ * @tparam T The decayed tag type.
+ */
+template<TagComponent T>
+inline T tag_instance{};
 
+/**
+ * @brief The number of types in a pack that are stored in the archetype tables.
+ * @tparam Ts The types of the pack.
+ */
+template<typename... Ts>
+inline constexpr usize table_component_count{(usize{0} + ... + (SparseComponent<Ts> ? 0 : 1))};
+
+/**
+ * @brief The lifecycle operations of a component type.
+ *
+ * There is one static instance per component type, `comp_type_ops`, which all type infos
+ * of that type point to. It includes functions for construction, destruction, copy construction, copy assignment,
+ * move construction, move assignment, combined move and destruct operations and swapping.
+ */
+struct CompTypeOps {
     /**
      * @brief Function pointer for the default constructor.
      *
@@ -118,12 +178,77 @@ struct CompTypeInfo {
     void (*move_assign_dtor)(void* dst, void* src, usize count);
 
     /**
-     * @brief The size of the component type in bytes.
+     * @brief Function pointer for swapping components in place.
+     *
+     * @param lhs The first components.
+     * @param rhs The components they are swapped with.
+     * @param count The number of components to swap.
+     */
+    void (*swap)(void* lhs, void* rhs, usize count);
+
+    /**
+     * @brief true if the component type is an `EnableableComponent`.
+     */
+    bool enableable;
+
+    /**
+     * @brief Function pointer for writing components to a snapshot, `nullptr` if the type can not be saved.
+     *
+     * @param src The source of the components.
+     * @param count The number of components to write.
+     * @param out The writer of the snapshot.
+     */
+    void (*save)(const void* src, usize count, SnapshotWriter& out);
+
+    /**
+     * @brief Function pointer for constructing components from a snapshot, `nullptr` if the type can not be loaded.
+     *
+     * @param dst The destination where the components are constructed.
+     * @param count The number of components to read.
+     * @param in The reader of the snapshot.
+     */
+    void (*load)(void* dst, usize count, SnapshotReader& in);
+
+    /**
+     * @brief true if the components are saved as their raw bytes, which a snapshot can hand over without construction.
+     */
+    bool raw_snapshot;
+};
+
+/**
+ * @brief A structure containing type information for a component.
+ *
+ * The type info is copied into every type list, so it only holds the data that is needed to lay out and
+ * compare components. The lifecycle operations live in a shared `CompTypeOps` table.
+ */
+struct CompTypeInfo {
+    /**
+     * @brief The unique identifier for the component type.
+     */
+    ComponentId id;
+
+    /**
+     * @brief The dense index of the component type in its world, `no_component_index` if it is not registered.
+     */
+    usize index;
+
+    /**
+     * @brief The size of the component type in bytes, 0 for tag components.
      */
     usize size;
 
+    /**
+     * @brief The alignment of the component type.
+     */
+    usize alignment;
+
+    /**
+     * @brief The lifecycle operations of the component type.
+     */
+    const CompTypeOps* ops;
+
     [[nodiscard]] auto operator==(const CompTypeInfo& rhs) const noexcept -> bool {
-        return id == rhs.id and move_assign == rhs.move_assign;
+        return id == rhs.id and ops == rhs.ops;
     }
 };
 
@@ -135,33 +260,6 @@ struct CompTypeInfo {
  */
 using CompTypeList = std::vector<CompTypeInfo>;
 
-/**
- * @brief A hash function object for `TypeList`.
- *
- * This structure defines a hash function for `TypeList` objects. It computes
- * a hash value by iterating over the elements of the list and combining their
- * individual hash values.
- */
-struct TypeHash {
-    /**
-     * @brief Computes the hash value for a given `TypeList`.
-     *
-     * This operator computes a hash value for a `TypeList` by iterating through its elements
-     * and accumulating their individual hash values using `wyhash`.
-     *
-     * @param x The `TypeList` to hash.
-     * @return The computed hash value of type `u64`.
-     */
-    auto operator()(const CompTypeList& x) const noexcept -> u64 {
-        u64 h{0};
-        for (usize i{0}; i < x.size(); ++i) {
-            // TODO: Implement hash function instead of depending on library detail
-            h += ankerl::unordered_dense::detail::wyhash::hash(x[i].id);
-        }
-        return h;
-    }
-};
-
 /**
  * @brief Default constructor implementation for type `T`.
  *
@@ -221,7 +319,7 @@ auto copy_ctor_impl(void* dst, void* src, const usize count) -> void {
 
     if constexpr (std::is_trivially_copyable_v<T>) {
         std::memcpy(dst, src, sizeof(T) * count);
-    } else {
+    } else if constexpr (std::is_copy_constructible_v<T>) {
         for (usize i{0}; i < count; ++i) {
             new (std::addressof(dst_arr[i])) T(src_arr[i]);
         }
@@ -247,7 +345,7 @@ auto copy_assgin_impl(void* dst, void* src, const usize count) -> void {
 
     if constexpr (std::is_trivially_copyable_v<T>) {
         std::memcpy(dst, src, sizeof(T) * count);
-    } else {
+    } else if constexpr (std::is_copy_assignable_v<T>) {
         for (usize i{0}; i < count; ++i) {
             dst_arr[i] = src_arr[i];
         }
@@ -372,6 +470,89 @@ auto move_assign_dtor_impl(void* dst, void* src, const usize count) -> void {
     }
 }
 
+/**
+ * @brief Swap implementation for type `T`.
+ *
+ * Trivially copyable and relocatable types exchange their bytes, other types are swapped with `swap`, which is found
+ * by argument dependent lookup. No temporary storage is needed besides the stack.
+ *
+ * @tparam T The type to be swapped.
+ * @param lhs Pointer to the first instances.
+ * @param rhs Pointer to the instances they are swapped with.
+ * @param count The number of instances to swap.
+ */
+template<typename T>
+auto swap_impl(void* lhs, void* rhs, const usize count) -> void {
+    NIDAVELLIR_ASSERT(lhs && rhs, "The pointers should always be valid");
+
+    if constexpr (std::is_trivially_copyable_v<T> or requires(T) { typename T::is_relocatable; }) {
+        auto* lhs_bytes = static_cast<std::byte*>(lhs);
+        std::swap_ranges(lhs_bytes, lhs_bytes + sizeof(T) * count, static_cast<std::byte*>(rhs));
+    } else {
+        using std::swap;
+        T* lhs_arr = static_cast<T*>(lhs);
+        T* rhs_arr = static_cast<T*>(rhs);
+        for (usize i{0}; i < count; ++i) {
+            swap(lhs_arr[i], rhs_arr[i]);
+        }
+    }
+}
+
+/**
+ * @brief Snapshot save implementation for type `T`.
+ *
+ * Writes `count` instances of type `T` with their `save` member, or as raw bytes if `T` has none.
+ *
+ * @tparam T The type to be saved.
+ * @param src Pointer to the source memory location.
+ * @param count The number of instances to save.
+ * @param out The writer of the snapshot.
+ */
+template<typename T>
+auto save_impl(const void* src, const usize count, SnapshotWriter& out) -> void {
+    NIDAVELLIR_ASSERT(src, "The pointer should always be valid");
+
+    if constexpr (SerializableComponent<T>) {
+        const T* arr = static_cast<const T*>(src);
+        for (usize i{0}; i < count; ++i) {
+            arr[i].save(out);
+        }
+    } else {
+        out.write_bytes(src, sizeof(T) * count);
+    }
+}
+
+/**
+ * @brief Snapshot load implementation for type `T`.
+ *
+ * Constructs `count` instances of type `T` with its static `load` member, or copies their raw bytes if `T` has none.
+ * If a load throws, the instances constructed before are destroyed.
+ *
+ * @tparam T The type to be loaded.
+ * @param dst Pointer to the destination memory location.
+ * @param count The number of instances to load.
+ * @param in The reader of the snapshot.
+ */
+template<typename T>
+auto load_impl(void* dst, const usize count, SnapshotReader& in) -> void {
+    NIDAVELLIR_ASSERT(dst, "The pointer should always be valid");
+
+    if constexpr (SerializableComponent<T>) {
+        T* arr = static_cast<T*>(dst);
+        usize i{0};
+        try {
+            for (; i < count; ++i) {
+                new (std::addressof(arr[i])) T(T::load(in));
+            }
+        } catch (...) {
+            dtor_impl<T>(dst, i);
+            throw;
+        }
+    } else {
+        std::memcpy(dst, in.read_bytes(sizeof(T) * count).data(), sizeof(T) * count);
+    }
+}
+
 /**
  * @brief Computes the FNV-1a hash for a given string at compile time.
  *
@@ -428,11 +609,124 @@ constexpr auto type_id() -> usize {
     return type_id_impl<std::decay_t<T>>();
 }
 
+/**
+ * @brief Gets the next free type sequence number.
+ * @return A number that was never returned before.
+ */
+inline auto next_type_sequence() -> usize {
+    static std::atomic<usize> next{0};
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Gets the sequence number of a type, which is assigned on first use.
+ *
+ * Sequence numbers are small and dense within a process, so they can index arrays, but unlike `type_id`
+ * they depend on the order in which types are first used and are not stable between runs.
+ *
+ * @tparam T The type to get the sequence number of.
+ * @return The sequence number of the decayed type.
+ */
+template<Component T>
+auto type_sequence() -> usize {
+    if constexpr (std::is_same_v<T, std::decay_t<T>>) {
+        static const usize sequence{next_type_sequence()};
+        return sequence;
+    } else {
+        return type_sequence<std::decay_t<T>>();
+    }
+}
+
+/**
+ * @brief Gets the next free pack sequence number.
+ * @return A number that was never returned before.
+ */
+inline auto next_pack_sequence() -> usize {
+    static std::atomic<usize> next{0};
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Gets the sequence number of a pack of types, which is assigned on first use.
+ *
+ * Like `type_sequence`, but for a whole pack. Packs with the same types in a different order get different numbers.
+ *
+ * @tparam Ts The types of the pack.
+ * @return The sequence number of the decayed pack.
+ */
+template<Component... Ts>
+auto pack_sequence() -> usize {
+    if constexpr ((std::is_same_v<Ts, std::decay_t<Ts>> and ...)) {
+        static const usize sequence{next_pack_sequence()};
+        return sequence;
+    } else {
+        return pack_sequence<std::decay_t<Ts>...>();
+    }
+}
+
+/**
+ * @brief Generates a unique ID for a pack of types at compile time.
+ *
+ * Works like `type_id_impl` but hashes the signature of the whole pack, which identifies
+ * the pack as a unit. Packs with the same types in a different order get different IDs.
+ *
+ * @tparam Ts The types for which to generate a unique ID.
+ * @return The computed unique ID as a `usize`.
+ */
+template<Component... Ts>
+constexpr auto pack_id_impl() -> usize {
+#if defined(_MSC_VER)
+    return fnv1a_hash(__FUNCSIG__);
+#elif defined(__GNUC__) || defined(__clang__)
+    return fnv1a_hash(__PRETTY_FUNCTION__);
+#else
+    // Runtime fallback
+    usize hash{0xcbf29ce484222325};
+    ((hash = (hash ^ type_id_impl<Ts>()) * 0x100000001b3), ...);
+    return hash;
+#endif
+}
+
+/**
+ * @brief Wrapper function to generate a unique ID for a pack of types.
+ *
+ * @tparam Ts The types for which to generate a unique ID.
+ * @return The computed unique ID as a `usize`.
+ */
+template<Component... Ts>
+constexpr auto pack_id() -> usize {
+    return pack_id_impl<std::decay_t<Ts>...>();
+}
+
+/**
+ * @brief The lifecycle operations of type `T`.
+ *
+ * The copy operations are `nullptr` if `T` is not copyable, the snapshot operations if `T` is neither trivially copyable
+ * nor a `SerializableComponent`.
+ *
+ * @tparam T The decayed component type.
+ */
+template<Component T>
+inline constexpr CompTypeOps comp_type_ops{
+    .ctor = &ctor_impl<T>,
+    .dtor = &dtor_impl<T>,
+    .copy_ctor = std::is_copy_constructible_v<T> ? &copy_ctor_impl<T> : nullptr,
+    .copy_assign = std::is_copy_assignable_v<T> ? &copy_assgin_impl<T> : nullptr,
+    .move_ctor = &move_ctor_impl<T>,
+    .move_assign = &move_assign_impl<T>,
+    .move_ctor_dtor = &move_ctor_dtor_impl<T>,
+    .move_assign_dtor = &move_assign_dtor_impl<T>,
+    .swap = &swap_impl<T>,
+    .enableable = EnableableComponent<T>,
+    .save = SerializableComponent<T> or std::is_trivially_copyable_v<T> ? &save_impl<T> : nullptr,
+    .load = SerializableComponent<T> or std::is_trivially_copyable_v<T> ? &load_impl<T> : nullptr,
+    .raw_snapshot = !SerializableComponent<T> and std::is_trivially_copyable_v<T>};
+
 /**
  * @brief Retrieves the component type information for type `T`.
  *
- * Constructs a `CompTypeInfo` object that contains type information and function pointers
- * for managing the lifecycle of the component type `T`.
+ * Constructs a `CompTypeInfo` object that contains the layout of the component type `T` and a pointer to its
+ * lifecycle operations.
  *
  * @tparam T The component type to get the type information for.
  * @return A `CompTypeInfo` object containing the type information and lifecycle functions for type `T`.
@@ -441,28 +735,12 @@ template<Component T>
 [[nodiscard]] constexpr auto get_component_info() -> CompTypeInfo {
     using Ty = std::decay_t<T>;
 
-    auto info = CompTypeInfo{
+    return CompTypeInfo{
         .id = type_id<Ty>(),
+        .index = no_component_index,
+        .size = TagComponent<Ty> ? 0 : sizeof(Ty),
         .alignment = alignof(Ty),
-        .ctor = &ctor_impl<Ty>,
-        .dtor = &dtor_impl<Ty>,
-        .copy_ctor = nullptr,
-        .copy_assign = nullptr,
-        .move_ctor = &move_ctor_impl<Ty>,
-        .move_assign = &move_assign_impl<Ty>,
-        .move_ctor_dtor = &move_ctor_dtor_impl<Ty>,
-        .move_assign_dtor = &move_assign_dtor_impl<Ty>,
-        .size = sizeof(Ty)};
-
-    if constexpr (std::is_copy_constructible_v<Ty>) {
-        info.copy_ctor = &copy_ctor_impl<Ty>;
-    }
-
-    if constexpr (std::is_copy_assignable_v<Ty>) {
-        info.copy_assign = &copy_assgin_impl<Ty>;
-    }
-
-    return info;
+        .ops = &comp_type_ops<Ty>};
 }
 
 /**
@@ -0,0 +1,171 @@
+#pragma once
+#include "core.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace nid {
+/**
+ * @class ComponentMask
+ * @brief A bitset over the dense component indices of a world.
+ *
+ * Every archetype carries the mask of its components, which turns matching a set of components into a
+ * few word-wide AND and compare operations instead of comparing component lists.
+ */
+class ComponentMask {
+    static constexpr usize word_bits{64};
+    std::vector<u64> words;
+
+  public:
+    /**
+     * @brief Sets the bit of a component.
+     * @param index The dense index of the component.
+     */
+    auto set(const usize index) -> void {
+        const usize word{index / word_bits};
+        if (word >= words.size()) {
+            words.resize(word + 1, 0);
+        }
+        words[word] |= u64{1} << (index % word_bits);
+    }
+
+    /**
+     * @brief Checks if the bit of a component is set.
+     * @param index The dense index of the component.
+     * @return true if the component is part of the mask, false otherwise.
+     */
+    [[nodiscard]] auto test(const usize index) const noexcept -> bool {
+        const usize word{index / word_bits};
+        return word < words.size() and (words[word] >> (index % word_bits) & 1) != 0;
+    }
+
+    /**
+     * @brief Checks if every component of another mask is part of this mask.
+     * @param other The mask to check.
+     * @return true if `other` is a subset of this mask, false otherwise.
+     */
+    [[nodiscard]] auto contains(const ComponentMask& other) const noexcept -> bool {
+        const usize common{std::min(words.size(), other.words.size())};
+        u64 missing{0};
+        for (usize i{0}; i < common; ++i) {
+            missing |= other.words[i] & ~words[i];
+        }
+        for (usize i{common}; i < other.words.size(); ++i) {
+            missing |= other.words[i];
+        }
+        return missing == 0;
+    }
+
+    /**
+     * @brief Gets the words of the mask.
+     * @return The words of the mask, bit `i % 64` of word `i / 64` is the component with dense index `i`.
+     */
+    [[nodiscard]] auto data() const noexcept -> std::span<const u64> { return words; }
+
+    /**
+     * @brief Gets the number of components in the mask.
+     * @return The number of set bits.
+     */
+    [[nodiscard]] auto count() const noexcept -> usize {
+        usize total{0};
+        for (const auto word : words) {
+            total += static_cast<usize>(std::popcount(word));
+        }
+        return total;
+    }
+
+    /**
+     * @brief Compares two masks, ignoring trailing zero words.
+     * @param lhs The first mask.
+     * @param rhs The second mask.
+     * @return true if both masks contain the same components, false otherwise.
+     */
+    friend auto operator==(const ComponentMask& lhs, const ComponentMask& rhs) noexcept -> bool {
+        return lhs.contains(rhs) and rhs.contains(lhs);
+    }
+};
+
+/**
+ * @class ComponentMaskTable
+ * @brief The masks of many archetypes stored back to back with a fixed number of words each.
+ *
+ * Matching a mask against every archetype is a linear scan over a flat array, which the compiler can vectorize
+ * and which touches a few bytes per archetype instead of a whole archetype record.
+ */
+class ComponentMaskTable {
+    std::vector<u64> words;
+    usize stride{1}; ///< The number of words per mask.
+    usize count{0};  ///< The number of masks.
+
+  public:
+    /**
+     * @brief Gets the number of masks in the table.
+     * @return The number of masks.
+     */
+    [[nodiscard]] auto len() const noexcept -> usize { return count; }
+
+    /**
+     * @brief Appends a mask to the table.
+     *
+     * Widens every mask in the table if the new mask has more words than the current stride.
+     *
+     * @param mask The mask to append.
+     */
+    auto push_back(const ComponentMask& mask) -> void {
+        const auto mask_words = mask.data();
+        if (mask_words.size() > stride) {
+            std::vector<u64> widened(count * mask_words.size(), 0);
+            for (usize i{0}; i < count; ++i) {
+                std::copy_n(words.begin() + static_cast<std::ptrdiff_t>(i * stride), stride, widened.begin() + static_cast<std::ptrdiff_t>(i * mask_words.size()));
+            }
+            words = std::move(widened);
+            stride = mask_words.size();
+        }
+
+        words.resize(words.size() + stride, 0);
+        std::ranges::copy(mask_words, words.end() - static_cast<std::ptrdiff_t>(stride));
+        ++count;
+    }
+
+    /**
+     * @brief Calls `func` with the index of every mask that contains `required`.
+     * @param required The components a mask has to contain.
+     * @param func The function to call with the index of every matching mask.
+     */
+    template<typename Func>
+    auto for_each_match(const ComponentMask& required, Func&& func) const -> void {
+        const auto required_words = required.data();
+        for (usize w{stride}; w < required_words.size(); ++w) {
+            if (required_words[w] != 0) {
+                // No mask in the table has a component that was registered after the widest mask.
+                return;
+            }
+        }
+
+        if (stride == 1) {
+            const u64 req{required_words.empty() ? 0 : required_words[0]};
+            for (usize i{0}; i < count; ++i) {
+                if ((req & ~words[i]) == 0) {
+                    func(i);
+                }
+            }
+            return;
+        }
+
+        std::vector<u64> req(stride, 0);
+        std::copy_n(required_words.begin(), std::min(stride, required_words.size()), req.begin());
+        for (usize i{0}; i < count; ++i) {
+            u64 missing{0};
+            for (usize w{0}; w < stride; ++w) {
+                missing |= req[w] & ~words[i * stride + w];
+            }
+            if (missing == 0) {
+                func(i);
+            }
+        }
+    }
+};
+} // namespace nid
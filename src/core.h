@@ -28,4 +28,16 @@ auto nidavellir_assert(const char* expr_str, bool expr, const char* file, int li
 #else
 #define NIDAVELLIR_ASSERT(expr, msg) (void)0
 #endif
+
+/**
+ * @brief Asks the CPU to load the cache line of an address that is read soon.
+ * @param ptr The address, which is never dereferenced and may be invalid.
+ */
+inline auto prefetch(const void* ptr) noexcept -> void {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(ptr);
+#else
+    (void)ptr;
+#endif
+}
 } // namespace nid
\ No newline at end of file
@@ -2,7 +2,48 @@
 #include "core.h"
 
 namespace nid {
+/**
+ * @brief A handle to an entity.
+ *
+ * The lower 32 bits hold the index of the entity's slot in the world and the upper 32 bits
+ * hold the generation of the slot. Slots are recycled after a despawn with an incremented
+ * generation, so handles to despawned entities can be detected in O(1).
+ */
 using EntityId = usize;
 using ComponentId = usize;
 using ArchetypeId = usize;
+using ForkId = usize;
+
+static constexpr usize entity_index_bits{32};
+
+/**
+ * @brief Gets the slot index of an entity.
+ * @param entity The entity handle.
+ * @return The index of the entity's slot.
+ */
+constexpr auto entity_index(const EntityId entity) -> u32 {
+    return static_cast<u32>(entity);
+}
+
+/**
+ * @brief Gets the generation of an entity.
+ * @param entity The entity handle.
+ * @return The generation of the entity's slot when the handle was created.
+ */
+constexpr auto entity_generation(const EntityId entity) -> u32 {
+    return static_cast<u32>(entity >> entity_index_bits);
+}
+
+/**
+ * @brief Creates an entity handle from a slot index and a generation.
+ * @param index The index of the entity's slot.
+ * @param generation The generation of the slot.
+ * @return The entity handle.
+ */
+constexpr auto make_entity_id(const u32 index, const u32 generation) -> EntityId {
+    return static_cast<EntityId>(generation) << entity_index_bits | index;
+}
+
+static_assert(entity_index(make_entity_id(12, 34)) == 12);
+static_assert(entity_generation(make_entity_id(12, 34)) == 34);
 } // namespace nid
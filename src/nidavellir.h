@@ -2,5 +2,13 @@
 #include "core.h"
 #include "identifiers.h"
 #include "comp_type_info.h"
+#include "component_mask.h"
+#include "signature.h"
+#include "snapshot.h"
+#include "virtual_memory.h"
+#include "column_pool.h"
 #include "archetype.h"
-#include "world.h"
\ No newline at end of file
+#include "sparse_set.h"
+#include "thread_pool.h"
+#include "world.h"
+#include "command_buffer.h"
\ No newline at end of file
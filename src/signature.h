@@ -0,0 +1,141 @@
+#pragma once
+#include "core.h"
+#include "comp_type_info.h"
+#include "identifiers.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <utility>
+
+namespace nid {
+/**
+ * @brief Mixes the bits of a 64-bit value so that every input bit affects every output bit.
+ *
+ * This is the finalizer of MurmurHash3.
+ *
+ * @param x The value to mix.
+ * @return The mixed value.
+ */
+constexpr auto hash_mix(u64 x) noexcept -> u64 {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccd;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53;
+    x ^= x >> 33;
+    return x;
+}
+
+/**
+ * @brief Computes an order-sensitive hash of a list of component ids.
+ *
+ * Every id is mixed into the running hash, so lists with the same ids in a different order and lists
+ * that only differ in their length hash differently.
+ *
+ * @param ids The component ids.
+ * @return The hash of the list.
+ */
+constexpr auto signature_hash(const std::span<const ComponentId> ids) noexcept -> u64 {
+    u64 h{hash_mix(ids.size() + 0x9e3779b97f4a7c15)};
+    for (const auto id : ids) {
+        h = hash_mix(h ^ (id + 0x9e3779b97f4a7c15 + (h << 6) + (h >> 2)));
+    }
+    return h;
+}
+
+/**
+ * @brief The signature of a component pack, computed at compile time.
+ *
+ * The ids are sorted the same way `sort_component_list` sorts type lists, so they are the row order of the
+ * archetype that holds exactly the components of the pack, regardless of the order of the pack.
+ *
+ * @tparam Ts The component types of the pack.
+ */
+template<Component... Ts>
+struct PackSignature {
+    static constexpr std::array<ComponentId, sizeof...(Ts)> ids = [] {
+        // Tags sort after all other components
+        std::array<std::pair<bool, ComponentId>, sizeof...(Ts)> keys{std::pair{TagComponent<Ts>, type_id<Ts>()}...};
+        std::ranges::sort(keys, [](const auto& lhs, const auto& rhs) { return lhs.first != rhs.first ? rhs.first : lhs.second > rhs.second; });
+        std::array<ComponentId, sizeof...(Ts)> sorted{};
+        std::ranges::transform(keys, sorted.begin(), [](const auto& key) { return key.second; });
+        return sorted;
+    }();
+    static constexpr u64 hash{signature_hash(ids)};
+};
+
+/**
+ * @class Signature
+ * @brief The interned identity of an archetype: its component ids in row order and their hash.
+ *
+ * The hash is computed once when the signature is created. Short id lists are stored inline, so comparing a
+ * probe against a signature is a hash compare followed by a `memcmp` without touching any other memory.
+ */
+class Signature {
+    static constexpr usize inline_capacity{6};
+
+    u64 hash_value{0};
+    usize length{0};
+    std::array<ComponentId, inline_capacity> inline_ids{};
+    std::unique_ptr<ComponentId[]> heap_ids;
+
+  public:
+    Signature() = default;
+
+    /**
+     * @brief Constructs a signature from a list of component ids.
+     * @param ids The component ids in row order.
+     * @param hash The `signature_hash` of the ids.
+     */
+    Signature(const std::span<const ComponentId> ids, const u64 hash) : hash_value(hash), length(ids.size()) {
+        NIDAVELLIR_ASSERT(hash == signature_hash(ids), "The hash does not belong to the ids");
+        if (length > inline_capacity) {
+            heap_ids = std::make_unique<ComponentId[]>(length);
+        }
+        std::ranges::copy(ids, data());
+    }
+
+    /**
+     * @brief Constructs a signature from a list of component ids and computes its hash.
+     * @param ids The component ids in row order.
+     */
+    explicit Signature(const std::span<const ComponentId> ids) : Signature(ids, signature_hash(ids)) {}
+
+    /**
+     * @brief Gets the cached hash of the signature.
+     * @return The `signature_hash` of the ids.
+     */
+    [[nodiscard]] auto hash() const noexcept -> u64 { return hash_value; }
+
+    /**
+     * @brief Gets the component ids of the signature.
+     * @return The ids in row order.
+     */
+    [[nodiscard]] auto ids() const noexcept -> std::span<const ComponentId> { return {data(), length}; }
+
+    /**
+     * @brief Checks if the signature has the given ids.
+     * @param hash The `signature_hash` of the ids.
+     * @param ids The component ids in row order.
+     * @return true if the signature consists of exactly these ids, false otherwise.
+     */
+    [[nodiscard]] auto matches(const u64 hash, const std::span<const ComponentId> ids) const noexcept -> bool {
+        return hash == hash_value and ids.size() == length and (length == 0 or std::memcmp(ids.data(), data(), length * sizeof(ComponentId)) == 0);
+    }
+
+  private:
+    [[nodiscard]] auto data() noexcept -> ComponentId* { return length > inline_capacity ? heap_ids.get() : inline_ids.data(); }
+    [[nodiscard]] auto data() const noexcept -> const ComponentId* { return length > inline_capacity ? heap_ids.get() : inline_ids.data(); }
+};
+
+/**
+ * @brief A hash function object for maps that are keyed by an already mixed hash.
+ */
+struct PrehashedHash {
+    using is_avalanching = void; ///< Tells `ankerl::unordered_dense` that the key needs no further mixing.
+
+    auto operator()(const u64 x) const noexcept -> u64 { return x; }
+};
+} // namespace nid
@@ -0,0 +1,300 @@
+#include "world.h"
+#include "snapshot.h"
+#include "virtual_memory.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace nid {
+namespace {
+constexpr u64 sparse_flag{1}; ///< The component is stored in a sparse set.
+constexpr u64 raw_flag{2};    ///< The component is saved as raw bytes.
+
+/**
+ * @brief The layout of a component as it was saved, resolved to a component of the loading world.
+ */
+struct SavedComponent {
+    ComponentId id;
+    u64 flags;
+    usize index; ///< The dense index in the loading world, `no_component_index` if the component is not registered.
+};
+
+/**
+ * @brief Checks if a row is saved as raw bytes that start at a page boundary.
+ * @param info The type info of the row.
+ * @param count The number of components in the row.
+ * @return true if the row is large enough to be mapped from the file.
+ */
+auto page_aligned(const CompTypeInfo& info, const usize count) -> bool {
+    return info.ops->raw_snapshot and info.size * count >= snapshot_page_bytes;
+}
+
+/**
+ * @brief Writes the components of every data row of an archetype, followed by the enabled bits of its enableable rows.
+ * @param out The writer of the snapshot.
+ * @param arch The archetype.
+ */
+auto save_table(SnapshotWriter& out, const Archetype& arch) -> void {
+    const auto infos = arch.type();
+    for (usize row{0}; row < arch.data_row_count(); ++row) {
+        if (infos[row].ops->save == nullptr) {
+            throw std::runtime_error("A component is neither trivially copyable nor serializable");
+        }
+        if (page_aligned(infos[row], arch.len())) {
+            out.align(snapshot_page_bytes);
+        }
+        arch.for_each_run(0, arch.len(), [&](const usize col, const usize len) { infos[row].ops->save(arch.get_raw(col, row), len, out); });
+    }
+
+    for (usize row{0}; row < arch.data_row_count(); ++row) {
+        if (arch.is_enableable(row)) {
+            const auto words = arch.enabled_words(row);
+            out.write_bytes(words.data(), words.size_bytes());
+        }
+    }
+}
+
+/**
+ * @brief Constructs the components of every data row of an empty archetype and grows it to hold them.
+ *
+ * Large raw rows are mapped from the file if the archetype supports it, all other rows are loaded one run at a time.
+ * If a row fails to load, the rows loaded before are destroyed and the archetype stays empty.
+ *
+ * @param in The reader of the snapshot.
+ * @param file The file of the snapshot.
+ * @param arch The archetype.
+ * @param count The number of components in every row.
+ */
+auto load_table(SnapshotReader& in, const MappedFile& file, Archetype& arch, const usize count) -> void {
+    NIDAVELLIR_ASSERT(arch.len() == 0, "A snapshot is only loaded into empty archetypes");
+    if (count > arch.cap()) {
+        arch.prepare_push(count);
+    }
+
+    const auto infos = arch.type();
+    usize loaded{0};
+    try {
+        for (; loaded < arch.data_row_count(); ++loaded) {
+            const auto& info = infos[loaded];
+            if (info.ops->load == nullptr) {
+                throw std::runtime_error("A component is neither trivially copyable nor serializable");
+            }
+            if (page_aligned(info, count)) {
+                // The row is read before it is mapped, so a truncated file is never mapped past its end
+                in.align(snapshot_page_bytes);
+                const usize offset{in.position()};
+                SnapshotReader row_in(in.read_bytes(info.size * count));
+                if (!arch.map_file_row(loaded, file, offset, count)) {
+                    arch.for_each_run(0, count, [&](const usize col, const usize len) { info.ops->load(arch.get_raw(col, loaded), len, row_in); });
+                }
+                continue;
+            }
+            arch.for_each_run(0, count, [&](const usize col, const usize len) { info.ops->load(arch.get_raw(col, loaded), len, in); });
+        }
+    } catch (...) {
+        for (usize row{0}; row < loaded; ++row) {
+            arch.for_each_run(0, count, [&](const usize col, const usize len) { infos[row].ops->dtor(arch.get_raw(col, row), len); });
+        }
+        throw;
+    }
+    arch.increase_size(count);
+
+    std::vector<u64> words;
+    for (usize row{0}; row < arch.data_row_count(); ++row) {
+        if (arch.is_enableable(row)) {
+            words.resize(arch.enabled_words(row).size());
+            const auto bytes = in.read_bytes(words.size() * sizeof(u64));
+            std::copy_n(bytes.data(), bytes.size(), reinterpret_cast<std::byte*>(words.data()));
+            arch.assign_enabled(row, words);
+        }
+    }
+}
+
+/**
+ * @brief Reads a list of entity handles.
+ * @param in The reader of the snapshot.
+ * @param entities The list, which is resized to the number of handles.
+ */
+template<typename Vector>
+auto read_entities(SnapshotReader& in, Vector& entities) -> void {
+    entities.resize(in.read<u64>());
+    const auto bytes = in.read_bytes(entities.size() * sizeof(EntityId));
+    std::copy_n(bytes.data(), bytes.size(), reinterpret_cast<std::byte*>(entities.data()));
+}
+} // namespace
+
+auto World::save(const std::filesystem::path& path) const -> void {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("The snapshot file could not be opened");
+    }
+    SnapshotWriter out(file);
+    out.write(snapshot_magic);
+    out.write(snapshot_version);
+    out.write(u32{0});
+
+    out.write(u64{components.size()});
+    for (const auto& info : components) {
+        out.write(u64{info.id});
+        out.write(u64{info.size});
+        out.write(u64{info.alignment});
+        out.write((sparse_sets[info.index] != nullptr ? sparse_flag : 0) | (info.ops->raw_snapshot ? raw_flag : 0));
+    }
+
+    out.write(u64{entity_records.size()});
+    for (const auto& record : entity_records) {
+        out.write(record.generation);
+    }
+    out.write(u64{free_entities.size()});
+    out.write_bytes(free_entities.data(), free_entities.size() * sizeof(u32));
+
+    const auto non_empty = static_cast<u64>(std::ranges::count_if(archetypes, [](const ArchetypeRecord& rec) { return !rec.entities.empty(); }));
+    out.write(non_empty);
+    for (const auto& rec : archetypes) {
+        if (rec.entities.empty()) {
+            continue;
+        }
+        const auto ids = rec.signature.ids();
+        out.write(u64{ids.size()});
+        out.write_bytes(ids.data(), ids.size_bytes());
+        out.write(u64{rec.entities.size()});
+        out.write_bytes(rec.entities.data(), rec.entities.size() * sizeof(EntityId));
+        save_table(out, rec.archetype);
+    }
+
+    const auto sparse_count = static_cast<u64>(std::ranges::count_if(sparse_indices, [&](const usize index) { return sparse_sets[index]->len() != 0; }));
+    out.write(sparse_count);
+    for (const auto index : sparse_indices) {
+        const auto& set = *sparse_sets[index];
+        if (set.len() == 0) {
+            continue;
+        }
+        out.write(u64{components[index].id});
+        const auto entities = set.entities();
+        out.write(u64{entities.size()});
+        out.write_bytes(entities.data(), entities.size_bytes());
+        save_table(out, set.table());
+    }
+
+    file.flush();
+    if (!file) {
+        throw std::runtime_error("The snapshot file could not be written");
+    }
+}
+
+auto World::load_snapshot(const std::filesystem::path& path) -> void {
+    NIDAVELLIR_ASSERT(entity_records.empty() and forks.empty(), "A snapshot can only be loaded into an empty world without forks");
+    const MappedFile file(path);
+    SnapshotReader in(file.bytes());
+    if (in.read<u64>() != snapshot_magic or in.read<u32>() != snapshot_version) {
+        throw std::runtime_error("The file is not a snapshot of this version");
+    }
+    in.read<u32>();
+
+    ankerl::unordered_dense::map<ComponentId, usize> local_indices;
+    for (const auto& info : components) {
+        local_indices.insert({info.id, info.index});
+    }
+
+    // Components that are registered have to match the saved layout, unregistered ones are only an error once they are used
+    std::vector<SavedComponent> saved(in.read<u64>());
+    ankerl::unordered_dense::map<ComponentId, usize> saved_indices;
+    for (usize i{0}; i < saved.size(); ++i) {
+        const auto id = static_cast<ComponentId>(in.read<u64>());
+        const auto size = static_cast<usize>(in.read<u64>());
+        const auto alignment = static_cast<usize>(in.read<u64>());
+        const u64 flags{in.read<u64>()};
+        saved[i] = SavedComponent{.id = id, .flags = flags, .index = no_component_index};
+        saved_indices.insert({id, i});
+
+        if (const auto local_it = local_indices.find(id); local_it != local_indices.end()) {
+            const auto& info = components[local_it->second];
+            const u64 local_flags{(sparse_sets[info.index] != nullptr ? sparse_flag : 0) | (info.ops->raw_snapshot ? raw_flag : 0)};
+            if (info.size != size or info.alignment != alignment or local_flags != flags) {
+                throw std::runtime_error("A component of the snapshot has another layout than the registered component");
+            }
+            saved[i].index = info.index;
+        }
+    }
+    auto resolve = [&](const ComponentId id) -> usize {
+        const auto saved_it = saved_indices.find(id);
+        if (saved_it == saved_indices.end() or saved[saved_it->second].index == no_component_index) {
+            throw std::runtime_error("The snapshot contains a component that is not registered");
+        }
+        return saved[saved_it->second].index;
+    };
+
+    entity_records.resize(in.read<u64>());
+    for (auto& record : entity_records) {
+        record = EntityRecord{.archetype = no_archetype, .col = 0, .generation = in.read<u32>()};
+    }
+    free_entities.resize(in.read<u64>());
+    const auto free_bytes = in.read_bytes(free_entities.size() * sizeof(u32));
+    std::copy_n(free_bytes.data(), free_bytes.size(), reinterpret_cast<std::byte*>(free_entities.data()));
+
+    const auto archetype_count = static_cast<usize>(in.read<u64>());
+    archetypes.reserve(archetypes.size() + archetype_count);
+    CompTypeList infos;
+    for (usize a{0}; a < archetype_count; ++a) {
+        infos.resize(static_cast<usize>(in.read<u64>()));
+        for (auto& info : infos) {
+            info = components[resolve(static_cast<ComponentId>(in.read<u64>()))];
+        }
+        const auto saved_order = infos;
+        sort_component_list(infos);
+        if (infos != saved_order) {
+            throw std::runtime_error("The components of a snapshot archetype are not in row order");
+        }
+
+        auto& rec = find_or_create_archetype(infos);
+        read_entities(in, rec.entities);
+        for (usize col{0}; col < rec.entities.size(); ++col) {
+            const EntityId entity{rec.entities[col]};
+            const u32 index{entity_index(entity)};
+            if (index >= entity_records.size() or entity_records[index].generation != entity_generation(entity) or entity_records[index].archetype != no_archetype) {
+                throw std::runtime_error("The snapshot contains an invalid entity");
+            }
+            entity_records[index].archetype = rec.id;
+            entity_records[index].col = col;
+        }
+
+        const usize count{rec.entities.size()};
+        try {
+            load_table(in, file, rec.archetype, count);
+        } catch (...) {
+            rec.entities.clear();
+            throw;
+        }
+    }
+
+    // Every free slot has to be listed once and be unplaced, every other slot has to be placed in a table
+    std::vector<bool> free_slots(entity_records.size(), false);
+    for (const u32 index : free_entities) {
+        if (index >= entity_records.size() or free_slots[index] or entity_records[index].archetype != no_archetype) {
+            throw std::runtime_error("The snapshot contains an invalid entity");
+        }
+        free_slots[index] = true;
+    }
+    for (usize index{0}; index < entity_records.size(); ++index) {
+        if (!free_slots[index] and entity_records[index].archetype == no_archetype) {
+            throw std::runtime_error("The snapshot contains an invalid entity");
+        }
+    }
+
+    const auto sparse_count = static_cast<usize>(in.read<u64>());
+    std::pmr::vector<EntityId> entities;
+    for (usize s{0}; s < sparse_count; ++s) {
+        const usize index{resolve(static_cast<ComponentId>(in.read<u64>()))};
+        read_entities(in, entities);
+        if (!std::ranges::all_of(entities, [&](const EntityId entity) { return is_alive(entity) and entity_records[entity_index(entity)].archetype != no_archetype; })) {
+            throw std::runtime_error("The snapshot contains an invalid entity");
+        }
+
+        auto& set = *sparse_sets[index];
+        load_table(in, file, set.table(), entities.size());
+        set.append_entities(entities);
+    }
+}
+} // namespace nid
@@ -0,0 +1,137 @@
+#pragma once
+#include "core.h"
+
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+namespace nid {
+inline constexpr u64 snapshot_magic{0x3150414e5344494e}; ///< "NIDSNAP1" in little endian, which also rejects files of the other byte order.
+inline constexpr u32 snapshot_version{1};                 ///< The version of the snapshot format.
+
+/**
+ * @brief The alignment of large raw columns in a snapshot file.
+ *
+ * Raw columns of at least this many bytes start at a multiple of it, so a loader can map them straight from the file.
+ */
+inline constexpr usize snapshot_page_bytes{4096};
+
+/**
+ * @class SnapshotWriter
+ * @brief Writes the bytes of a snapshot to a stream and keeps track of the position.
+ *
+ * Components with their own snapshot encoding receive a writer in their `save` member.
+ */
+class SnapshotWriter {
+    std::ostream& out;
+    usize offset{0};
+
+  public:
+    /**
+     * @brief Constructs a writer at the current position of a stream.
+     * @param stream The stream to write to, which has to be opened in binary mode.
+     */
+    explicit SnapshotWriter(std::ostream& stream) : out(stream) {}
+
+    /**
+     * @brief Gets the number of bytes written so far.
+     * @return The position of the next byte relative to the start of the snapshot.
+     */
+    [[nodiscard]] auto position() const noexcept -> usize { return offset; }
+
+    /**
+     * @brief Writes raw bytes.
+     * @param data The bytes to write.
+     * @param count The number of bytes.
+     */
+    auto write_bytes(const void* data, const usize count) -> void {
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(count));
+        offset += count;
+    }
+
+    /**
+     * @brief Writes the bytes of a trivially copyable value.
+     * @tparam T The type of the value.
+     * @param value The value to write.
+     */
+    template<typename T>
+        requires std::is_trivially_copyable_v<T>
+    auto write(const T& value) -> void {
+        write_bytes(&value, sizeof(T));
+    }
+
+    /**
+     * @brief Writes zero bytes up to the next multiple of an alignment.
+     * @param alignment The alignment, a power of two.
+     */
+    auto align(const usize alignment) -> void {
+        static constexpr char zeros[snapshot_page_bytes]{};
+        NIDAVELLIR_ASSERT(alignment <= snapshot_page_bytes, "The padding has to fit in a page");
+        write_bytes(zeros, (alignment - offset % alignment) % alignment);
+    }
+};
+
+/**
+ * @class SnapshotReader
+ * @brief Reads the bytes of a snapshot from memory.
+ *
+ * Every read checks the remaining size and throws `std::runtime_error` if the snapshot is truncated.
+ * Components with their own snapshot encoding receive a reader in their static `load` member.
+ */
+class SnapshotReader {
+    std::span<const std::byte> bytes;
+    usize offset{0};
+
+  public:
+    /**
+     * @brief Constructs a reader at the start of a snapshot.
+     * @param data The bytes of the snapshot.
+     */
+    explicit SnapshotReader(const std::span<const std::byte> data) : bytes(data) {}
+
+    /**
+     * @brief Gets the number of bytes read so far.
+     * @return The position of the next byte relative to the start of the snapshot.
+     */
+    [[nodiscard]] auto position() const noexcept -> usize { return offset; }
+
+    /**
+     * @brief Reads raw bytes.
+     * @param count The number of bytes.
+     * @return The bytes, which point into the snapshot.
+     * @throws std::runtime_error If fewer than `count` bytes are left.
+     */
+    auto read_bytes(const usize count) -> std::span<const std::byte> {
+        if (count > bytes.size() - offset) {
+            throw std::runtime_error("The snapshot is truncated");
+        }
+        const auto data = bytes.subspan(offset, count);
+        offset += count;
+        return data;
+    }
+
+    /**
+     * @brief Reads the bytes of a trivially copyable value.
+     * @tparam T The type of the value.
+     * @return The value.
+     * @throws std::runtime_error If the snapshot is truncated.
+     */
+    template<typename T>
+        requires std::is_trivially_copyable_v<T> and std::is_default_constructible_v<T>
+    auto read() -> T {
+        T value;
+        std::memcpy(&value, read_bytes(sizeof(T)).data(), sizeof(T));
+        return value;
+    }
+
+    /**
+     * @brief Skips the padding up to the next multiple of an alignment.
+     * @param alignment The alignment, a power of two.
+     * @throws std::runtime_error If the snapshot is truncated.
+     */
+    auto align(const usize alignment) -> void { read_bytes((alignment - offset % alignment) % alignment); }
+};
+} // namespace nid
@@ -0,0 +1,39 @@
+#include "sparse_set.h"
+
+namespace nid {
+auto SparseSet::erase(const EntityId entity) -> bool {
+    const usize col{find(entity)};
+    if (col == Archetype::no_row) {
+        return false;
+    }
+
+    if (const usize moved_col{storage.remove(col)}; moved_col != col) {
+        dense[col] = dense[moved_col];
+        sparse[entity_index(dense[col])] = static_cast<u32>(col);
+    }
+    dense.pop_back();
+    sparse[entity_index(entity)] = absent;
+    return true;
+}
+
+auto SparseSet::clear() -> void {
+    for (const auto entity : dense) {
+        sparse[entity_index(entity)] = absent;
+    }
+    dense.clear();
+    storage.clear();
+}
+
+auto SparseSet::append_entities(const std::span<const EntityId> new_entities) -> void {
+    NIDAVELLIR_ASSERT(dense.size() + new_entities.size() == storage.len(), "Every new column needs an entity");
+    for (const auto entity : new_entities) {
+        const u32 index{entity_index(entity)};
+        if (index >= sparse.size()) {
+            sparse.resize(index + 1, absent);
+        }
+        NIDAVELLIR_ASSERT(sparse[index] == absent, "An entity can only have one component in the set");
+        sparse[index] = static_cast<u32>(dense.size());
+        dense.push_back(entity);
+    }
+}
+} // namespace nid
@@ -0,0 +1,139 @@
+#pragma once
+#include "core.h"
+#include "archetype.h"
+#include "comp_type_info.h"
+#include "identifiers.h"
+
+#include <array>
+#include <limits>
+#include <memory_resource>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace nid {
+/**
+ * @class SparseSet
+ * @brief Stores the components of a single sparse component type, keyed by entity.
+ *
+ * The components are packed in a single-component archetype, whose column `i` belongs to the entity `dense[i]`.
+ * The sparse array maps the slot index of an entity to its column, so inserting, erasing and looking up a component
+ * are O(1) and never touch the archetype tables of the world.
+ */
+class SparseSet {
+    static constexpr u32 absent{std::numeric_limits<u32>::max()};
+
+    Archetype storage;
+    std::pmr::vector<u32> sparse;     ///< The column of every entity slot, `absent` if the entity has no component.
+    std::pmr::vector<EntityId> dense; ///< The entity of every column.
+
+  public:
+    /**
+     * @brief Constructs an empty sparse set.
+     * @param info The type info of the stored component.
+     * @param tick_source The change tick of the world.
+     * @param resource The resource of the components and the entity arrays.
+     */
+    SparseSet(const CompTypeInfo& info, const u32* tick_source, std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : storage(CompTypeList{info}, StorageConfig{.resource = resource}, tick_source), sparse(resource), dense(resource) {}
+
+    /**
+     * @brief Gets the number of stored components.
+     * @return The number of entities in the set.
+     */
+    [[nodiscard]] auto len() const noexcept -> usize { return dense.size(); }
+
+    /**
+     * @brief Gets the entities in the set.
+     * @return The entity of every column.
+     */
+    [[nodiscard]] auto entities() const noexcept -> std::span<const EntityId> { return dense; }
+
+    /**
+     * @brief Gets the single-component archetype that holds the components.
+     * @return The archetype, whose column `i` belongs to the entity `entities()[i]`.
+     */
+    [[nodiscard]] auto table() noexcept -> Archetype& { return storage; }
+
+    /**
+     * @brief Gets the single-component archetype that holds the components.
+     * @return The archetype, whose column `i` belongs to the entity `entities()[i]`.
+     */
+    [[nodiscard]] auto table() const noexcept -> const Archetype& { return storage; }
+
+    /**
+     * @brief Appends the entities of components that were added to the end of the table directly.
+     * @param new_entities The entity of every new column, none of which is in the set yet.
+     */
+    auto append_entities(std::span<const EntityId> new_entities) -> void;
+
+    /**
+     * @brief Gets the column of an entity.
+     * @param entity The ID of the entity.
+     * @return The column of the entity, `Archetype::no_row` if the entity has no component in the set.
+     */
+    [[nodiscard]] auto find(const EntityId entity) const noexcept -> usize {
+        const u32 index{entity_index(entity)};
+        if (index >= sparse.size() or sparse[index] == absent or dense[sparse[index]] != entity) {
+            return Archetype::no_row;
+        }
+        return sparse[index];
+    }
+
+    /**
+     * @brief Checks if an entity has a component in the set.
+     * @param entity The ID of the entity.
+     * @return true if the entity has a component in the set, false otherwise.
+     */
+    [[nodiscard]] auto contains(const EntityId entity) const noexcept -> bool { return find(entity) != Archetype::no_row; }
+
+    /**
+     * @brief Gets a pointer to the component in a column.
+     * @param col The column.
+     * @return A pointer to the component.
+     */
+    [[nodiscard]] auto get_raw(const usize col) const noexcept -> void* { return storage.get_raw(col, 0); }
+
+    /**
+     * @brief Marks the component in a column as changed.
+     * @param col The column.
+     */
+    auto mark_changed(const usize col) -> void { storage.mark_changed(col, 0); }
+
+    /**
+     * @brief Inserts the component of an entity, overwriting it if the entity already has one.
+     * @tparam T The type of the component.
+     * @param entity The ID of the entity.
+     * @param value The component.
+     */
+    template<Component T>
+    auto insert(const EntityId entity, T&& value) -> void {
+        if (const usize col{find(entity)}; col != Archetype::no_row) {
+            storage.update_rows(col, std::array<usize, 1>{0}, std::forward<T>(value));
+            return;
+        }
+
+        const u32 index{entity_index(entity)};
+        if (index >= sparse.size()) {
+            sparse.resize(index + 1, absent);
+        }
+        sparse[index] = static_cast<u32>(storage.emplace_back_rows(std::array<usize, 1>{0}, std::forward<T>(value)));
+        dense.push_back(entity);
+    }
+
+    /**
+     * @brief Erases the component of an entity.
+     *
+     * The last component is moved into the erased column.
+     *
+     * @param entity The ID of the entity.
+     * @return true if the entity had a component in the set, false otherwise.
+     */
+    auto erase(EntityId entity) -> bool;
+
+    /**
+     * @brief Erases all components.
+     */
+    auto clear() -> void;
+};
+} // namespace nid
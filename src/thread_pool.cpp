@@ -0,0 +1,136 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace nid {
+namespace {
+constexpr auto pack_range(const u64 begin, const u64 end) -> u64 {
+    return end << 32 | begin;
+}
+
+constexpr auto range_begin(const u64 range) -> u64 {
+    return range & 0xffff'ffff;
+}
+
+constexpr auto range_end(const u64 range) -> u64 {
+    return range >> 32;
+}
+} // namespace
+
+ThreadPool::ThreadPool(const usize thread_count) : ranges(std::make_unique<WorkRange[]>(std::max(thread_count, usize{1}))) {
+    const usize worker_count{std::max(thread_count, usize{1}) - 1};
+    workers.reserve(worker_count);
+    for (usize i{0}; i < worker_count; ++i) {
+        workers.emplace_back([this, i] { worker_loop(i + 1); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::scoped_lock lock(mutex);
+        stopping = true;
+    }
+    start_condition.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+auto ThreadPool::run(const usize count, void (*func)(void* context, usize item), void* context) -> void {
+    NIDAVELLIR_ASSERT(count < (u64{1} << 32), "A parallel loop supports at most 2^32 - 1 items");
+    if (count == 0) {
+        return;
+    }
+
+    if (workers.empty() or count == 1) {
+        for (usize i{0}; i < count; ++i) {
+            func(context, i);
+        }
+        return;
+    }
+
+    const usize threads{thread_count()};
+    for (usize i{0}; i < threads; ++i) {
+        ranges[i].range.store(pack_range(count * i / threads, count * (i + 1) / threads), std::memory_order_relaxed);
+    }
+
+    {
+        std::scoped_lock lock(mutex);
+        task = func;
+        task_context = context;
+        pending_workers.store(workers.size(), std::memory_order_relaxed);
+        ++generation;
+    }
+    start_condition.notify_all();
+
+    work(0);
+
+    // Every worker has to check in before the ranges can be reused by the next loop
+    for (auto pending = pending_workers.load(std::memory_order_acquire); pending != 0; pending = pending_workers.load(std::memory_order_acquire)) {
+        pending_workers.wait(pending, std::memory_order_acquire);
+    }
+}
+
+auto ThreadPool::work(const usize self) -> void {
+    usize item{0};
+    while (true) {
+        if (pop(self, item)) {
+            task(task_context, item);
+        } else if (!steal(self)) {
+            return;
+        }
+    }
+}
+
+auto ThreadPool::pop(const usize self, usize& item) -> bool {
+    auto& range = ranges[self].range;
+    auto current = range.load(std::memory_order_acquire);
+    while (range_begin(current) < range_end(current)) {
+        if (range.compare_exchange_weak(current, pack_range(range_begin(current) + 1, range_end(current)), std::memory_order_acq_rel)) {
+            item = range_begin(current);
+            return true;
+        }
+    }
+    return false;
+}
+
+auto ThreadPool::steal(const usize self) -> bool {
+    const usize threads{thread_count()};
+    for (usize offset{1}; offset < threads; ++offset) {
+        auto& range = ranges[(self + offset) % threads].range;
+        auto current = range.load(std::memory_order_acquire);
+        while (range_begin(current) < range_end(current)) {
+            const auto begin = range_begin(current);
+            const auto end = range_end(current);
+            const auto split = end - (end - begin + 1) / 2;
+            if (range.compare_exchange_weak(current, pack_range(begin, split), std::memory_order_acq_rel)) {
+                // The own range is empty, so no other thread modifies it until the stolen items are published
+                ranges[self].range.store(pack_range(split, end), std::memory_order_release);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+auto ThreadPool::worker_loop(const usize self) -> void {
+    u64 seen_generation{0};
+    while (true) {
+        {
+            std::unique_lock lock(mutex);
+            start_condition.wait(lock, [&] { return stopping or generation != seen_generation; });
+            if (stopping) {
+                return;
+            }
+            seen_generation = generation;
+        }
+
+        work(self);
+
+        if (pending_workers.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            pending_workers.notify_all();
+        }
+    }
+}
+} // namespace nid
@@ -0,0 +1,117 @@
+#pragma once
+#include "core.h"
+
+#include <atomic>
+#include <concepts>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace nid {
+/**
+ * @class ThreadPool
+ * @brief A work-stealing thread pool for data parallel loops.
+ *
+ * `parallel_for` splits the items of a loop evenly between all threads of the pool, including the calling thread.
+ * Every thread takes items from the front of its own range, and a thread that runs out of items steals the back half
+ * of the range of another thread. The ranges are single atomic words, so taking and stealing items is lock-free.
+ *
+ * \code{.cpp}
+ * ThreadPool pool(8);
+ * std::vector<float> values(1'000'000);
+ * pool.parallel_for(values.size(), [&](usize i) { values[i] *= 2.0f; });
+ * \endcode
+ */
+class ThreadPool {
+    struct alignas(64) WorkRange {
+        std::atomic<u64> range{0}; ///< The next item in the lower 32 bits, the end of the range in the upper 32 bits.
+    };
+
+    std::vector<std::thread> workers;
+    std::unique_ptr<WorkRange[]> ranges;
+
+    std::mutex mutex;
+    std::condition_variable start_condition;
+    u64 generation{0};
+    bool stopping{false};
+
+    void (*task)(void* context, usize item){nullptr};
+    void* task_context{nullptr};
+    std::atomic<usize> pending_workers{0};
+
+  public:
+    /**
+     * @brief Constructs a thread pool.
+     * @param thread_count The number of threads working on a loop, including the calling thread.
+     */
+    explicit ThreadPool(usize thread_count = std::thread::hardware_concurrency());
+
+    /**
+     * @brief Destructor, which joins all worker threads.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    auto operator=(const ThreadPool&) -> ThreadPool& = delete;
+    ThreadPool(ThreadPool&&) = delete;
+    auto operator=(ThreadPool&&) -> ThreadPool& = delete;
+
+    /**
+     * @brief Gets the number of threads working on a loop.
+     * @return The number of worker threads plus the calling thread.
+     */
+    [[nodiscard]] auto thread_count() const noexcept -> usize { return workers.size() + 1; }
+
+    /**
+     * @brief Calls `func` for every item in `[0, count)`, spread over all threads of the pool.
+     *
+     * Returns once every item has been processed. `func` is called concurrently and must be safe to call from several threads.
+     *
+     * @param count The number of items, at most 2^32 - 1.
+     * @param func The function to call with the index of every item.
+     */
+    template<std::invocable<usize> Func>
+    auto parallel_for(const usize count, Func&& func) -> void {
+        run(count, [](void* context, const usize item) { (*static_cast<std::remove_reference_t<Func>*>(context))(item); }, static_cast<void*>(std::addressof(func)));
+    }
+
+  private:
+    /**
+     * @brief Runs a type-erased loop on all threads.
+     * @param count The number of items.
+     * @param func The function to call for every item.
+     * @param context The context passed to `func`.
+     */
+    auto run(usize count, void (*func)(void* context, usize item), void* context) -> void;
+
+    /**
+     * @brief Processes items until there is nothing left to take or steal.
+     * @param self The index of the range owned by the calling thread.
+     */
+    auto work(usize self) -> void;
+
+    /**
+     * @brief Takes the next item from the front of a range.
+     * @param self The index of the range.
+     * @param item Set to the taken item.
+     * @return true if an item was taken, false if the range is empty.
+     */
+    auto pop(usize self, usize& item) -> bool;
+
+    /**
+     * @brief Steals the back half of the range of another thread.
+     * @param self The index of the range that receives the stolen items.
+     * @return true if items were stolen, false if all other ranges are empty.
+     */
+    auto steal(usize self) -> bool;
+
+    /**
+     * @brief The main loop of a worker thread.
+     * @param self The index of the range owned by the worker.
+     */
+    auto worker_loop(usize self) -> void;
+};
+} // namespace nid
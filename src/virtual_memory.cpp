@@ -0,0 +1,128 @@
+#include "virtual_memory.h"
+
+#include <cstdint>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace nid {
+#if defined(__linux__)
+auto reserve_address_space(const usize bytes, const bool huge_pages) -> void* {
+    // Over-reserve by a huge page, so the range can be trimmed to start at a huge page boundary
+    const usize slack{huge_pages ? huge_page_bytes : 0};
+    void* mapping = mmap(nullptr, bytes + slack, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    if (!huge_pages) {
+        return mapping;
+    }
+
+    const auto start = reinterpret_cast<std::uintptr_t>(mapping);
+    const auto aligned = (start + huge_page_bytes - 1) & ~(std::uintptr_t{huge_page_bytes} - 1);
+    if (const usize head{aligned - start}; head != 0) {
+        munmap(mapping, head);
+    }
+    if (const usize tail{slack - (aligned - start)}; tail != 0) {
+        munmap(reinterpret_cast<void*>(aligned + bytes), tail);
+    }
+
+    // Failing to get huge pages is not an error, the range is then backed by regular pages
+    madvise(reinterpret_cast<void*>(aligned), bytes, MADV_HUGEPAGE);
+    return reinterpret_cast<void*>(aligned);
+}
+
+auto commit_pages(void* ptr, const usize bytes) -> void {
+    if (bytes != 0 and mprotect(ptr, bytes, PROT_READ | PROT_WRITE) != 0) {
+        throw std::bad_alloc();
+    }
+}
+
+auto release_address_space(void* ptr, const usize bytes) noexcept -> void {
+    munmap(ptr, bytes);
+}
+
+auto commit_granularity(const bool huge_pages) noexcept -> usize {
+    static const auto page_bytes = static_cast<usize>(sysconf(_SC_PAGESIZE));
+    return huge_pages ? huge_page_bytes : page_bytes;
+}
+
+MappedFile::MappedFile(const std::filesystem::path& path) : handle(open(path.c_str(), O_RDONLY | O_CLOEXEC)) {
+    struct stat info{};
+    if (handle < 0 or fstat(handle, &info) != 0) {
+        if (handle >= 0) {
+            close(handle);
+        }
+        throw std::runtime_error("The file could not be opened");
+    }
+
+    size = static_cast<usize>(info.st_size);
+    if (size == 0) {
+        return;
+    }
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, handle, 0);
+    if (mapping == MAP_FAILED) {
+        close(handle);
+        throw std::runtime_error("The file could not be mapped");
+    }
+    data = static_cast<const std::byte*>(mapping);
+}
+
+MappedFile::~MappedFile() {
+    if (data != nullptr) {
+        munmap(const_cast<std::byte*>(data), size);
+    }
+    close(handle);
+}
+
+auto MappedFile::map_into(void* ptr, const usize offset, const usize bytes) const -> bool {
+    NIDAVELLIR_ASSERT(offset + bytes <= size, "Only pages of the file can be mapped");
+    if (mmap(ptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, handle, static_cast<off_t>(offset)) == MAP_FAILED) {
+        throw std::runtime_error("The file could not be mapped");
+    }
+    return true;
+}
+#else
+auto reserve_address_space(usize, bool) -> void* {
+    throw std::bad_alloc();
+}
+
+auto commit_pages(void*, usize) -> void {
+    throw std::bad_alloc();
+}
+
+auto release_address_space(void*, usize) noexcept -> void {}
+
+auto commit_granularity(bool) noexcept -> usize {
+    return 4096;
+}
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        throw std::runtime_error("The file could not be opened");
+    }
+    buffer.resize(static_cast<usize>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+    if (!file) {
+        throw std::runtime_error("The file could not be read");
+    }
+    data = buffer.data();
+    size = buffer.size();
+}
+
+MappedFile::~MappedFile() = default;
+
+auto MappedFile::map_into(void*, usize, usize) const -> bool {
+    return false;
+}
+#endif
+} // namespace nid
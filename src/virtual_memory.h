@@ -0,0 +1,108 @@
+#pragma once
+#include "core.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace nid {
+#if defined(__linux__)
+inline constexpr bool virtual_memory_supported{true}; ///< Whether address space can be reserved and committed separately.
+#else
+inline constexpr bool virtual_memory_supported{false}; ///< Whether address space can be reserved and committed separately.
+#endif
+
+inline constexpr usize huge_page_bytes{2 * 1024 * 1024}; ///< The size of a transparent huge page on x86-64 and AArch64.
+
+/**
+ * @brief Reserves a range of address space without backing it with memory.
+ *
+ * The pages of the range can not be accessed before they are committed with `commit_pages`. With `huge_pages` the
+ * range starts at a huge page boundary and the kernel is asked to back it with transparent huge pages.
+ *
+ * @param bytes The size of the range, a multiple of `commit_granularity(huge_pages)`.
+ * @param huge_pages Whether the range should be backed by transparent huge pages.
+ * @return The start of the range.
+ * @throws std::bad_alloc If the address space could not be reserved.
+ */
+auto reserve_address_space(usize bytes, bool huge_pages) -> void*;
+
+/**
+ * @brief Makes a part of a reserved range readable and writable.
+ *
+ * Physical memory is only taken when a committed page is first written.
+ *
+ * @param ptr The start of the part, a multiple of the page size.
+ * @param bytes The size of the part.
+ * @throws std::bad_alloc If the pages could not be committed.
+ */
+auto commit_pages(void* ptr, usize bytes) -> void;
+
+/**
+ * @brief Returns a reserved range and all its committed pages to the system.
+ * @param ptr The start of the range returned by `reserve_address_space`.
+ * @param bytes The size of the range.
+ */
+auto release_address_space(void* ptr, usize bytes) noexcept -> void;
+
+/**
+ * @brief Gets the granularity in which pages are committed.
+ * @param huge_pages Whether the range is backed by transparent huge pages.
+ * @return `huge_page_bytes` with huge pages, the page size otherwise.
+ */
+[[nodiscard]] auto commit_granularity(bool huge_pages) noexcept -> usize;
+
+/**
+ * @class MappedFile
+ * @brief A read-only view of a whole file.
+ *
+ * On Linux the file is mapped with `mmap`, so only the pages that are touched are read, and parts of it can be mapped
+ * again over reserved address space. Other platforms read the file into memory.
+ */
+class MappedFile {
+    const std::byte* data{nullptr};
+    usize size{0};
+    int handle{-1};                 ///< The file descriptor of the mapped file.
+    std::vector<std::byte> buffer;  ///< The contents of the file on platforms without `mmap`.
+
+  public:
+    /**
+     * @brief Opens and maps a file.
+     * @param path The path of the file.
+     * @throws std::runtime_error If the file could not be opened or mapped.
+     */
+    explicit MappedFile(const std::filesystem::path& path);
+
+    /**
+     * @brief Destructor, which unmaps and closes the file.
+     *
+     * Parts of the file that were mapped with `map_into` stay mapped.
+     */
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    auto operator=(const MappedFile&) -> MappedFile& = delete;
+    MappedFile(MappedFile&&) = delete;
+    auto operator=(MappedFile&&) -> MappedFile& = delete;
+
+    /**
+     * @brief Gets the contents of the file.
+     * @return The bytes of the file.
+     */
+    [[nodiscard]] auto bytes() const noexcept -> std::span<const std::byte> { return {data, size}; }
+
+    /**
+     * @brief Maps a part of the file as private copy-on-write pages over reserved address space.
+     *
+     * The pages are readable and writable, writes are never written back to the file.
+     *
+     * @param ptr The start of the pages, a multiple of the page size inside a range from `reserve_address_space`.
+     * @param offset The offset of the part in the file, a multiple of the page size.
+     * @param bytes The size of the part.
+     * @return true if the part was mapped, false if the platform can not map files.
+     * @throws std::runtime_error If the part could not be mapped.
+     */
+    auto map_into(void* ptr, usize offset, usize bytes) const -> bool;
+};
+} // namespace nid
@@ -3,48 +3,519 @@
 #include "core.h"
 #include "identifiers.h"
 
+#include <algorithm>
+#include <numeric>
 #include <stdexcept>
 
 namespace nid {
+namespace {
+/**
+ * @brief Copies a table and rolls the copy back to the time of a fork.
+ * @param arch The table.
+ * @param blocks The blocks of the table written since the fork.
+ * @param resource The resource of the copy.
+ * @param tick_source The change tick of the world.
+ * @return A contiguous copy of the table.
+ */
+auto copy_at_fork(const Archetype& arch, const ArchetypeUndo& blocks, std::pmr::memory_resource* resource, const u32* tick_source) -> std::unique_ptr<Archetype> {
+    auto copy = std::make_unique<Archetype>(CompTypeList(arch.type().begin(), arch.type().end()), StorageConfig{.resource = resource}, tick_source);
+    copy->copy_columns(arch);
+    copy->restore_blocks(blocks);
+    return copy;
+}
+
+/**
+ * @brief Replaces the columns of a table with the columns of a saved copy, which is left empty.
+ * @param arch The table.
+ * @param saved The copy of the table.
+ */
+auto restore_columns(Archetype& arch, Archetype& saved) -> void {
+    arch.clear();
+    std::vector<usize> rows(saved.data_row_count());
+    std::iota(rows.begin(), rows.end(), usize{0});
+    arch.append_columns(saved, rows);
+    for (usize row{0}; row < arch.data_row_count(); ++row) {
+        arch.mark_written(0, arch.len(), row);
+    }
+}
+} // namespace
+
 auto World::despawn(const EntityId entity) -> void {
-    if (const auto opt = entity_map.extract(entity); opt.has_value()) {
-        const auto [id, col] = opt.value().second;
-        auto& [arch, entities, _] = archetype_map.at(id);
+    auto& record = entity_record(entity);
+    before_table_change(record.archetype);
+    ++structural_epoch;
+    auto& arch = archetypes[record.archetype].archetype;
+    auto& entities = archetypes[record.archetype].entities;
+    const usize col{record.col};
+
+    NIDAVELLIR_ASSERT(entities[col] == entity, "The entity corresponding to the column should be the one we are despawning");
+    if (const auto moved_col = arch.remove(col); moved_col != col) {
+        entities[col] = entities[moved_col];
+        entity_records[entity_index(entities[col])].col = col;
+    }
+    entities.pop_back();
+
+    for (const auto index : sparse_indices) {
+        erase_sparse(index, entity);
+    }
+
+    ++record.generation;
+    free_entities.push_back(entity_index(entity));
+}
+
+auto World::allocate_entity(const ArchetypeId arch_id, const usize col) -> EntityId {
+    if (!free_entities.empty()) {
+        const auto index = free_entities.back();
+        free_entities.pop_back();
+
+        auto& record = entity_records[index];
+        record.archetype = arch_id;
+        record.col = col;
+        return make_entity_id(index, record.generation);
+    }
+
+    const auto index = static_cast<u32>(entity_records.size());
+    entity_records.push_back(EntityRecord{.archetype = arch_id, .col = col, .generation = 0});
+    return make_entity_id(index, 0);
+}
+
+auto World::finish_batch(ArchetypeRecord& arch_rec, const usize count) -> std::vector<EntityId> {
+    const usize first{arch_rec.archetype.len()};
+    arch_rec.archetype.increase_size(count);
+
+    std::vector<EntityId> new_entities(count);
+    const usize recycled{std::min(count, free_entities.size())};
+    for (usize i{0}; i < recycled; ++i) {
+        const auto index = free_entities[free_entities.size() - 1 - i];
+        auto& record = entity_records[index];
+        record.archetype = arch_rec.id;
+        record.col = first + i;
+        new_entities[i] = make_entity_id(index, record.generation);
+    }
+    free_entities.resize(free_entities.size() - recycled);
+
+    auto index = static_cast<u32>(entity_records.size());
+    entity_records.reserve(entity_records.size() + count - recycled);
+    for (usize i{recycled}; i < count; ++i, ++index) {
+        entity_records.push_back(EntityRecord{.archetype = arch_rec.id, .col = first + i, .generation = 0});
+        new_entities[i] = make_entity_id(index, 0);
+    }
+
+    arch_rec.entities.insert(arch_rec.entities.end(), new_entities.begin(), new_entities.end());
+    return new_entities;
+}
+
+auto World::register_component(const usize sequence, CompTypeInfo info, const bool sparse) -> usize {
+    info.index = components.size();
+    components.push_back(info);
+    sparse_sets.emplace_back();
+    if (sparse) {
+        sparse_sets.back() = std::make_unique<SparseSet>(info, &change_tick, storage_config.resource);
+        sparse_indices.push_back(info.index);
+    }
+
+    if (sequence >= sequence_indices.size()) {
+        sequence_indices.resize(sequence + 1, no_component_index);
+    }
+    sequence_indices[sequence] = info.index;
+    return info.index;
+}
+
+auto World::find_archetype(const u64 hash, const std::span<const ComponentId> ids) const -> ArchetypeId {
+    const auto arch_it = type_map.find(hash);
+    if (arch_it == type_map.end()) {
+        return no_archetype;
+    }
+
+    for (ArchetypeId arch_id{arch_it->second}; arch_id != no_archetype; arch_id = archetypes[arch_id].next_same_hash) {
+        if (archetypes[arch_id].signature.matches(hash, ids)) {
+            return arch_id;
+        }
+    }
+    return no_archetype;
+}
+
+auto World::find_or_create_archetype(const std::span<const CompTypeInfo> comp_ts) -> ArchetypeRecord& {
+    scratch_ids.clear();
+    for (const auto& info : comp_ts) {
+        scratch_ids.push_back(info.id);
+    }
 
-        const auto moved_col = arch.remove(col);
+    const u64 hash{signature_hash(scratch_ids)};
+    if (const auto arch_id = find_archetype(hash, scratch_ids); arch_id != no_archetype) {
+        return archetypes[arch_id];
+    }
+
+    const ArchetypeId new_arch_id{archetypes.size()};
+    ++structural_epoch;
+    ComponentMask mask;
+    for (usize row{0}; row < comp_ts.size(); ++row) {
+        NIDAVELLIR_ASSERT(comp_ts[row].index != no_component_index, "Archetypes can only be created from registered components");
+        mask.set(comp_ts[row].index);
+    }
 
-        NIDAVELLIR_ASSERT(entities[col] == entity, "The entity corresponding to the column should be the one we are despawning");
-        if (moved_col != col) {
-            entity_map.at(entities[moved_col]).col = col;
-            std::swap(entities[col], entities[moved_col]);
-            entities.pop_back();
+    archetypes.push_back(ArchetypeRecord{.archetype = Archetype(CompTypeList(comp_ts.begin(), comp_ts.end()), storage_config, &change_tick),
+                                         .entities = std::pmr::vector<EntityId>(storage_config.resource),
+                                         .id = new_arch_id,
+                                         .signature = Signature(scratch_ids, hash),
+                                         .mask = std::move(mask),
+                                         .add_edges = {},
+                                         .remove_edges = {}});
+    archetype_masks.push_back(archetypes.back().mask);
+
+    // Archetypes with colliding hashes are chained behind the first one
+    if (const auto [arch_it, inserted] = type_map.try_emplace(hash, new_arch_id); !inserted) {
+        ArchetypeId last{arch_it->second};
+        while (archetypes[last].next_same_hash != no_archetype) {
+            last = archetypes[last].next_same_hash;
         }
-    } else {
-        throw std::out_of_range("The entity was not found");
+        archetypes[last].next_same_hash = new_arch_id;
     }
+
+    for (const auto& cache : query_caches) {
+        match_query(*cache, new_arch_id);
+    }
+
+    return archetypes.back();
 }
 
-auto World::find_or_create_archetype(const CompTypeList& comp_ts) -> ArchetypeRecord& {
-    auto func = [&](const ArchetypeId arch_id, const CompTypeList& comps) {
-        for (usize i{0}; i < comps.size(); ++i) {
-            if (const auto comp_it = component_map.find(comps[i].id); comp_it != component_map.end()) {
-                comp_it->second.insert({arch_id, RowRecord{.row = i}});
-            } else {
-                auto [fst, _] = component_map.insert({comps[i].id, ArchetypeMap{}});
-                fst->second.insert({arch_id, RowRecord{.row = i}});
-            }
+auto World::create_add_edge(const ArchetypeId src_id, const usize key, const std::span<const CompTypeInfo> pack_infos) -> const ArchetypeEdge& {
+    NIDAVELLIR_ASSERT(scratch_component_buffer.empty(), "The scratch buffer has not been cleared");
+
+    auto in_pack = [&](const CompTypeInfo& info1) {
+        return std::ranges::find_if(pack_infos, [&](const CompTypeInfo& info2) { return info1.id == info2.id; }) != pack_infos.end();
+    };
+
+    const auto src_types = archetypes[src_id].archetype.type();
+    scratch_component_buffer.reserve(pack_infos.size() + src_types.size());
+    std::ranges::copy(pack_infos, std::back_inserter(scratch_component_buffer));
+    for (const auto& info : src_types) {
+        if (!in_pack(info)) {
+            scratch_component_buffer.push_back(info);
         }
+    }
+    sort_component_list(scratch_component_buffer);
+
+    const auto target_id = find_or_create_archetype(scratch_component_buffer).id;
+    scratch_component_buffer.clear();
+
+    const auto& src_arch = archetypes[src_id].archetype;
+    const auto& target_arch = archetypes[target_id].archetype;
+    ArchetypeEdge edge{.target = target_id, .row_map = {}};
+    edge.row_map.reserve(src_arch.type().size());
+    for (const auto& info : src_arch.type()) {
+        edge.row_map.push_back(in_pack(info) ? ArchetypeEdge::dropped_row : target_arch.row_of(info.index));
+    }
+
+    // When none of the components existed before, the reverse transition is known as well
+    if (std::ranges::none_of(edge.row_map, [](const usize row) { return row == ArchetypeEdge::dropped_row; })) {
+        ArchetypeEdge reverse{.target = src_id, .row_map = {}};
+        reverse.row_map.reserve(target_arch.type().size());
+        for (const auto& info : target_arch.type()) {
+            reverse.row_map.push_back(in_pack(info) ? ArchetypeEdge::dropped_row : src_arch.row_of(info.index));
+        }
+        archetypes[target_id].remove_edges.insert({key, std::move(reverse)});
+    }
+
+    auto [fst, _] = archetypes[src_id].add_edges.insert({key, std::move(edge)});
+    return fst->second;
+}
+
+auto World::create_remove_edge(const ArchetypeId src_id, const usize key, const std::span<const CompTypeInfo> pack_infos) -> const ArchetypeEdge& {
+    NIDAVELLIR_ASSERT(scratch_component_buffer.empty(), "The scratch buffer has not been cleared");
+
+    auto in_pack = [&](const CompTypeInfo& info1) {
+        return std::ranges::find_if(pack_infos, [&](const CompTypeInfo& info2) { return info1.id == info2.id; }) != pack_infos.end();
     };
 
-    if (const auto arch_it = type_map.find(comp_ts); arch_it != type_map.end()) {
-        return archetype_map.at(arch_it->second);
+    const auto src_types = archetypes[src_id].archetype.type();
+
+#ifndef NDEBUG
+    auto in_entity_type = [&](const CompTypeInfo& info1) {
+        return std::ranges::find_if(src_types, [&](const CompTypeInfo& info2) { return info1.id == info2.id; }) != src_types.end();
+    };
+
+    for (const auto& info : pack_infos) {
+        NIDAVELLIR_ASSERT(in_entity_type(info), "Tried removing a component from an entity that did not have it");
+    }
+#endif
+
+    scratch_component_buffer.reserve(src_types.size());
+    for (const auto& info : src_types) {
+        if (!in_pack(info)) {
+            scratch_component_buffer.push_back(info);
+        }
     }
+    sort_component_list(scratch_component_buffer);
+
+    const auto target_id = find_or_create_archetype(scratch_component_buffer).id;
+    scratch_component_buffer.clear();
 
-    const auto new_arch_id = next_archetype_id++;
-    auto [fst, _] = archetype_map.insert(
-        {new_arch_id, ArchetypeRecord{.archetype = Archetype(comp_ts), .entities = {}, .id = new_arch_id}});
-    func(new_arch_id, comp_ts);
-    type_map.insert({comp_ts, new_arch_id});
+    const auto& src_arch = archetypes[src_id].archetype;
+    const auto& target_arch = archetypes[target_id].archetype;
+    ArchetypeEdge edge{.target = target_id, .row_map = {}};
+    edge.row_map.reserve(src_arch.type().size());
+    for (const auto& info : src_arch.type()) {
+        edge.row_map.push_back(in_pack(info) ? ArchetypeEdge::dropped_row : target_arch.row_of(info.index));
+    }
+
+    auto [fst, _] = archetypes[src_id].remove_edges.insert({key, std::move(edge)});
     return fst->second;
 }
+
+auto World::move_entity(const EntityId entity, EntityRecord& record, const ArchetypeEdge& edge) -> void {
+    before_table_change(record.archetype);
+    before_table_change(edge.target);
+    ++structural_epoch;
+    auto& src_arch = archetypes[record.archetype].archetype;
+    auto& src_entities = archetypes[record.archetype].entities;
+    auto& target_arch = archetypes[edge.target].archetype;
+    auto& target_entities = archetypes[edge.target].entities;
+    const usize src_col{record.col};
+
+    target_arch.prepare_push(1);
+    const usize target_col{target_arch.len()};
+    target_arch.increase_size(1);
+
+    // Tags have no storage, only the rows with data are moved
+    const auto src_types = src_arch.type();
+    const usize src_data_rows{src_arch.data_row_count()};
+    for (usize row{0}; row < src_data_rows; ++row) {
+        void* src_ptr = src_arch.get_raw(src_col, row);
+        if (const auto target_row = edge.row_map[row]; target_row != ArchetypeEdge::dropped_row) {
+            src_types[row].ops->move_ctor_dtor(target_arch.get_raw(target_col, target_row), src_ptr, 1);
+            target_arch.copy_ticks(target_col, target_row, src_arch, src_col, row);
+            target_arch.copy_enabled(target_col, target_row, src_arch, src_col, row);
+        } else {
+            src_types[row].ops->dtor(src_ptr, 1);
+        }
+    }
+
+    target_entities.push_back(entity);
+
+    const usize src_last_col{src_arch.len() - 1};
+    if (src_col < src_last_col) {
+        // The column of the moved entity is already destroyed, so the last column is moved into it directly.
+        for (usize row{0}; row < src_data_rows; ++row) {
+            src_types[row].ops->move_ctor_dtor(src_arch.get_raw(src_col, row), src_arch.get_raw(src_last_col, row), 1);
+            src_arch.copy_ticks(src_col, row, src_arch, src_last_col, row);
+            src_arch.copy_enabled(src_col, row, src_arch, src_last_col, row);
+        }
+        src_entities[src_col] = src_entities[src_last_col];
+        entity_records[entity_index(src_entities[src_col])].col = src_col;
+    }
+
+    src_entities.pop_back();
+    src_arch.decrease_size(1);
+
+    record.archetype = edge.target;
+    record.col = target_col;
+}
+
+auto World::move_table(const ArchetypeId src_id, const ArchetypeEdge& edge) -> usize {
+    before_table_change(src_id);
+    before_table_change(edge.target);
+    ++structural_epoch;
+    auto& src_rec = archetypes[src_id];
+    auto& target_rec = archetypes[edge.target];
+
+    const usize first{target_rec.archetype.append_columns(src_rec.archetype, edge.row_map)};
+    for (usize i{0}; i < src_rec.entities.size(); ++i) {
+        auto& record = entity_records[entity_index(src_rec.entities[i])];
+        record.archetype = edge.target;
+        record.col = first + i;
+    }
+
+    target_rec.entities.insert(target_rec.entities.end(), src_rec.entities.begin(), src_rec.entities.end());
+    src_rec.entities.clear();
+    return first;
+}
+
+auto World::despawn_table(const ArchetypeId arch_id) -> usize {
+    before_table_change(arch_id);
+    ++structural_epoch;
+    auto& arch_rec = archetypes[arch_id];
+    const usize count{arch_rec.entities.size()};
+    for (const auto entity : arch_rec.entities) {
+        for (const auto index : sparse_indices) {
+            erase_sparse(index, entity);
+        }
+        ++entity_records[entity_index(entity)].generation;
+        free_entities.push_back(entity_index(entity));
+    }
+
+    arch_rec.archetype.clear();
+    arch_rec.entities.clear();
+    return count;
+}
+
+auto World::find_or_create_query(const std::span<const CompTypeInfo> terms, const u64 optional_mask) -> QueryCache& {
+    QueryKey key{.ids = {}, .optional_mask = optional_mask};
+    key.ids.reserve(terms.size());
+    for (const auto& term : terms) {
+        key.ids.push_back(term.id);
+    }
+
+    if (const auto query_it = query_map.find(key); query_it != query_map.end()) {
+        return *query_caches[query_it->second];
+    }
+
+    auto cache = std::make_unique<QueryCache>();
+    cache->terms.assign(terms.begin(), terms.end());
+    cache->optional_mask = optional_mask;
+    for (usize i{0}; i < terms.size(); ++i) {
+        if ((optional_mask >> i & 1) == 0) {
+            cache->required.set(terms[i].index);
+        }
+    }
+
+    archetype_masks.for_each_match(cache->required, [&](const ArchetypeId arch_id) { add_query_match(*cache, arch_id); });
+
+    query_map.insert({std::move(key), query_caches.size()});
+    query_caches.push_back(std::move(cache));
+    return *query_caches.back();
+}
+
+auto World::match_query(QueryCache& cache, const ArchetypeId arch_id) const -> void {
+    if (archetypes[arch_id].mask.contains(cache.required)) {
+        add_query_match(cache, arch_id);
+    }
+}
+
+auto World::add_query_match(QueryCache& cache, const ArchetypeId arch_id) const -> void {
+    const auto& arch = archetypes[arch_id].archetype;
+    cache.archetypes.push_back(arch_id);
+    for (const auto& term : cache.terms) {
+        cache.rows.push_back(arch.row_of(term.index));
+    }
+}
+auto World::fork() -> ForkId {
+    if (std::ranges::any_of(components, [](const CompTypeInfo& info) { return info.size != 0 and info.ops->copy_ctor == nullptr; })) {
+        throw std::logic_error("Only worlds whose components are copy constructible can be forked");
+    }
+    forks.push_back(start_fork(next_fork++));
+    return forks.back()->id;
+}
+
+auto World::restore(const ForkId id) -> void {
+    const usize position{fork_position(id)};
+    for (usize i{forks.size()}; i-- > position;) {
+        undo_fork(*forks[i]);
+    }
+    forks.resize(position + 1);
+    ++structural_epoch;
+
+    // The fork now describes the current state, so it starts over with empty logs
+    forks.back() = start_fork(id);
+}
+
+auto World::release_fork(const ForkId id) -> void {
+    const usize position{fork_position(id)};
+    if (position + 1 == forks.size()) {
+        for (auto& rec : archetypes) {
+            rec.archetype.set_undo(nullptr);
+        }
+        for (const auto index : sparse_indices) {
+            sparse_sets[index]->table().set_undo(nullptr);
+        }
+    }
+    forks.erase(forks.begin(), forks.begin() + static_cast<std::ptrdiff_t>(position + 1));
+}
+
+auto World::fork_position(const ForkId id) const -> usize {
+    const auto fork_it = std::ranges::find_if(forks, [&](const std::unique_ptr<Fork>& fork) { return fork->id == id; });
+    if (fork_it == forks.end()) {
+        throw std::out_of_range("The fork was released");
+    }
+    return static_cast<usize>(fork_it - forks.begin());
+}
+
+auto World::start_fork(const ForkId id) -> std::unique_ptr<Fork> {
+    auto fork = std::make_unique<Fork>();
+    fork->id = id;
+    fork->tables.resize(archetypes.size());
+    fork->sparse.resize(components.size());
+    for (auto& rec : archetypes) {
+        rec.archetype.set_undo(&fork->tables[rec.id].blocks);
+    }
+    for (const auto index : sparse_indices) {
+        sparse_sets[index]->table().set_undo(&fork->sparse[index].blocks);
+    }
+    return fork;
+}
+
+auto World::save_fork_table(const ArchetypeId arch_id) -> void {
+    auto& fork = *forks.back();
+    if (!fork.slots_saved) {
+        fork.entity_records.assign(entity_records.begin(), entity_records.end());
+        fork.free_entities.assign(free_entities.begin(), free_entities.end());
+        fork.slots_saved = true;
+    }
+
+    // Archetypes created after the fork are cleared on restore
+    if (arch_id >= fork.tables.size() or fork.tables[arch_id].table != nullptr) {
+        return;
+    }
+    auto& undo = fork.tables[arch_id];
+    auto& rec = archetypes[arch_id];
+    undo.table = copy_at_fork(rec.archetype, undo.blocks, storage_config.resource, &change_tick);
+    undo.blocks = ArchetypeUndo{};
+    undo.entities.assign(rec.entities.begin(), rec.entities.end());
+    rec.archetype.set_undo(nullptr);
+}
+
+auto World::save_fork_sparse_set(const usize index) -> void {
+    auto& fork = *forks.back();
+    if (index >= fork.sparse.size() or fork.sparse[index].table != nullptr) {
+        return;
+    }
+    auto& undo = fork.sparse[index];
+    auto& set = *sparse_sets[index];
+    undo.table = copy_at_fork(set.table(), undo.blocks, storage_config.resource, &change_tick);
+    undo.blocks = ArchetypeUndo{};
+    undo.entities.assign(set.entities().begin(), set.entities().end());
+    set.table().set_undo(nullptr);
+}
+
+auto World::erase_sparse(const usize index, const EntityId entity) -> void {
+    auto& set = *sparse_sets[index];
+    if (!forks.empty() and set.contains(entity)) [[unlikely]] {
+        save_fork_sparse_set(index);
+    }
+    set.erase(entity);
+}
+
+auto World::undo_fork(Fork& fork) -> void {
+    for (auto& rec : archetypes) {
+        rec.archetype.set_undo(nullptr);
+        if (rec.id >= fork.tables.size()) {
+            rec.archetype.clear();
+            rec.entities.clear();
+        } else if (auto& undo = fork.tables[rec.id]; undo.table != nullptr) {
+            restore_columns(rec.archetype, *undo.table);
+            rec.entities.assign(undo.entities.begin(), undo.entities.end());
+        } else {
+            rec.archetype.restore_blocks(undo.blocks);
+        }
+    }
+
+    for (const auto index : sparse_indices) {
+        auto& set = *sparse_sets[index];
+        set.table().set_undo(nullptr);
+        if (index >= fork.sparse.size()) {
+            set.clear();
+        } else if (auto& undo = fork.sparse[index]; undo.table != nullptr) {
+            set.clear();
+            restore_columns(set.table(), *undo.table);
+            set.append_entities(undo.entities);
+        } else {
+            set.table().restore_blocks(undo.blocks);
+        }
+    }
+
+    if (fork.slots_saved) {
+        entity_records.assign(fork.entity_records.begin(), fork.entity_records.end());
+        free_entities.assign(fork.free_entities.begin(), fork.free_entities.end());
+    }
+}
 } // namespace nid
@@ -2,19 +2,76 @@
 #pragma once
 #include "archetype.h"
 #include "comp_type_info.h"
+#include "component_mask.h"
+#include "signature.h"
 #include "identifiers.h"
+#include "sparse_set.h"
+#include "thread_pool.h"
 
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <cassert>
 #include <concepts>
+#include <filesystem>
 #include <iterator>
+#include <limits>
+#include <memory>
 #include <memory_resource>
+#include <span>
+#include <stdexcept>
 #include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <ankerl/unordered_dense.h>
 
 namespace nid {
+class CommandBuffer;
+
+/**
+ * @brief The kinds of change filters of a query.
+ */
+enum class ChangeFilterKind : u8 {
+    added,   ///< The component was added since the last run.
+    changed, ///< The component was added or changed since the last run.
+};
+
+/**
+ * @brief A query filter matching entities whose component `T` was added since the last run of the query.
+ * @tparam T The component type, which has to be one of the queried types.
+ */
+template<Component T>
+struct Added {
+    using component = T;
+    static constexpr ChangeFilterKind kind{ChangeFilterKind::added};
+};
+
+/**
+ * @brief A query filter matching entities whose component `T` was added or changed since the last run of the query.
+ * @tparam T The component type, which has to be one of the queried types.
+ */
+template<Component T>
+struct Changed {
+    using component = T;
+    static constexpr ChangeFilterKind kind{ChangeFilterKind::changed};
+};
+
+/**
+ * @brief Concept of a query filter, either `Added<T>` or `Changed<T>`.
+ */
+template<typename F>
+concept ChangeFilter = std::same_as<F, Added<typename F::component>> or std::same_as<F, Changed<typename F::component>>;
+
+/**
+ * @brief The pointers `World::get_many` writes per entity, a single pointer for one component type and a tuple of
+ * pointers in pack order otherwise.
+ * @tparam Ts The component types.
+ */
+template<Component... Ts>
+using ComponentPointers = std::conditional_t<sizeof...(Ts) == 1, std::tuple_element_t<0, std::tuple<Ts*...>>, std::tuple<Ts*...>>;
+
 /**
  * @class World
  * @brief A World which is the heart of the ECS.
@@ -51,53 +108,173 @@ namespace nid {
  * \endcode
  */
 class World {
+    friend class CommandBuffer;
+    /**
+     * @brief A cached transition from one archetype to another.
+     *
+     * `row_map` holds the target row of every row in the source archetype, or `dropped_row`
+     * if the component is destroyed by the transition (removed, or overwritten by an add).
+     */
+    struct ArchetypeEdge {
+        static constexpr usize dropped_row{std::numeric_limits<usize>::max()};
+
+        ArchetypeId target;
+        std::vector<usize> row_map;
+    };
+
+    using EdgeMap = ankerl::unordered_dense::map<usize, ArchetypeEdge>;
+
+    static constexpr ArchetypeId no_archetype{std::numeric_limits<ArchetypeId>::max()};
+
     struct ArchetypeRecord {
         Archetype archetype;
-        std::vector<EntityId> entities;
+        std::pmr::vector<EntityId> entities;
         ArchetypeId id;
+        Signature signature;                      ///< The component ids of the archetype in row order.
+        ArchetypeId next_same_hash{no_archetype}; ///< The next archetype whose signature has the same hash.
+        ComponentMask mask;                       ///< The dense indices of the components of the archetype.
+        EdgeMap add_edges;    ///< Transitions for added component packs, keyed by `pack_id`.
+        EdgeMap remove_edges; ///< Transitions for removed component packs, keyed by `pack_id`.
     };
 
     struct EntityRecord {
         ArchetypeId archetype;
         usize col;
+        u32 generation; ///< The current generation of the slot, incremented when the entity is despawned.
+    };
+
+    /**
+     * @brief The cached state of a registered query.
+     *
+     * A query cache is created once per distinct query signature and kept up to date by
+     * `find_or_create_archetype`, which matches every new archetype against all registered caches.
+     * For every matched archetype the row of each term is stored, `absent_row` marking optional terms
+     * that the archetype does not have.
+     */
+    struct QueryCache {
+        static constexpr usize absent_row{Archetype::no_row};
+
+        CompTypeList terms;                  ///< The queried components in pack order.
+        ComponentMask required;              ///< The dense indices of the components an archetype needs to match.
+        u64 optional_mask{0};                ///< Bit i is set if term i is optional.
+        std::vector<ArchetypeId> archetypes; ///< The matched archetypes.
+        std::vector<usize> rows;             ///< The rows of the terms, `terms.size()` entries per matched archetype.
     };
 
-    struct RowRecord {
-        usize row;
+    /**
+     * @brief The state of a table or sparse set at the time of a fork.
+     *
+     * Until the first structural change, the blocks written since the fork are enough to restore the table. The first
+     * structural change replaces them with a copy of the whole table.
+     */
+    struct TableUndo {
+        ArchetypeUndo blocks;             ///< The tick blocks written since the fork, while the table kept its columns.
+        std::unique_ptr<Archetype> table; ///< A copy of the table at the time of the fork, `nullptr` if the table kept its columns.
+        std::vector<EntityId> entities;   ///< The entities of the copied table.
+    };
+
+    /**
+     * @brief A copy-on-write snapshot of the world, see `fork`.
+     */
+    struct Fork {
+        ForkId id;
+        std::vector<TableUndo> tables;            ///< The state of every archetype that existed at the time of the fork.
+        std::vector<TableUndo> sparse;            ///< The state of every sparse set, indexed by the dense index at the time of the fork.
+        bool slots_saved{false};                  ///< Whether the entity slots are saved, which happens before the first structural change.
+        std::vector<EntityRecord> entity_records; ///< The entity slots at the time of the fork.
+        std::vector<u32> free_entities;           ///< The free slots at the time of the fork.
+    };
+
+    struct QueryKey {
+        std::vector<ComponentId> ids;
+        u64 optional_mask;
+
+        [[nodiscard]] auto operator==(const QueryKey& rhs) const noexcept -> bool = default;
+    };
+
+    struct QueryKeyHash {
+        auto operator()(const QueryKey& x) const noexcept -> u64 { return hash_mix(signature_hash(x.ids) ^ x.optional_mask); }
     };
 
-    using ArchetypeMap = ankerl::unordered_dense::map<ArchetypeId, RowRecord>;
+    std::vector<ArchetypeRecord> archetypes;
+    std::pmr::vector<EntityRecord> entity_records; ///< Entity slots indexed by `entity_index`.
+    std::pmr::vector<u32> free_entities;           ///< Indices of slots that can be recycled.
 
-    ankerl::unordered_dense::map<ArchetypeId, ArchetypeRecord> archetype_map;
-    ankerl::unordered_dense::map<EntityId, EntityRecord> entity_map;
+    CompTypeList components;                                      ///< The registered component types, indexed by their dense index.
+    std::vector<usize> sequence_indices;                          ///< The dense index of every `type_sequence`, `no_component_index` if unregistered.
+    ComponentMaskTable archetype_masks;                           ///< The mask of every archetype, indexed by ArchetypeId.
+    ankerl::unordered_dense::map<u64, ArchetypeId, PrehashedHash> type_map; ///< The first archetype with every signature hash.
+    std::vector<ArchetypeId> spawn_archetypes;                    ///< The archetype of every `pack_sequence` spawned so far, `no_archetype` if unresolved.
+    std::vector<std::unique_ptr<SparseSet>> sparse_sets;          ///< The storage of every sparse component, indexed by dense index, `nullptr` for table components.
+    std::vector<usize> sparse_indices;                            ///< The dense indices of all sparse components.
 
-    ankerl::unordered_dense::map<ComponentId, ArchetypeMap> component_map;
-    ankerl::unordered_dense::map<CompTypeList, ArchetypeId, TypeHash> type_map;
+    std::vector<std::unique_ptr<QueryCache>> query_caches;
+    ankerl::unordered_dense::map<QueryKey, usize, QueryKeyHash> query_map;
 
     CompTypeList scratch_component_buffer;
+    std::vector<ComponentId> scratch_ids; ///< The ids of a type list that is looked up in `type_map`.
 
-    ArchetypeId next_archetype_id{0};
-    EntityId next_entity_id{0};
+    StorageConfig storage_config;
+    u32 change_tick{1}; ///< The tick stamped on changes, advanced by every filtered query run.
+    u64 structural_epoch{0}; ///< Advanced by every change that can move an entity or an archetype, see `EntityRef`.
+    ThreadPool* thread_pool{nullptr};
+
+    std::vector<std::unique_ptr<Fork>> forks; ///< The live forks, oldest first. The archetypes log their writes to the newest one.
+    ForkId next_fork{0};
 
   public:
+    /**
+     * @brief A query over all entities that have a set of components.
+     *
+     * The matched archetypes are resolved the first time the query is run and cached in the world,
+     * which keeps the cache up to date as new archetypes are created. Keeping a query around and running it
+     * repeatedly therefore only costs the iteration over the matched tables. Queries with the same components
+     * and optional flags share one cache, so even a query that is recreated every frame only pays a single lookup.
+     *
+     * Components that are queried as non-const are marked as changed for every run that is passed to the
+     * callback, so types that are only read should be queried as `const T`.
+     *
+     * \code{.cpp}
+     * // Keep the query around, a filtered query only reports changes since its own last run
+     * auto moved = world.query<const Position>();
+     * moved.filter<Changed<Position>>();
+     * moved.run([&](usize len, const Position* positions) { spatial_index.update(positions, len); });
+     * \endcode
+     *
+     * @tparam Ts The queried component types.
+     */
     template<Component... Ts>
     class Query {
         friend class World;
 
-        using table_match = std::tuple<usize, Ts*...>;
+        struct Filter {
+            usize term;            ///< The index of the filtered component in `Ts`.
+            ChangeFilterKind kind; ///< The kind of the filter.
+        };
+
+        struct Slice {
+            usize table; ///< The index of the table in the query cache.
+            usize begin; ///< The first column of the slice.
+            usize len;   ///< The number of columns in the slice.
+        };
+
+        static constexpr std::array<bool, sizeof...(Ts)> sparse_terms{SparseComponent<Ts>...};
+        static constexpr bool has_sparse_terms{(SparseComponent<Ts> or ...)};
+        static constexpr std::array<bool, sizeof...(Ts)> enableable_terms{EnableableComponent<Ts>...};
+        static constexpr bool has_enableable_terms{(EnableableComponent<Ts> or ...)};
+
         World* world;
-        std::vector<table_match> table_args;
-        std::vector<CompTypeInfo> required_comps;
-        std::vector<CompTypeInfo> optional_comps;
+        QueryCache* cache{nullptr};
         usize selected_index{0};
         std::array<bool, sizeof...(Ts)> optional_flags{false};
+        std::vector<Filter> filters;
+        u32 last_run_tick{0}; ///< The change tick of the last filtered run.
+
+        std::vector<Slice> slices; ///< The slices of a parallel run, reused between runs.
+        std::vector<usize> tasks;  ///< The end of the slices of each task of a parallel run.
 
       public:
-        explicit Query(World* world) : world(world) {
-            table_args.reserve(100);
-            required_comps.reserve(4);
-            optional_comps.reserve(2);
-        }
+        explicit Query(World* world) : world(world) {}
 
         ~Query() = default;
 
@@ -107,52 +284,561 @@ class World {
         auto operator=(Query&&) noexcept -> Query& = default;
 
         auto select(const usize index) -> Query<Ts...>& {
+            NIDAVELLIR_ASSERT(cache == nullptr, "A query can not be changed after it has been run");
             selected_index = index;
             return *this;
         }
 
         auto optional() -> Query<Ts...>& {
+            NIDAVELLIR_ASSERT(cache == nullptr, "A query can not be changed after it has been run");
             optional_flags[selected_index] = true;
             return *this;
         }
 
+        /**
+         * @brief Restricts the query to entities that were added or changed since the last run of this query.
+         *
+         * Several filters all have to match. The filtered components have to be queried, tables without a filtered
+         * optional component are skipped. Only tick blocks that contain a match are visited.
+         *
+         * @tparam Fs The filters, `Added<T>` or `Changed<T>`.
+         * @return A reference to the query.
+         */
+        template<ChangeFilter... Fs>
+        auto filter() -> Query<Ts...>& {
+            NIDAVELLIR_ASSERT(cache == nullptr, "A query can not be changed after it has been run");
+            static_assert(((term_index<typename Fs::component>() < sizeof...(Ts)) and ...), "A filtered component has to be queried");
+            static_assert((!SparseComponent<typename Fs::component> and ...), "Sparse components can not be filtered");
+            static_assert((!TagComponent<typename Fs::component> and ...), "Tag components have no change ticks");
+            (..., filters.push_back(Filter{.term = term_index<typename Fs::component>(), .kind = Fs::kind}));
+            return *this;
+        }
+
+        /**
+         * @brief Runs the query, calling `func` once for every contiguous run of a matched table.
+         *
+         * The function receives the number of entities in the run followed by a pointer to the first
+         * component of every queried type. The pointer of an optional component is `nullptr` if the table does not have it.
+         * Tag components have no storage, the pointer of a present tag points to a single shared instance and must not be indexed.
+         * Entities whose required enableable components are disabled are skipped, and runs are split where they start or end.
+         * A disabled optional component is passed as `nullptr`, like a missing one.
+         * A table with contiguous storage is a single run, a chunked table has one run per chunk. Empty tables are skipped.
+         * A filtered query is called for runs of matching entities within a tick block.
+         *
+         * Sparse components are joined per entity, so a query with sparse components calls `func` once per matched entity
+         * with a length of one. If a sparse component is required, the smallest required sparse set drives the iteration
+         * and only its entities are visited.
+         *
+         * @param func The function to call for every run.
+         */
         template<std::invocable<usize, Ts*...> Func>
         auto run(Func&& func) -> void {
-            build();
-            for (const auto& tup : table_args) {
-                std::apply(std::forward<Func>(func), tup);
+            if (cache == nullptr) {
+                build();
+            }
+
+            if constexpr (has_sparse_terms) {
+                run_sparse(func);
+                return;
+            }
+
+            if (!filters.empty()) {
+                run_filtered(func);
+                return;
+            }
+
+            for (usize i{0}; i < cache->archetypes.size(); ++i) {
+                auto& arch = world->archetypes[cache->archetypes[i]].archetype;
+                const usize* rows = cache->rows.data() + i * sizeof...(Ts);
+                arch.for_each_run(0, arch.len(), [&](const usize begin, const usize len) {
+                    for_each_enabled_run(arch, rows, begin, len, [&](const usize run_begin, const usize run_len, const u64 disabled) {
+                        mark_written(arch, rows, run_begin, run_len, disabled);
+                        run_slice(func, arch, rows, run_begin, run_len, disabled, std::index_sequence_for<Ts...>{});
+                    });
+                });
+            }
+        }
+
+        /**
+         * @brief Runs the query on the thread pool of the world.
+         *
+         * The matched tables are split into tasks of about `rows_per_task` columns: large tables are split into
+         * several tasks and consecutive small tables are batched into one task. Slices never cross a chunk of a chunked
+         * table. `func` is called once per slice of a table, concurrently from all threads of the pool, and receives the length of the slice followed by
+         * pointers to its first components. Runs serially if no thread pool is attached to the world, the query is filtered
+         * or it has sparse components.
+         *
+         * @param func The function to call for every slice, which must be safe to call from several threads.
+         * @param rows_per_task The number of columns processed by each task.
+         */
+        template<std::invocable<usize, Ts*...> Func>
+        auto run_parallel(Func&& func, const usize rows_per_task = 16 * 1024) -> void {
+            NIDAVELLIR_ASSERT(rows_per_task > 0, "A task needs to process at least one column");
+            if (world->thread_pool == nullptr or !filters.empty() or has_sparse_terms) {
+                run(func);
+                return;
+            }
+
+            if (cache == nullptr) {
+                build();
+            }
+
+            slices.clear();
+            tasks.clear();
+            usize batched{0};
+            for (usize i{0}; i < cache->archetypes.size(); ++i) {
+                auto& arch = world->archetypes[cache->archetypes[i]].archetype;
+                const usize len{arch.len()};
+                const usize* rows = cache->rows.data() + i * sizeof...(Ts);
+                for_each_enabled_run(arch, rows, 0, len, [&](const usize run_begin, const usize run_len, const u64 disabled) { mark_written(arch, rows, run_begin, run_len, disabled); });
+                for (usize begin{0}; begin < len;) {
+                    const usize count{std::min({len - begin, rows_per_task - batched, arch.run_len(begin)})};
+                    slices.push_back(Slice{.table = i, .begin = begin, .len = count});
+                    begin += count;
+                    batched += count;
+                    if (batched == rows_per_task) {
+                        tasks.push_back(slices.size());
+                        batched = 0;
+                    }
+                }
             }
+            if (batched > 0) {
+                tasks.push_back(slices.size());
+            }
+
+            world->thread_pool->parallel_for(tasks.size(), [&](const usize task) {
+                for (usize s{task == 0 ? 0 : tasks[task - 1]}; s < tasks[task]; ++s) {
+                    const auto& slice = slices[s];
+                    const auto& arch = world->archetypes[cache->archetypes[slice.table]].archetype;
+                    const usize* rows = cache->rows.data() + slice.table * sizeof...(Ts);
+                    for_each_enabled_run(arch, rows, slice.begin, slice.len, [&](const usize run_begin, const usize run_len, const u64 disabled) {
+                        run_slice(func, arch, rows, run_begin, run_len, disabled, std::index_sequence_for<Ts...>{});
+                    });
+                }
+            });
         }
 
       private:
-        auto get_component_ptr(const usize type_id, const ArchetypeId arch_id, const Archetype& arch) -> void* {
-            const auto& arch_map = world->component_map.at(type_id);
-            if (const auto it = arch_map.find(arch_id); it != arch_map.end()) {
-                return arch.get_raw(0, it->second.row);
+        template<typename T>
+        static consteval auto term_index() -> usize {
+            constexpr std::array<bool, sizeof...(Ts)> same{std::same_as<std::remove_const_t<T>, std::remove_const_t<Ts>>...};
+            for (usize i{0}; i < sizeof...(Ts); ++i) {
+                if (same[i]) {
+                    return i;
+                }
+            }
+            return sizeof...(Ts);
+        }
+
+        /// Marks the components of all non-const terms in `[begin, begin + len)` as changed, except for the disabled terms.
+        static auto mark_written(Archetype& arch, const usize* rows, const usize begin, const usize len, const u64 disabled) -> void {
+            constexpr std::array<bool, sizeof...(Ts)> mutable_terms{(!std::is_const_v<Ts> and !TagComponent<Ts>)...};
+            for (usize term{0}; term < sizeof...(Ts); ++term) {
+                if (mutable_terms[term] and rows[term] != QueryCache::absent_row and (disabled >> term & 1) == 0 and len > 0) {
+                    arch.mark_written(begin, len, rows[term]);
+                }
+            }
+        }
+
+        template<typename Func>
+        auto run_filtered(Func& func) -> void {
+            const u32 since{last_run_tick};
+            for (usize i{0}; i < cache->archetypes.size(); ++i) {
+                auto& arch = world->archetypes[cache->archetypes[i]].archetype;
+                const usize* rows = cache->rows.data() + i * sizeof...(Ts);
+                if (std::ranges::any_of(filters, [&](const Filter& f) { return rows[f.term] == QueryCache::absent_row; })) {
+                    continue;
+                }
+
+                auto emit = [&](const usize begin, const usize len) {
+                    for_each_enabled_run(arch, rows, begin, len, [&](const usize run_begin, const usize run_len, const u64 disabled) {
+                        mark_written(arch, rows, run_begin, run_len, disabled);
+                        run_slice(func, arch, rows, run_begin, run_len, disabled, std::index_sequence_for<Ts...>{});
+                    });
+                };
+
+                const usize len{arch.len()};
+                const usize block_len{arch.tick_block_len()};
+                for (usize block{0}, block_begin{0}; block_begin < len; ++block, block_begin += block_len) {
+                    const usize block_end{std::min(block_begin + block_len, len)};
+
+                    bool whole_block{true};
+                    bool skip{false};
+                    for (const auto& f : filters) {
+                        if (f.kind == ChangeFilterKind::added) {
+                            skip = skip or arch.block_added_tick(block, rows[f.term]) <= since;
+                            whole_block = false;
+                        } else {
+                            skip = skip or arch.block_changed_tick(block, rows[f.term]) <= since;
+                            whole_block = whole_block and arch.block_written_tick(block, rows[f.term]) > since;
+                        }
+                    }
+                    if (skip) {
+                        continue;
+                    }
+                    if (whole_block) {
+                        emit(block_begin, block_end - block_begin);
+                        continue;
+                    }
+
+                    usize run_begin{block_begin};
+                    for (usize col{block_begin}; col < block_end; ++col) {
+                        const bool matches = std::ranges::all_of(filters, [&](const Filter& f) {
+                            return (f.kind == ChangeFilterKind::added ? arch.added_tick(col, rows[f.term]) : arch.changed_tick(col, rows[f.term])) > since;
+                        });
+                        if (!matches) {
+                            if (col > run_begin) {
+                                emit(run_begin, col - run_begin);
+                            }
+                            run_begin = col + 1;
+                        }
+                    }
+                    if (block_end > run_begin) {
+                        emit(run_begin, block_end - run_begin);
+                    }
+                }
+            }
+
+            // Changes made during this run, including the ones made through the query itself, are stamped with the
+            // tick of this run and are therefore not reported to it again.
+            last_run_tick = world->change_tick++;
+        }
+
+        /// Calls `func` once for every matched entity, joining the sparse components of the entity.
+        template<typename Func>
+        auto run_sparse(Func& func) -> void {
+            std::array<SparseSet*, sizeof...(Ts)> sets{};
+            SparseSet* driver{nullptr};
+            for (usize term{0}; term < sizeof...(Ts); ++term) {
+                if (sparse_terms[term]) {
+                    sets[term] = world->sparse_sets[cache->terms[term].index].get();
+                    if (!optional_flags[term] and (driver == nullptr or sets[term]->len() < driver->len())) {
+                        driver = sets[term];
+                    }
+                }
+            }
+
+            const u32 since{last_run_tick};
+            auto visit = [&](Archetype& arch, const usize* rows, const usize col, const EntityId entity) {
+                for (const auto& f : filters) {
+                    if (rows[f.term] == QueryCache::absent_row or (f.kind == ChangeFilterKind::added ? arch.added_tick(col, rows[f.term]) : arch.changed_tick(col, rows[f.term])) <= since) {
+                        return;
+                    }
+                }
+
+                u64 disabled{0};
+                for (usize term{0}; term < sizeof...(Ts); ++term) {
+                    if (enableable_terms[term] and rows[term] != QueryCache::absent_row and !arch.is_enabled(col, rows[term])) {
+                        if (!optional_flags[term]) {
+                            return;
+                        }
+                        disabled |= u64{1} << term;
+                    }
+                }
+
+                std::array<usize, sizeof...(Ts)> sparse_cols{};
+                for (usize term{0}; term < sizeof...(Ts); ++term) {
+                    if (sparse_terms[term]) {
+                        sparse_cols[term] = sets[term]->find(entity);
+                        if (sparse_cols[term] == Archetype::no_row and !optional_flags[term]) {
+                            return;
+                        }
+                    }
+                }
+
+                constexpr std::array<bool, sizeof...(Ts)> mutable_terms{(!std::is_const_v<Ts> and !TagComponent<Ts>)...};
+                constexpr std::array<void*, sizeof...(Ts)> tags{tag_pointer<Ts>()...};
+                std::array<void*, sizeof...(Ts)> ptrs{};
+                for (usize term{0}; term < sizeof...(Ts); ++term) {
+                    if (sparse_terms[term] and sparse_cols[term] != Archetype::no_row) {
+                        ptrs[term] = sets[term]->get_raw(sparse_cols[term]);
+                        if (mutable_terms[term]) {
+                            sets[term]->mark_changed(sparse_cols[term]);
+                        }
+                    } else if (!sparse_terms[term] and rows[term] != QueryCache::absent_row and (disabled >> term & 1) == 0) {
+                        ptrs[term] = tags[term] != nullptr ? tags[term] : arch.get_raw(col, rows[term]);
+                        if (mutable_terms[term]) {
+                            arch.mark_changed(col, rows[term]);
+                        }
+                    }
+                }
+
+                [&]<usize... Is>(std::index_sequence<Is...> /*unused*/) {
+                    func(usize{1}, static_cast<Ts*>(ptrs[Is])...);
+                }(std::index_sequence_for<Ts...>{});
+            };
+
+            if (driver != nullptr) {
+                const auto entities = driver->entities();
+                std::array<usize, sizeof...(Ts)> rows{};
+                for (const auto entity : entities) {
+                    const auto& record = world->entity_records[entity_index(entity)];
+                    auto& arch_rec = world->archetypes[record.archetype];
+                    if (!arch_rec.mask.contains(cache->required)) {
+                        continue;
+                    }
+                    for (usize term{0}; term < sizeof...(Ts); ++term) {
+                        rows[term] = arch_rec.archetype.row_of(cache->terms[term].index);
+                    }
+                    visit(arch_rec.archetype, rows.data(), record.col, entity);
+                }
+            } else {
+                for (usize i{0}; i < cache->archetypes.size(); ++i) {
+                    auto& arch_rec = world->archetypes[cache->archetypes[i]];
+                    const usize* rows = cache->rows.data() + i * sizeof...(Ts);
+                    for (usize col{0}; col < arch_rec.archetype.len(); ++col) {
+                        visit(arch_rec.archetype, rows, col, arch_rec.entities[col]);
+                    }
+                }
+            }
+
+            if (!filters.empty()) {
+                last_run_tick = world->change_tick++;
+            }
+        }
+
+        /// Gets the shared instance of a tag term, `nullptr` for terms with storage.
+        template<Component T>
+        static constexpr auto tag_pointer() -> void* {
+            if constexpr (TagComponent<T>) {
+                return &tag_instance<std::remove_const_t<T>>;
+            } else {
+                return nullptr;
+            }
+        }
+
+        /**
+         * @brief Calls `emit(begin, len, disabled)` for every run in `[begin, begin + len)` in which all required enableable terms are enabled.
+         *
+         * The enabled bits of the required terms are combined a word at a time and the runs are found with bit scans.
+         * Bit i of `disabled` is set if the optional term i is disabled in the whole run. Calls `emit` once for the
+         * whole range if no term is enableable.
+         */
+        template<typename Emit>
+        auto for_each_enabled_run(const Archetype& arch, const usize* rows, const usize begin, const usize len, Emit&& emit) const -> void {
+            if constexpr (!has_enableable_terms) {
+                emit(begin, len, u64{0});
+            } else {
+                constexpr usize word_bits{64};
+                std::array<std::span<const u64>, sizeof...(Ts)> required{};
+                usize required_count{0};
+                std::array<usize, sizeof...(Ts)> optional_terms{};
+                usize optional_count{0};
+                for (usize term{0}; term < sizeof...(Ts); ++term) {
+                    if (enableable_terms[term] and rows[term] != QueryCache::absent_row) {
+                        if (optional_flags[term]) {
+                            optional_terms[optional_count++] = term;
+                        } else {
+                            required[required_count++] = arch.enabled_words(rows[term]);
+                        }
+                    }
+                }
+
+                auto disabled_optionals = [&](const usize col) {
+                    u64 disabled{0};
+                    for (usize k{0}; k < optional_count; ++k) {
+                        disabled |= static_cast<u64>(!arch.is_enabled(col, rows[optional_terms[k]])) << optional_terms[k];
+                    }
+                    return disabled;
+                };
+
+                // Optional enableable terms are rare, their runs are split column by column
+                auto emit_split = [&](const usize run_begin, const usize run_len) {
+                    if (optional_count == 0) {
+                        emit(run_begin, run_len, u64{0});
+                        return;
+                    }
+                    usize split_begin{run_begin};
+                    u64 disabled{disabled_optionals(run_begin)};
+                    for (usize col{run_begin + 1}; col < run_begin + run_len; ++col) {
+                        if (const u64 next{disabled_optionals(col)}; next != disabled) {
+                            emit(split_begin, col - split_begin, disabled);
+                            split_begin = col;
+                            disabled = next;
+                        }
+                    }
+                    emit(split_begin, run_begin + run_len - split_begin, disabled);
+                };
+
+                if (required_count == 0) {
+                    if (len > 0) {
+                        emit_split(begin, len);
+                    }
+                    return;
+                }
+
+                const usize end{begin + len};
+                usize pending_begin{0};
+                usize pending_len{0};
+                for (usize word_index{begin / word_bits}; word_index * word_bits < end; ++word_index) {
+                    const usize base{word_index * word_bits};
+                    u64 word{~u64{0}};
+                    for (usize r{0}; r < required_count; ++r) {
+                        word &= required[r][word_index];
+                    }
+                    if (base < begin) {
+                        word &= ~u64{0} << (begin - base);
+                    }
+                    if (end - base < word_bits) {
+                        word &= (u64{1} << (end - base)) - 1;
+                    }
+
+                    while (word != 0) {
+                        const auto first = static_cast<usize>(std::countr_zero(word));
+                        const auto ones = static_cast<usize>(std::countr_one(word >> first));
+                        if (pending_len > 0 and pending_begin + pending_len == base + first) {
+                            pending_len += ones;
+                        } else {
+                            if (pending_len > 0) {
+                                emit_split(pending_begin, pending_len);
+                            }
+                            pending_begin = base + first;
+                            pending_len = ones;
+                        }
+                        word = first + ones == word_bits ? 0 : word & (~u64{0} << (first + ones));
+                    }
+                }
+                if (pending_len > 0) {
+                    emit_split(pending_begin, pending_len);
+                }
             }
-            return nullptr;
+        }
+
+        template<typename Func, usize... Is>
+        static auto run_slice(Func& func, const Archetype& arch, const usize* rows, const usize begin, const usize len, const u64 disabled, std::index_sequence<Is...> /*unused*/) -> void {
+            func(len, [&]() -> Ts* {
+                if (rows[Is] == QueryCache::absent_row or (disabled >> Is & 1) != 0) {
+                    return nullptr;
+                }
+                if constexpr (TagComponent<Ts>) {
+                    return &tag_instance<std::remove_const_t<Ts>>;
+                } else {
+                    return static_cast<Ts*>(arch.get_raw(begin, rows[Is]));
+                }
+            }()...);
         }
 
         auto build() -> void {
-            std::array<CompTypeInfo, sizeof...(Ts)> pack_infos = {get_component_info<Ts>()...};
+            const std::array<CompTypeInfo, sizeof...(Ts)> pack_infos = {world->component_info<Ts>()...};
+            u64 optional_mask{0};
             for (usize i{0}; i < sizeof...(Ts); ++i) {
-                if (optional_flags[i]) {
-                    optional_comps.push_back(pack_infos[i]);
-                } else {
-                    required_comps.push_back(pack_infos[i]);
+                // Sparse components are never part of an archetype and are joined in `run_sparse`
+                if (optional_flags[i] or sparse_terms[i]) {
+                    optional_mask |= u64{1} << i;
                 }
             }
 
-            for (const auto& [arch_id, val] : world->archetype_map) {
-                if (const auto& arch = val.archetype; arch.partial_match(required_comps)) {
-                    typename Query<Ts...>::table_match table = {arch.len(), static_cast<Ts*>(get_component_ptr(type_id<Ts>(), arch_id, arch))...};
-                    push_args(table);
-                }
+            cache = &world->find_or_create_query(pack_infos, optional_mask);
+        }
+    };
+
+    /**
+     * @brief A handle to an entity that remembers where the entity is stored.
+     *
+     * `World::get` and `World::has` check the generation of the entity and look up its archetype and column on every
+     * call. An EntityRef does that once and then answers from its cached archetype and column. Every change that can
+     * move an entity or an archetype, like despawns, adding and removing components or new archetypes, advances the
+     * structural epoch of the world. An EntityRef whose epoch is behind looks the entity up again on its next use, so
+     * it stays correct after any change, and throws once its entity was despawned.
+     * The world has to outlive its EntityRefs.
+     *
+     * \code{.cpp}
+     * auto target = world.entity_ref(entity);
+     * if (target.has<Health>()) {
+     *     auto [health, armor] = target.get<Health, const Armor>();
+     *     health.value -= 10 - armor.value;
+     * }
+     * \endcode
+     */
+    class EntityRef {
+        friend class World;
+
+        World* world;
+        EntityId entity;
+        Archetype* arch{nullptr};
+        usize col{0};
+        u64 epoch{0}; ///< The structural epoch of the world when the location was cached.
+
+        /**
+         * @brief Constructs a reference and caches the location of the entity.
+         * @param world The world of the entity.
+         * @param entity The ID of the entity.
+         * @throws std::out_of_range if the entity does not exist.
+         */
+        EntityRef(World* world, const EntityId entity) : world(world), entity(entity) { locate(); }
+
+        /**
+         * @brief Caches the current location of the entity.
+         * @throws std::out_of_range if the entity does not exist.
+         */
+        auto locate() -> void {
+            const auto& record = world->entity_record(entity);
+            arch = &world->archetypes[record.archetype].archetype;
+            col = record.col;
+            epoch = world->structural_epoch;
+        }
+
+        /**
+         * @brief Gets the archetype of the entity, looking the entity up again if the world changed its structure.
+         * @return The archetype of the entity.
+         * @throws std::out_of_range if the entity was despawned.
+         */
+        auto archetype() -> Archetype& {
+            if (epoch != world->structural_epoch) [[unlikely]] {
+                locate();
+            }
+            return *arch;
+        }
+
+      public:
+        /**
+         * @brief Gets the ID of the referenced entity.
+         * @return The ID of the entity.
+         */
+        [[nodiscard]] auto id() const noexcept -> EntityId { return entity; }
+
+        /**
+         * @brief Checks if the referenced entity is still alive.
+         * @return true if the entity exists in the world, false otherwise.
+         */
+        [[nodiscard]] auto is_alive() const noexcept -> bool { return world->is_alive(entity); }
+
+        /**
+         * @brief Gets components of the entity like `World::get`.
+         * @tparam Ts The types of the components to get.
+         * @return A reference or tuple of references to the requested components.
+         * @throws std::out_of_range if the entity was despawned or does not have one of the components.
+         */
+        template<Component... Ts>
+        [[nodiscard]] auto get() -> decltype(auto) {
+            static_assert(!pack_has_duplicates<Ts...>());
+            auto& entity_arch = archetype();
+            std::tuple<Ts&...> tup{world->component_ref<Ts>(entity, entity_arch, col)...};
+
+            if constexpr (sizeof...(Ts) == 1) {
+                return std::get<0>(tup);
+            } else {
+                return tup;
             }
         }
 
-        auto push_args(table_match table) -> void {
-            table_args.emplace_back(table);
+        /**
+         * @brief Checks if the entity has the components like `World::has`.
+         * @tparam Ts The types of components to check for.
+         * @return true if the entity has all the specified components, false otherwise.
+         * @throws std::out_of_range if the entity was despawned.
+         */
+        template<Component... Ts>
+        [[nodiscard]] auto has() -> bool {
+            static_assert(!pack_has_duplicates<Ts...>());
+            const auto& entity_arch = archetype();
+            return (... and [&] {
+                if constexpr (SparseComponent<Ts>) {
+                    return world->sparse_set<Ts>().contains(entity);
+                } else {
+                    return entity_arch.row_of(world->component_index<Ts>()) != Archetype::no_row;
+                }
+            }());
         }
     };
 
@@ -161,6 +847,26 @@ class World {
      */
     World() = default;
 
+    /**
+     * @brief Constructs a World whose archetypes use the given storage configuration.
+     *
+     * The memory resource of the configuration is used for everything that grows with the number of entities:
+     * the components with their ticks and enabled bits, the entity lists of the archetypes and the entity records.
+     * The bookkeeping of archetypes and queries uses the default allocator.
+     *
+     * @param config The storage configuration of every archetype.
+     *
+     * \code{.cpp}
+     * // Store components in 16 KiB chunks that never move when a table grows
+     * World world(StorageConfig{.storage = ArchetypeStorage::chunked});
+     *
+     * // Keep the memory of a world in a pool that is capped at 64 MiB
+     * ColumnPoolResource pool(64 * 1024 * 1024);
+     * World pooled(StorageConfig{.resource = &pool});
+     * \endcode
+     */
+    explicit World(const StorageConfig& config) : entity_records(config.resource), free_entities(config.resource), storage_config(config) {}
+
     /**
      * @brief Destructor for World.
      */
@@ -186,6 +892,15 @@ class World {
      */
     auto operator=(World&&) = delete;
 
+    /**
+     * @brief Attaches a thread pool that is used by `Query::run_parallel`.
+     *
+     * The world does not take ownership of the pool, which has to outlive every parallel run.
+     *
+     * @param pool The thread pool, or `nullptr` to run all queries serially.
+     */
+    auto set_thread_pool(ThreadPool* pool) noexcept -> void { thread_pool = pool; }
+
     /**
      * @brief Despawns an entity from the world.
      *
@@ -230,19 +945,166 @@ class World {
     template<Component... Ts>
     auto spawn(Ts&&... pack) -> EntityId {
         static_assert(!pack_has_duplicates<Ts...>());
-        CompTypeList comp_ts = {get_component_info<Ts>()...};
-        sort_component_list(comp_ts);
+        if constexpr (table_component_count<Ts...> < sizeof...(Ts)) {
+            // The table components are moved out of the empty archetype, which has nothing to move
+            const auto new_entity_id = spawn();
+            add(new_entity_id, std::forward<Ts>(pack)...);
+            return new_entity_id;
+        }
 
-        auto& arch_rec = find_or_create_archetype(comp_ts);
-        const auto col = arch_rec.archetype.emplace_back(std::forward<Ts>(pack)...);
+        auto& arch_rec = spawn_archetype<Ts...>();
+        before_table_change(arch_rec.id);
+        const auto col = arch_rec.archetype.emplace_back_rows(pack_rows<Ts...>(arch_rec.archetype), std::forward<Ts>(pack)...);
 
-        const auto new_entity_id = next_entity_id++;
+        const auto new_entity_id = allocate_entity(arch_rec.id, col);
         arch_rec.entities.push_back(new_entity_id);
-        entity_map.insert({new_entity_id, EntityRecord{.archetype = arch_rec.id, .col = col}});
 
         return new_entity_id;
     }
 
+    /**
+     * @brief Spawns `count` entities that all get a copy of the given components.
+     *
+     * The archetype is resolved and grown once for the whole batch and the components are
+     * constructed column by column.
+     *
+     * @tparam Ts The types of the components.
+     * @param count The number of entities to spawn.
+     * @param values The components every new entity is given a copy of.
+     * @return The IDs of the newly spawned entities.
+     *
+     * \code{.cpp}
+     * World world;
+     * // Spawn 1000 entities at the origin
+     * std::vector<EntityId> entities = world.spawn_n(1000, Position{.x = 0, .y = 0}, Velocity{.x = 1, .y = 0});
+     * \endcode
+     */
+    template<Component... Ts>
+        requires(std::copy_constructible<Ts> and ...)
+    auto spawn_n(const usize count, const Ts&... values) -> std::vector<EntityId> {
+        static_assert(!pack_has_duplicates<Ts...>());
+        auto& arch_rec = prepare_batch<Ts...>(count);
+        auto& arch = arch_rec.archetype;
+        const usize first{arch.len()};
+
+        arch.for_each_run(first, count, [&](const usize col, const usize len) {
+            (..., [&] {
+                if constexpr (!TagComponent<Ts>) {
+                    std::uninitialized_fill_n(static_cast<Ts*>(arch.get_raw(col, arch.row_of(component_index<Ts>()))), len, values);
+                }
+            }());
+        });
+
+        return finish_batch(arch_rec, count);
+    }
+
+    /**
+     * @brief Spawns one entity per element of the given spans, copying the components from them.
+     *
+     * All spans need to have the same length. Trivially copyable components are copied with a single `memcpy` per type.
+     *
+     * @tparam Ts The types of the components.
+     * @param data One span of components per type.
+     * @return The IDs of the newly spawned entities.
+     *
+     * \code{.cpp}
+     * std::vector<Position> positions = load_positions();
+     * std::vector<Velocity> velocities = load_velocities();
+     *
+     * World world;
+     * std::vector<EntityId> entities = world.spawn_batch<Position, Velocity>(positions, velocities);
+     * \endcode
+     */
+    template<Component... Ts>
+        requires(std::copy_constructible<Ts> and ...)
+    auto spawn_batch(std::span<const Ts>... data) -> std::vector<EntityId> {
+        static_assert(!pack_has_duplicates<Ts...>());
+        static_assert(sizeof...(Ts) > 0);
+        const usize count{std::get<0>(std::tie(data...)).size()};
+        NIDAVELLIR_ASSERT(((data.size() == count) and ...), "All spans of a batch need to have the same length");
+
+        auto& arch_rec = prepare_batch<Ts...>(count);
+        auto& arch = arch_rec.archetype;
+        const usize first{arch.len()};
+
+        arch.for_each_run(first, count, [&](const usize col, const usize len) {
+            (..., [&] {
+                if constexpr (!TagComponent<Ts>) {
+                    std::uninitialized_copy_n(data.data() + (col - first), len, static_cast<Ts*>(arch.get_raw(col, arch.row_of(component_index<Ts>()))));
+                }
+            }());
+        });
+
+        return finish_batch(arch_rec, count);
+    }
+
+    /**
+     * @brief Spawns `count` entities with components created by a generator.
+     *
+     * The generator is called with the index of each entity in the batch and returns a `std::tuple<Ts...>`
+     * whose elements are moved into the new entity.
+     *
+     * @tparam Ts The types of the components.
+     * @tparam Gen The type of the generator.
+     * @param count The number of entities to spawn.
+     * @param generator The generator creating the components of each entity.
+     * @return The IDs of the newly spawned entities.
+     *
+     * \code{.cpp}
+     * World world;
+     * std::vector<EntityId> entities = world.spawn_batch<Position, Velocity>(1000, [](usize i) {
+     *     return std::tuple{Position{.x = static_cast<float>(i), .y = 0}, Velocity{.x = 0, .y = 1}};
+     * });
+     * \endcode
+     */
+    template<Component... Ts, typename Gen>
+        requires std::same_as<std::invoke_result_t<Gen&, usize>, std::tuple<Ts...>>
+    auto spawn_batch(const usize count, Gen&& generator) -> std::vector<EntityId> {
+        static_assert(!pack_has_duplicates<Ts...>());
+        auto& arch_rec = prepare_batch<Ts...>(count);
+        auto& arch = arch_rec.archetype;
+        const usize first{arch.len()};
+
+        const std::array<usize, sizeof...(Ts)> rows = {(TagComponent<Ts> ? 0 : arch.row_of(component_index<Ts>()))...};
+        arch.for_each_run(first, count, [&](const usize col, const usize len) {
+            const auto columns = [&]<usize... Is>(std::index_sequence<Is...> /*unused*/) {
+                return std::array<void*, sizeof...(Ts)>{(TagComponent<Ts> ? nullptr : arch.get_raw(col, rows[Is]))...};
+            }(std::index_sequence_for<Ts...>{});
+            for (usize i{0}; i < len; ++i) {
+                [&]<usize... Is>(std::tuple<Ts...>&& tup, std::index_sequence<Is...> /*unused*/) {
+                    (..., [&] {
+                        if constexpr (!TagComponent<Ts>) {
+                            new (static_cast<Ts*>(columns[Is]) + i) Ts(std::get<Is>(std::move(tup)));
+                        }
+                    }());
+                }(generator(col - first + i), std::index_sequence_for<Ts...>{});
+            }
+        });
+
+        return finish_batch(arch_rec, count);
+    }
+
+    /**
+     * @brief Checks if an entity handle refers to a living entity.
+     *
+     * Handles of despawned entities are never alive again, even after their slot has been recycled.
+     *
+     * @param entity The ID of the entity.
+     * @return true if the entity exists in the world, false otherwise.
+     */
+    [[nodiscard]] auto is_alive(const EntityId entity) const noexcept -> bool {
+        const auto index = entity_index(entity);
+        return index < entity_records.size() and entity_records[index].generation == entity_generation(entity);
+    }
+
+    /**
+     * @brief Gets a reference to an entity that caches its location for repeated `get` and `has` calls.
+     * @param entity The ID of the entity.
+     * @return The reference to the entity.
+     * @throws std::out_of_range if the entity does not exist.
+     */
+    [[nodiscard]] auto entity_ref(const EntityId entity) -> EntityRef { return EntityRef(this, entity); }
+
     /**
      * @brief Gets the components of the specified types for a given entity.
      *
@@ -250,6 +1112,7 @@ class World {
      * If only one component type is requested, a single reference is returned.
      * If multiple component types are requested, a tuple of references is returned.
      * Throws a `std::out_of_range` exception if the entity does not exist or if the specified components are not present on the entity.
+     * Components requested as non-const are marked as changed, request `const T` to only read them.
      *
      * @tparam Ts The types of the components to get.
      * @param entity The ID of the entity.
@@ -272,11 +1135,11 @@ class World {
     template<Component... Ts>
     [[nodiscard]] auto get(const EntityId entity) -> decltype(auto) {
         static_assert(!pack_has_duplicates<Ts...>());
-        const auto [arch_id, col] = entity_map.at(entity);
-        auto& [arch, _1, _2] = archetype_map.at(arch_id);
+        const auto& record = entity_record(entity);
+        auto& arch = archetypes[record.archetype].archetype;
 
-        auto tup = std::tie(arch.get_component<Ts>(col)...);
-        static_assert(std::same_as<decltype(tup), std::tuple<Ts&...>>);
+        // Braced initialization resolves the components in pack order
+        std::tuple<Ts&...> tup{component_ref<Ts>(entity, arch, record.col)...};
 
         if constexpr (sizeof...(Ts) == 1) {
             return std::get<0>(tup);
@@ -285,6 +1148,69 @@ class World {
         }
     }
 
+    /**
+     * @brief Gets the components of the specified types for a list of entities.
+     *
+     * Works like calling `get` for every entity, but the records of the entities are prefetched a few entities ahead
+     * and the rows are only looked up again when the archetype changes between consecutive entities. The cache lines
+     * of the components are prefetched as their addresses are resolved, so a caller that reads the output in batches
+     * of a few hundred entities finds them in the cache. Sparse components are found in their sparse sets without
+     * prefetching.
+     * Throws a `std::out_of_range` exception if an entity does not exist or does not have one of the components, the
+     * pointers of the entities before it are written.
+     * Components requested as non-const are marked as changed, request `const T` to only read them.
+     *
+     * @tparam Ts The types of the components to get.
+     * @param entities The IDs of the entities.
+     * @param out The pointers to the components of every entity, at least as long as `entities`.
+     *
+     * \code{.cpp}
+     * std::vector<ComponentPointers<const Position>> targets(ids.size());
+     * world.get_many<const Position>(ids, targets);
+     *
+     * std::vector<ComponentPointers<Health, const Armor>> hits(ids.size());
+     * world.get_many<Health, const Armor>(ids, hits);
+     * for (const auto [health, armor] : hits) {
+     *     health->value -= 10 - armor->value;
+     * }
+     * \endcode
+     */
+    template<Component... Ts>
+    auto get_many(const std::span<const EntityId> entities, const std::span<ComponentPointers<Ts...>> out) -> void {
+        static_assert(!pack_has_duplicates<Ts...>());
+        NIDAVELLIR_ASSERT(out.size() >= entities.size(), "Every entity needs a slot in the output");
+
+        // Far enough ahead to hide a miss on the record behind the work for the entities in between
+        constexpr usize record_distance{16};
+        ArchetypeId cached{no_archetype};
+        Archetype* arch{nullptr};
+        std::array<usize, sizeof...(Ts)> rows{};
+        for (usize i{0}; i < entities.size(); ++i) {
+            if (i + record_distance < entities.size()) {
+                if (const u32 index{entity_index(entities[i + record_distance])}; index < entity_records.size()) {
+                    prefetch(&entity_records[index]);
+                }
+            }
+
+            const EntityId entity{entities[i]};
+            const auto& record = entity_record(entity);
+            if (record.archetype != cached) {
+                arch = &archetypes[record.archetype].archetype;
+                rows = {(SparseComponent<Ts> ? Archetype::no_row : component_row<Ts>(*arch))...};
+                cached = record.archetype;
+            }
+
+            [&]<usize... Is>(std::index_sequence<Is...>) {
+                std::tuple<Ts*...> ptrs{component_ptr<Ts>(entity, *arch, record.col, rows[Is])...};
+                if constexpr (sizeof...(Ts) == 1) {
+                    out[i] = std::get<0>(ptrs);
+                } else {
+                    out[i] = ptrs;
+                }
+            }(std::index_sequence_for<Ts...>{});
+        }
+    }
+
     /**
      * @brief Checks if the specified entity has the components.
      *
@@ -298,11 +1224,14 @@ class World {
     template<Component... Ts>
     [[nodiscard]] auto has(const EntityId entity) -> bool {
         static_assert(!pack_has_duplicates<Ts...>());
-        const auto [arch_id, col] = entity_map.at(entity);
-        const auto& [arch, _1, _2] = archetype_map.at(arch_id);
-
-        std::array<CompTypeInfo, sizeof...(Ts)> pack_infos = {get_component_info<Ts>()...};
-        return arch.partial_match(pack_infos);
+        const auto& mask = archetypes[entity_record(entity).archetype].mask;
+        return (... and [&] {
+            if constexpr (SparseComponent<Ts>) {
+                return sparse_set<Ts>().contains(entity);
+            } else {
+                return mask.test(component_index<Ts>());
+            }
+        }());
     }
 
     /**
@@ -310,6 +1239,7 @@ class World {
      *
      * This function adds the specified components to the given entity.
      * If the entity already has a component of one of the supplied types, the existing component will be overwritten with the new one provided in the pack.
+     * Sparse components are stored outside of the archetype tables, so adding only sparse components never moves the entity.
      * Throws a `std::out_of_range` exception if the entity does not exist.
      *
      * @tparam Ts The types of the components to add.
@@ -341,77 +1271,26 @@ class World {
     auto add(const EntityId entity, Ts&&... pack) -> void {
         static_assert(!pack_has_duplicates<Ts...>());
         static_assert(sizeof...(Ts) > 0);
-        NIDAVELLIR_ASSERT(scratch_component_buffer.size() == 0, "The scratch buffer has not been cleared");
-
-        auto& [src_id, src_col] = entity_map.at(entity);
-        const auto& entity_types = archetype_map.at(src_id).archetype.type();
 
-        constexpr usize stack_buffer_size = sizeof(CompTypeInfo) * 64;
-        std::array<u8, stack_buffer_size> buffer{};
-        std::pmr::monotonic_buffer_resource resource(buffer.data(), stack_buffer_size);
-        std::pmr::vector<CompTypeInfo> in_pack_types{&resource};
-        std::pmr::vector<CompTypeInfo> not_in_pack_types{&resource};
+        auto& record = entity_record(entity);
+        bool moved{false};
+        if constexpr (table_component_count<Ts...> > 0) {
+            if (const auto& edge = find_or_create_add_edge<Ts...>(record.archetype); edge.target != record.archetype) {
+                move_entity(entity, record, edge);
+                moved = true;
+            }
+        }
 
-        std::array<CompTypeInfo, sizeof...(Ts)> pack_infos = {get_component_info<Ts>()...};
-        auto in_pack = [&](const CompTypeInfo& info1) {
-            return std::ranges::find_if(pack_infos, [info1](const CompTypeInfo& info2) { return info1.id == info2.id; }) != pack_infos.end();
-        };
-
-        for (const auto& info : entity_types) {
-            if (in_pack(info)) {
-                in_pack_types.push_back(info);
+        auto& arch = archetypes[record.archetype].archetype;
+        (..., [&] {
+            if constexpr (SparseComponent<Ts>) {
+                insert_sparse(entity, std::forward<Ts>(pack));
+            } else if (const std::array<usize, 1> rows{arch.row_of(component_index<Ts>())}; moved) {
+                arch.create_rows(record.col, rows, std::forward<Ts>(pack));
             } else {
-                not_in_pack_types.push_back(info);
-            }
-        }
-
-        scratch_component_buffer.reserve(sizeof...(Ts) + not_in_pack_types.size());
-        std::ranges::copy(pack_infos, std::back_inserter(scratch_component_buffer));
-        std::ranges::copy(not_in_pack_types, std::back_inserter(scratch_component_buffer));
-        sort_component_list(scratch_component_buffer);
-
-        auto& [target_arch, target_entities, target_id] = find_or_create_archetype(scratch_component_buffer);
-        auto& [src_arch, src_entities, _] = archetype_map.at(src_id);
-
-        if (src_id == target_id) {
-            src_arch.update(src_col, std::forward<Ts>(pack)...);
-        } else {
-            target_arch.prepare_push(1);
-            const usize target_col{target_arch.len()};
-
-            for (const auto& info : not_in_pack_types) {
-                void* src_ptr = src_arch.get_raw(src_col, src_arch.get_row(info.id));
-                void* dst_ptr = target_arch.get_raw(target_col, target_arch.get_row(info.id));
-
-                info.move_ctor_dtor(dst_ptr, src_ptr, 1);
+                arch.update_rows(record.col, rows, std::forward<Ts>(pack));
             }
-
-            for (const auto& info : in_pack_types) {
-                void* src_ptr = src_arch.get_raw(src_col, src_arch.get_row(info.id));
-
-                info.dtor(src_ptr, 1);
-            }
-
-            target_arch.create(target_col, std::forward<Ts>(pack)...);
-
-            target_entities.push_back(entity);
-            target_arch.increase_size(1);
-
-            const usize src_last_col{src_arch.len() - 1};
-            if (src_col < src_last_col) {
-                src_arch.swap(src_col, src_last_col);
-                std::swap(src_entities[src_col], src_entities[src_last_col]);
-                entity_map.at(src_entities[src_col]).col = src_col;
-            }
-
-            src_entities.pop_back();
-            src_arch.decrease_size(1);
-
-            src_id = target_id;
-            src_col = target_col;
-        }
-
-        scratch_component_buffer.clear();
+        }());
     }
 
     /**
@@ -420,6 +1299,7 @@ class World {
      * This function removes the specified components from the given entity.
      * Throws a `std::out_of_range` exception if the entity does not exist.
      * If the entity does not have all of the specified components, this function will cause undefined behavior.
+     * Removing only sparse components never moves the entity.
      *
      * @tparam Ts The types of the components to remove.
      * @param entity The ID of the entity.
@@ -440,90 +1320,792 @@ class World {
     auto remove(const EntityId entity) -> void {
         static_assert(!pack_has_duplicates<Ts...>());
         static_assert(sizeof...(Ts) > 0);
-        NIDAVELLIR_ASSERT(scratch_component_buffer.empty(), "The scratch buffer has not been cleared");
 
-        auto& [src_id, src_col] = entity_map.at(entity);
-        const auto& entity_types = archetype_map.at(src_id).archetype.type();
+        auto& record = entity_record(entity);
+        if constexpr (table_component_count<Ts...> > 0) {
+            const auto& edge = find_or_create_remove_edge<Ts...>(record.archetype);
+            NIDAVELLIR_ASSERT(edge.target != record.archetype, "When removing components there should be no way of ending up in the same archetype again");
+            move_entity(entity, record, edge);
+        }
 
-        std::array<CompTypeInfo, sizeof...(Ts)> pack_infos = {get_component_info<Ts>()...};
-        auto not_in_pack = [&](const CompTypeInfo& info1) {
-            return std::ranges::find_if(pack_infos, [info1](const CompTypeInfo& info2) { return info1.id == info2.id; }) == pack_infos.end();
-        };
+        (..., [&] {
+            if constexpr (SparseComponent<Ts>) {
+                erase_sparse(component_index<Ts>(), entity);
+            }
+        }());
+    }
 
-        scratch_component_buffer.reserve(sizeof...(Ts));
+    /**
+     * @brief Adds a copy of the specified components to every entity matched by a query.
+     *
+     * Works table by table instead of entity by entity: every matched table is moved into the target archetype with
+     * one `move_ctor_dtor` per component type and contiguous run, and the entity records are patched in one pass.
+     * If the target archetype is empty, it takes over the buffers of the moved components. Tables that already have
+     * all components are overwritten in place. Existing components are overwritten, like with `add`.
+     *
+     * The query selects whole tables, so change filters and disabled components are not considered and the query
+     * can not have sparse components.
+     *
+     * @tparam Qs The queried component types.
+     * @tparam Ts The types of the components to add.
+     * @param query The query selecting the entities.
+     * @param values The components every matched entity is given a copy of.
+     * @return The number of entities the components were added to.
+     *
+     * \code{.cpp}
+     * auto targets = world.query<const Position, const Enemy>();
+     * world.add_all(targets, Frozen{.ticks = 60});
+     * \endcode
+     */
+    template<Component... Qs, Component... Ts>
+        requires(std::copy_constructible<Ts> and ...)
+    auto add_all(Query<Qs...>& query, const Ts&... values) -> usize {
+        static_assert(!pack_has_duplicates<Ts...>());
+        static_assert(sizeof...(Ts) > 0);
+
+        // Tables that receive entities from another table are only overwritten up to their original length
+        const auto lengths = bulk_lengths(query);
+        usize total{0};
+        for (usize i{0}; i < lengths.size(); ++i) {
+            const usize count{lengths[i]};
+            if (count == 0) {
+                continue;
+            }
 
-        for (const auto& info : entity_types) {
-            if (not_in_pack(info)) {
-                scratch_component_buffer.push_back(info);
+            ArchetypeId arch_id{query.cache->archetypes[i]};
+            usize first{0};
+            bool moved{false};
+            if constexpr (table_component_count<Ts...> > 0) {
+                if (const auto& edge = find_or_create_add_edge<Ts...>(arch_id); edge.target != arch_id) {
+                    first = move_table(arch_id, edge);
+                    arch_id = edge.target;
+                    moved = true;
+                }
             }
+
+            auto& arch_rec = archetypes[arch_id];
+            auto& arch = arch_rec.archetype;
+            (..., [&] {
+                if constexpr (SparseComponent<Ts>) {
+                    for (usize col{first}; col < first + count; ++col) {
+                        insert_sparse(arch_rec.entities[col], Ts(values));
+                    }
+                } else if constexpr (!TagComponent<Ts>) {
+                    const usize row{arch.row_of(component_index<Ts>())};
+                    if (!moved) {
+                        arch.mark_written(first, count, row);
+                    }
+                    arch.for_each_run(first, count, [&](const usize col, const usize len) {
+                        auto* ptr = static_cast<Ts*>(arch.get_raw(col, row));
+                        if (moved) {
+                            std::uninitialized_fill_n(ptr, len, values);
+                        } else {
+                            std::fill_n(ptr, len, values);
+                        }
+                    });
+                }
+            }());
+            total += count;
         }
+        return total;
+    }
 
-#ifndef NDEBUG
-        auto in_entity_type = [&](const CompTypeInfo& info1) {
-            return std::ranges::find_if(entity_types, [info1](const CompTypeInfo& info2) { return info1.id == info2.id; }) != entity_types.end();
-        };
+    /**
+     * @brief Removes the specified components from every entity matched by a query.
+     *
+     * Works table by table like `add_all`. Tables that do not have all of the table components in `Ts` are left alone,
+     * sparse components are removed from every matched entity that has them.
+     *
+     * @tparam Ts The types of the components to remove.
+     * @tparam Qs The queried component types.
+     * @param query The query selecting the entities.
+     * @return The number of matched entities.
+     *
+     * \code{.cpp}
+     * auto thawed = world.query<const Frozen, const Warm>();
+     * world.remove_all<Frozen>(thawed);
+     * \endcode
+     */
+    template<Component... Ts, Component... Qs>
+    auto remove_all(Query<Qs...>& query) -> usize {
+        static_assert(!pack_has_duplicates<Ts...>());
+        static_assert(sizeof...(Ts) > 0);
+
+        const auto lengths = bulk_lengths(query);
+        usize total{0};
+        for (usize i{0}; i < lengths.size(); ++i) {
+            const ArchetypeId arch_id{query.cache->archetypes[i]};
+            auto& arch_rec = archetypes[arch_id];
+            if (lengths[i] == 0) {
+                continue;
+            }
+            total += lengths[i];
+
+            (..., [&] {
+                if constexpr (SparseComponent<Ts>) {
+                    const usize index{component_index<Ts>()};
+                    for (usize col{0}; col < lengths[i]; ++col) {
+                        erase_sparse(index, arch_rec.entities[col]);
+                    }
+                }
+            }());
+
+            if constexpr (table_component_count<Ts...> > 0) {
+                const bool has_all{(... and (SparseComponent<Ts> or arch_rec.mask.test(component_index<Ts>())))};
+                if (has_all) {
+                    move_table(arch_id, find_or_create_remove_edge<Ts...>(arch_id));
+                }
+            }
+        }
+        return total;
+    }
+
+    /**
+     * @brief Despawns every entity matched by a query.
+     *
+     * Every matched table is cleared at once. The query selects whole tables, so change filters and disabled
+     * components are not considered and the query can not have sparse components.
+     *
+     * @tparam Qs The queried component types.
+     * @param query The query selecting the entities.
+     * @return The number of despawned entities.
+     */
+    template<Component... Qs>
+    auto despawn_all(Query<Qs...>& query) -> usize {
+        const auto lengths = bulk_lengths(query);
+        usize total{0};
+        for (usize i{0}; i < lengths.size(); ++i) {
+            total += despawn_table(query.cache->archetypes[i]);
+        }
+        return total;
+    }
+
+    /**
+     * @brief Enables a component of an entity that was disabled with `disable`.
+     *
+     * Only flips the enabled bit of the component, the entity stays in its archetype.
+     * Throws a `std::out_of_range` exception if the entity does not exist or does not have the component.
+     *
+     * @tparam T The enableable component type.
+     * @param entity The ID of the entity.
+     */
+    template<EnableableComponent T>
+    auto enable(const EntityId entity) -> void {
+        set_enabled<T>(entity, true);
+    }
+
+    /**
+     * @brief Disables a component of an entity without removing it.
+     *
+     * Queries skip the entity as if it did not have the component, but the component keeps its state and can
+     * still be read with `get`. Only flips the enabled bit of the component, the entity stays in its archetype.
+     * Throws a `std::out_of_range` exception if the entity does not exist or does not have the component.
+     *
+     * @tparam T The enableable component type.
+     * @param entity The ID of the entity.
+     *
+     * \code{.cpp}
+     * struct Ai {
+     *     using is_enableable = void;
+     *     Behaviour behaviour;
+     * };
+     *
+     * world.disable<Ai>(entity); // The AI system no longer sees the entity
+     * world.enable<Ai>(entity);  // The entity continues with the same behaviour
+     * \endcode
+     */
+    template<EnableableComponent T>
+    auto disable(const EntityId entity) -> void {
+        set_enabled<T>(entity, false);
+    }
+
+    /**
+     * @brief Checks if a component of an entity is enabled.
+     * @tparam T The enableable component type.
+     * @param entity The ID of the entity.
+     * @return true if the component is enabled, false if it was disabled.
+     * @throws std::out_of_range if the entity does not exist or does not have the component.
+     */
+    template<EnableableComponent T>
+    [[nodiscard]] auto is_enabled(const EntityId entity) -> bool {
+        const auto& record = entity_record(entity);
+        const auto& arch = archetypes[record.archetype].archetype;
+        return arch.is_enabled(record.col, component_row<T>(arch));
+    }
+
+    /**
+     * @brief Creates a query over all entities that have the components `Ts`.
+     *
+     * @tparam Ts The component types to query.
+     * @return The query, which is resolved against the world the first time it is run.
+     */
+    template<Component... Ts>
+    auto query() -> Query<Ts...> {
+        static_assert(sizeof...(Ts) > 0);
+        static_assert(sizeof...(Ts) <= 64, "A query supports at most 64 components");
+        static_assert(!pack_has_duplicates<Ts...>());
+        auto que = Query<Ts...>(this);
+
+        return que;
+    }
+
+    /**
+     * @brief Writes all entities and their components to a snapshot file.
+     *
+     * Every non-empty archetype is written with its component ids, its entities and one block per component row.
+     * Trivially copyable components are written as raw bytes, other components with their `save` member, see
+     * `SerializableComponent`. The snapshot keeps the entity handles and the enabled bits, not the change ticks, and
+     * can only be loaded on a platform with the same byte order and component layouts.
+     *
+     * @param path The path of the file, which is overwritten.
+     * @throws std::runtime_error If the file could not be written.
+     */
+    auto save(const std::filesystem::path& path) const -> void;
+
+    /**
+     * @brief Loads the entities and components of a snapshot file into an empty world.
+     *
+     * The file is mapped instead of read, and the archetype tables, type map, component map and entity records are
+     * rebuilt in bulk. Trivially copyable components are copied a whole row at a time, and in
+     * `ArchetypeStorage::mapped` mode large rows are mapped straight from the file, so they are neither read nor
+     * constructed until they are used. Every loaded component is stamped as added at the current tick.
+     *
+     * \code{.cpp}
+     * world.save("checkpoint.snap");
+     *
+     * World restored;
+     * restored.load<Position, Velocity, Name>("checkpoint.snap");
+     * \endcode
+     *
+     * @tparam Ts Component types to register before loading. Every component in the snapshot has to be registered.
+     * @param path The path of the file.
+     * @throws std::runtime_error If the file is not a snapshot, is truncated or contains an unregistered component
+     * or a component with another layout. The world has to be discarded in that case.
+     */
+    template<Component... Ts>
+    auto load(const std::filesystem::path& path) -> void {
+        (component_index<Ts>(), ...);
+        load_snapshot(path);
+    }
+
+    /**
+     * @brief Takes a copy-on-write snapshot of the world that `restore` can roll back to.
+     *
+     * Nothing is copied when the fork is taken. Afterwards the first write to a tick block of a component row, through
+     * a query, `get`, `add` or `enable`, saves a copy of that block, so a fork costs as much as the data written while
+     * it is the newest one. The first spawn, despawn or component add or remove in a table saves the whole table and
+     * the entity slots instead. Forks stack: every fork logs the writes made after it until the next fork is taken.
+     *
+     * \code{.cpp}
+     * const ForkId confirmed = world.fork();
+     * simulate(world, predicted_input);
+     * world.restore(confirmed); // Roll back the prediction
+     * simulate(world, confirmed_input);
+     * \endcode
+     *
+     * @return The id of the fork.
+     * @throws std::logic_error If a registered component with storage is not copy constructible.
+     */
+    auto fork() -> ForkId;
+
+    /**
+     * @brief Rolls the world back to the state it had when a fork was taken.
+     *
+     * Components, enabled bits and entity slots are restored, so entities despawned since the fork are alive again
+     * and entities spawned since the fork are not. Forks taken after `id` are dropped, `id` itself stays alive and the
+     * world can be rolled back to it again. Restored components are marked as changed at the current tick.
+     *
+     * @param id The id of a live fork.
+     * @throws std::out_of_range If the fork was released or dropped.
+     */
+    auto restore(ForkId id) -> void;
+
+    /**
+     * @brief Releases a fork and all forks taken before it.
+     *
+     * Once no fork is left, writes are no longer saved.
+     *
+     * @param id The id of a live fork.
+     * @throws std::out_of_range If the fork was released or dropped.
+     */
+    auto release_fork(ForkId id) -> void;
+
+    /**
+     * @brief Gets the number of live forks.
+     * @return The number of forks that can be restored.
+     */
+    [[nodiscard]] auto fork_count() const noexcept -> usize { return forks.size(); }
+
+  private:
+    /**
+     * @brief Looks up the record of an entity.
+     * @param entity The ID of the entity.
+     * @return A reference to the record of the entity.
+     * @throws std::out_of_range if the entity does not exist.
+     */
+    [[nodiscard]] auto entity_record(const EntityId entity) -> EntityRecord& {
+        if (!is_alive(entity)) [[unlikely]] {
+            throw std::out_of_range("The entity was not found");
+        }
+        return entity_records[entity_index(entity)];
+    }
+
+    /**
+     * @brief Allocates an entity slot, recycling a free slot if there is one.
+     * @param arch_id The archetype the entity is stored in.
+     * @param col The column of the entity in the archetype.
+     * @return The ID of the new entity.
+     */
+    auto allocate_entity(ArchetypeId arch_id, usize col) -> EntityId;
+
+    /**
+     * @brief Resolves the archetype of a batch spawn and makes room for `count` new columns.
+     * @tparam Ts The component types of the batch.
+     * @param count The number of entities in the batch.
+     * @return A reference to the archetype record.
+     */
+    template<Component... Ts>
+    auto prepare_batch(const usize count) -> ArchetypeRecord& {
+        static_assert(table_component_count<Ts...> == sizeof...(Ts), "Sparse components can not be spawned in batches, add them afterwards");
+        auto& arch_rec = spawn_archetype<Ts...>();
+        before_table_change(arch_rec.id);
+        arch_rec.archetype.prepare_push(count);
+        return arch_rec;
+    }
+
+    /**
+     * @brief Commits the `count` columns constructed past the end of an archetype and allocates their entities.
+     * @param arch_rec The archetype record of the batch.
+     * @param count The number of entities in the batch.
+     * @return The IDs of the new entities.
+     */
+    auto finish_batch(ArchetypeRecord& arch_rec, usize count) -> std::vector<EntityId>;
 
-        for (const auto& info : pack_infos) {
-            NIDAVELLIR_ASSERT(in_entity_type(info), "Tried removing a component from an entity that did not have it");
+    /**
+     * @brief Gets the dense index of a component type, registering the type on first use.
+     * @tparam T The component type.
+     * @return The dense index of the component type.
+     */
+    template<Component T>
+    auto component_index() -> usize {
+        const usize sequence{type_sequence<T>()};
+        if (sequence < sequence_indices.size() and sequence_indices[sequence] != no_component_index) [[likely]] {
+            return sequence_indices[sequence];
         }
-#endif
+        return register_component(sequence, get_component_info<T>(), SparseComponent<T>);
+    }
 
-        sort_component_list(scratch_component_buffer);
+    /**
+     * @brief Gets the type info of a component type with its dense index set, registering the type on first use.
+     * @tparam T The component type.
+     * @return The type info of the component type.
+     */
+    template<Component T>
+    auto component_info() -> const CompTypeInfo& {
+        return components[component_index<T>()];
+    }
 
-        auto& [target_arch, target_entities, target_id] = find_or_create_archetype(scratch_component_buffer);
-        auto& [src_arch, src_entities, _] = archetype_map.at(src_id);
+    /**
+     * @brief Registers a component type and assigns it the next dense index.
+     * @param sequence The `type_sequence` of the component type.
+     * @param info The type info of the component type.
+     * @param sparse true if the component type is stored in a sparse set.
+     * @return The dense index of the component type.
+     */
+    auto register_component(usize sequence, CompTypeInfo info, bool sparse) -> usize;
 
-        NIDAVELLIR_ASSERT(src_id != target_id, "When removing components there should be no way of ending up in the same archetype again");
+    /**
+     * @brief Loads a snapshot file into an empty world whose components are registered.
+     * @param path The path of the file.
+     */
+    auto load_snapshot(const std::filesystem::path& path) -> void;
 
-        target_arch.prepare_push(1);
-        const usize target_col{target_arch.len()};
+    /**
+     * @brief Saves a table for the newest fork before its columns or entities change.
+     * @param arch_id The archetype that is about to change.
+     */
+    auto before_table_change(const ArchetypeId arch_id) -> void {
+        if (!forks.empty()) [[unlikely]] {
+            save_fork_table(arch_id);
+        }
+    }
 
-        for (const auto& info : scratch_component_buffer) {
-            void* src_ptr = src_arch.get_raw(src_col, src_arch.get_row(info.id));
-            void* dst_ptr = target_arch.get_raw(target_col, target_arch.get_row(info.id));
+    /**
+     * @brief Saves the entity slots and a copy of a table for the newest fork, unless they are saved already.
+     *
+     * The copy holds the table at the time of the fork, and writes to the table are no longer logged.
+     *
+     * @param arch_id The archetype that is about to change.
+     */
+    auto save_fork_table(ArchetypeId arch_id) -> void;
+
+    /**
+     * @brief Saves a copy of a sparse set for the newest fork, unless it is saved already.
+     * @param index The dense index of the sparse component.
+     */
+    auto save_fork_sparse_set(usize index) -> void;
 
-            info.move_ctor_dtor(dst_ptr, src_ptr, 1);
+    /**
+     * @brief Inserts a sparse component, saving the sparse set for the newest fork if the entity is new to it.
+     * @tparam T The sparse component type.
+     * @param entity The ID of the entity.
+     * @param value The component.
+     */
+    template<SparseComponent T>
+    auto insert_sparse(const EntityId entity, T&& value) -> void {
+        auto& set = sparse_set<T>();
+        if (!forks.empty() and !set.contains(entity)) [[unlikely]] {
+            save_fork_sparse_set(component_index<T>());
         }
+        set.insert(entity, std::forward<T>(value));
+    }
 
-        for (const auto& info : pack_infos) {
-            void* src_ptr = src_arch.get_raw(src_col, src_arch.get_row(info.id));
+    /**
+     * @brief Erases a sparse component, saving the sparse set for the newest fork if the entity has the component.
+     * @param index The dense index of the sparse component.
+     * @param entity The ID of the entity.
+     */
+    auto erase_sparse(usize index, EntityId entity) -> void;
 
-            info.dtor(src_ptr, 1);
+    /**
+     * @brief Creates a fork of the current state and logs all writes to it from now on.
+     * @param id The id of the fork.
+     * @return The fork.
+     */
+    auto start_fork(ForkId id) -> std::unique_ptr<Fork>;
+
+    /**
+     * @brief Rolls the world back to the state at the time of a fork, assuming the forks after it were undone.
+     * @param fork The fork.
+     */
+    auto undo_fork(Fork& fork) -> void;
+
+    /**
+     * @brief Finds a live fork.
+     * @param id The id of the fork.
+     * @return The position of the fork in `forks`.
+     * @throws std::out_of_range If the fork is not alive.
+     */
+    [[nodiscard]] auto fork_position(ForkId id) const -> usize;
+
+    /**
+     * @brief Sets the enabled bit of a component of an entity.
+     * @tparam T The enableable component type.
+     * @param entity The ID of the entity.
+     * @param value true to enable the component, false to disable it.
+     */
+    template<EnableableComponent T>
+    auto set_enabled(const EntityId entity, const bool value) -> void {
+        const auto& record = entity_record(entity);
+        auto& arch = archetypes[record.archetype].archetype;
+        arch.set_enabled(record.col, component_row<T>(arch), value);
+    }
+
+    /**
+     * @brief Gets the sparse set of a sparse component type, registering the type on first use.
+     * @tparam T The sparse component type.
+     * @return A reference to the sparse set.
+     */
+    template<SparseComponent T>
+    auto sparse_set() -> SparseSet& {
+        return *sparse_sets[component_index<T>()];
+    }
+
+    /**
+     * @brief Gets a component of an entity and marks it as changed if `T` is not const.
+     * @tparam T The component type.
+     * @param entity The ID of the entity.
+     * @param arch The archetype of the entity.
+     * @param col The column of the entity.
+     * @return A reference to the component.
+     * @throws std::out_of_range if the entity does not have the component.
+     */
+    template<Component T>
+    auto component_ref(const EntityId entity, Archetype& arch, const usize col) -> T& {
+        if constexpr (SparseComponent<T>) {
+            auto& set = sparse_set<T>();
+            const usize sparse_col{set.find(entity)};
+            if (sparse_col == Archetype::no_row) {
+                throw std::out_of_range("The entity does not have the component");
+            }
+            if constexpr (!std::is_const_v<T>) {
+                set.mark_changed(sparse_col);
+            }
+            return *static_cast<T*>(set.get_raw(sparse_col));
+        } else if constexpr (TagComponent<T>) {
+            [[maybe_unused]] const usize row{component_row<T>(arch)};
+            return tag_instance<std::remove_const_t<T>>;
+        } else {
+            const usize row{component_row<T>(arch)};
+            if constexpr (!std::is_const_v<T>) {
+                arch.mark_changed(col, row);
+            }
+            return *static_cast<T*>(arch.get_raw(col, row));
         }
+    }
 
-        target_entities.push_back(entity);
-        target_arch.increase_size(1);
+    /**
+     * @brief Gets a component of an entity whose row is known, marks it as changed if `T` is not const and prefetches it.
+     * @tparam T The component type.
+     * @param entity The ID of the entity.
+     * @param arch The archetype of the entity.
+     * @param col The column of the entity.
+     * @param row The row of the component, ignored for sparse and tag components.
+     * @return A pointer to the component.
+     * @throws std::out_of_range if the entity does not have the sparse component.
+     */
+    template<Component T>
+    auto component_ptr(const EntityId entity, Archetype& arch, const usize col, const usize row) -> T* {
+        if constexpr (SparseComponent<T>) {
+            return &component_ref<T>(entity, arch, col);
+        } else if constexpr (TagComponent<T>) {
+            return &tag_instance<std::remove_const_t<T>>;
+        } else {
+            if constexpr (!std::is_const_v<T>) {
+                arch.mark_changed(col, row);
+            }
+            auto* ptr = static_cast<T*>(arch.get_raw(col, row));
+            prefetch(ptr);
+            return ptr;
+        }
+    }
 
-        const usize src_last_col{src_arch.len() - 1};
-        if (src_col < src_last_col) {
-            src_arch.swap(src_col, src_last_col);
-            std::swap(src_entities[src_col], src_entities[src_last_col]);
-            entity_map.at(src_entities[src_col]).col = src_col;
+    /**
+     * @brief Gets the type infos of the components of a pack that are stored in the archetype tables.
+     * @tparam Ts The component types.
+     * @return The type infos of the table components in pack order.
+     */
+    template<Component... Ts>
+    auto table_infos() -> std::array<CompTypeInfo, table_component_count<Ts...>> {
+        std::array<CompTypeInfo, table_component_count<Ts...>> infos{};
+        usize i{0};
+        (..., [&] {
+            if constexpr (!SparseComponent<Ts>) {
+                infos[i++] = component_info<Ts>();
+            }
+        }());
+        return infos;
+    }
+
+    /**
+     * @brief Gets the row of a component in an archetype.
+     * @tparam T The component type.
+     * @param arch The archetype.
+     * @return The row of the component.
+     * @throws std::out_of_range if the archetype does not have the component.
+     */
+    template<Component T>
+    auto component_row(const Archetype& arch) -> usize {
+        const usize row{arch.row_of(component_index<T>())};
+        if (row == Archetype::no_row) {
+            throw std::out_of_range("The entity does not have the component");
         }
+        return row;
+    }
 
-        src_entities.pop_back();
-        src_arch.decrease_size(1);
+    /**
+     * @brief Gets the rows of a pack of components in an archetype that has all of them.
+     * @tparam Ts The component types.
+     * @param arch The archetype.
+     * @return The row of every component in the pack.
+     */
+    template<Component... Ts>
+    auto pack_rows(const Archetype& arch) -> std::array<usize, sizeof...(Ts)> {
+        return {arch.row_of(component_index<Ts>())...};
+    }
 
-        src_id = target_id;
-        src_col = target_col;
+    /**
+     * @brief Finds the archetype with the given signature.
+     * @param hash The `signature_hash` of the ids.
+     * @param ids The component ids in row order.
+     * @return The id of the archetype, `no_archetype` if there is none.
+     */
+    [[nodiscard]] auto find_archetype(u64 hash, std::span<const ComponentId> ids) const -> ArchetypeId;
 
-        scratch_component_buffer.clear();
+    /**
+     * @brief Gets the archetype that holds exactly the components of a pack.
+     *
+     * The archetype is cached per pack, so after the first spawn of a pack this is a single array load
+     * without sorting, hashing or allocating.
+     *
+     * @tparam Ts The component types of the pack.
+     * @return A reference to the archetype record.
+     */
+    template<Component... Ts>
+    auto spawn_archetype() -> ArchetypeRecord& {
+        const usize sequence{pack_sequence<Ts...>()};
+        if (sequence < spawn_archetypes.size() and spawn_archetypes[sequence] != no_archetype) [[likely]] {
+            return archetypes[spawn_archetypes[sequence]];
+        }
+        return resolve_spawn_archetype<Ts...>(sequence);
     }
 
+    /**
+     * @brief Finds or creates the archetype of a pack and caches it for `spawn_archetype`.
+     * @tparam Ts The component types of the pack.
+     * @param sequence The `pack_sequence` of the pack.
+     * @return A reference to the archetype record.
+     */
     template<Component... Ts>
-    auto query() -> Query<Ts...> {
-        static_assert(sizeof...(Ts) > 0);
-        auto que = Query<Ts...>(this);
+    auto resolve_spawn_archetype(const usize sequence) -> ArchetypeRecord& {
+        using Sig = PackSignature<std::decay_t<Ts>...>;
+        ArchetypeId arch_id{find_archetype(Sig::hash, Sig::ids)};
+        if (arch_id == no_archetype) {
+            std::array<CompTypeInfo, sizeof...(Ts)> comp_ts = {component_info<Ts>()...};
+            sort_component_list(comp_ts);
+            arch_id = find_or_create_archetype(comp_ts).id;
+            NIDAVELLIR_ASSERT(archetypes[arch_id].signature.matches(Sig::hash, Sig::ids), "The pack signature does not match the sorted type list");
+        }
 
-        return que;
+        if (sequence >= spawn_archetypes.size()) {
+            spawn_archetypes.resize(sequence + 1, no_archetype);
+        }
+        spawn_archetypes[sequence] = arch_id;
+        return archetypes[arch_id];
     }
 
-  private:
     /**
      * @brief Finds or creates an archetype for the given component type list.
-     * @param comp_ts The component type list.
+     * @param comp_ts The component type list, sorted with `sort_component_list`.
      * @return A reference to the archetype record.
      */
-    auto find_or_create_archetype(const CompTypeList& comp_ts) -> ArchetypeRecord&;
+    auto find_or_create_archetype(std::span<const CompTypeInfo> comp_ts) -> ArchetypeRecord&;
+
+    /**
+     * @brief Finds or creates the cache of a query with the given terms.
+     * @param terms The queried components in pack order.
+     * @param optional_mask Bit i is set if term i is optional.
+     * @return A reference to the query cache, which stays valid for the lifetime of the world.
+     */
+    auto find_or_create_query(std::span<const CompTypeInfo> terms, u64 optional_mask) -> QueryCache&;
+
+    /**
+     * @brief Adds an archetype to a query cache if it matches the query.
+     * @param cache The query cache.
+     * @param arch_id The id of the archetype to match.
+     */
+    auto match_query(QueryCache& cache, ArchetypeId arch_id) const -> void;
+
+    /**
+     * @brief Adds a matching archetype and the rows of the query terms to a query cache.
+     * @param cache The query cache.
+     * @param arch_id The id of the matching archetype.
+     */
+    auto add_query_match(QueryCache& cache, ArchetypeId arch_id) const -> void;
+
+    /**
+     * @brief Finds the cached transition for adding the components `Ts` to an archetype, creating it on first use.
+     *
+     * Sparse components in `Ts` are not part of any archetype and are ignored.
+     *
+     * @param src_id The id of the source archetype.
+     * @return A reference to the edge, valid until the next archetype is created.
+     */
+    template<Component... Ts>
+    auto find_or_create_add_edge(const ArchetypeId src_id) -> const ArchetypeEdge& {
+        constexpr auto key = pack_id<Ts...>();
+        const auto& edges = archetypes[src_id].add_edges;
+        if (const auto edge_it = edges.find(key); edge_it != edges.end()) {
+            return edge_it->second;
+        }
+
+        const auto pack_infos = table_infos<Ts...>();
+        return create_add_edge(src_id, key, pack_infos);
+    }
+
+    /**
+     * @brief Finds the cached transition for removing the components `Ts` from an archetype, creating it on first use.
+     *
+     * Sparse components in `Ts` are not part of any archetype and are ignored.
+     *
+     * @param src_id The id of the source archetype.
+     * @return A reference to the edge, valid until the next archetype is created.
+     */
+    template<Component... Ts>
+    auto find_or_create_remove_edge(const ArchetypeId src_id) -> const ArchetypeEdge& {
+        constexpr auto key = pack_id<Ts...>();
+        const auto& edges = archetypes[src_id].remove_edges;
+        if (const auto edge_it = edges.find(key); edge_it != edges.end()) {
+            return edge_it->second;
+        }
+
+        const auto pack_infos = table_infos<Ts...>();
+        return create_remove_edge(src_id, key, pack_infos);
+    }
+
+    /**
+     * @brief Resolves the target archetype of adding a pack of components and caches it as an edge.
+     * @param src_id The id of the source archetype.
+     * @param key The `pack_id` of the pack.
+     * @param pack_infos The component infos of the pack.
+     * @return A reference to the new edge.
+     */
+    auto create_add_edge(ArchetypeId src_id, usize key, std::span<const CompTypeInfo> pack_infos) -> const ArchetypeEdge&;
+
+    /**
+     * @brief Resolves the target archetype of removing a pack of components and caches it as an edge.
+     * @param src_id The id of the source archetype.
+     * @param key The `pack_id` of the pack.
+     * @param pack_infos The component infos of the pack.
+     * @return A reference to the new edge.
+     */
+    auto create_remove_edge(ArchetypeId src_id, usize key, std::span<const CompTypeInfo> pack_infos) -> const ArchetypeEdge&;
+
+    /**
+     * @brief Moves all entities of an archetype along an edge into the edge's target archetype.
+     *
+     * The components are moved table by table with `Archetype::append_columns` and the entity records are patched
+     * in one pass. Components that are not moved still need to be constructed in the new columns.
+     *
+     * @param src_id The id of the source archetype, which is empty afterwards.
+     * @param edge The edge to move the entities along.
+     * @return The column of the first moved entity in the target archetype.
+     */
+    auto move_table(ArchetypeId src_id, const ArchetypeEdge& edge) -> usize;
+
+    /**
+     * @brief Despawns all entities of an archetype.
+     * @param arch_id The id of the archetype.
+     * @return The number of despawned entities.
+     */
+    auto despawn_table(ArchetypeId arch_id) -> usize;
+
+    /**
+     * @brief Prepares a query for a bulk change and gets the length of every table it matches before the change.
+     *
+     * Archetypes created by the change are matched by the query as well and tables can receive entities from
+     * other tables, but only the entities that were matched before the change are selected.
+     *
+     * @tparam Qs The queried component types.
+     * @param query The query selecting the tables.
+     * @return The number of columns of every matched table, in the order of the query cache.
+     */
+    template<Component... Qs>
+    auto bulk_lengths(Query<Qs...>& query) -> std::vector<usize> {
+        static_assert(!Query<Qs...>::has_sparse_terms, "Bulk changes select whole tables, sparse components are joined per entity");
+        NIDAVELLIR_ASSERT(query.filters.empty(), "Bulk changes select whole tables and ignore change filters");
+        NIDAVELLIR_ASSERT(query.world == this, "The query belongs to another world");
+        if (query.cache == nullptr) {
+            query.build();
+        }
+
+        std::vector<usize> lengths(query.cache->archetypes.size());
+        for (usize i{0}; i < lengths.size(); ++i) {
+            lengths[i] = archetypes[query.cache->archetypes[i]].archetype.len();
+        }
+        return lengths;
+    }
+
+    /**
+     * @brief Moves an entity along an edge into the edge's target archetype.
+     *
+     * Components with a target row are moved, the others are destroyed. The entity record is updated to
+     * point at the new column, where components that are not moved still need to be constructed.
+     *
+     * @param entity The entity to move.
+     * @param record The record of the entity.
+     * @param edge The edge to move the entity along.
+     */
+    auto move_entity(EntityId entity, EntityRecord& record, const ArchetypeEdge& edge) -> void;
 };
 } // namespace nid
@@ -3,6 +3,9 @@
 #include "comp_type_info.h"
 
 #include "gtest/gtest.h"
+#include <algorithm>
+#include <cstdint>
+#include <new>
 #include <vector>
 #include <random>
 
@@ -111,6 +114,8 @@ struct T4 {
     std::string message;
 };
 
+struct Tag {};
+
 class ArchetypeTest : public testing::Test {
   protected:
     CompTypeList lst1 = get_sorted_infos<T1, T2>();
@@ -358,6 +363,8 @@ TEST_F(ArchetypeTest, swap_same_and_full) {
     EXPECT_EQ(arch3.cap(), arch3.len());
     arch3.swap(arch3.len() - 1, arch3.len() - 1);
     arch3.swap(arch3.len() - 1, 0);
+    EXPECT_EQ(arch3.cap(), cap);
+    EXPECT_EQ(arch3.get_component<T4>(0).message, "SwapTest");
 }
 
 TEST_F(ArchetypeTest, swap_empty) {
@@ -385,3 +392,246 @@ TEST_F(ArchetypeTest, no_copies) {
     EXPECT_EQ(r_c2.copies, 0);
     EXPECT_EQ(r_c2.moves, 1);
 }
+
+TEST(ArchetypeChunkedTest, stable_growth) {
+    Archetype arch(get_sorted_infos<T1, T4>(), StorageConfig{.storage = ArchetypeStorage::chunked, .chunk_bytes = 1024});
+    EXPECT_EQ(arch.storage_mode(), ArchetypeStorage::chunked);
+
+    const usize chunk_len{arch.run_len(0)};
+    ASSERT_GT(chunk_len, 1);
+    EXPECT_EQ(chunk_len & (chunk_len - 1), 0);
+    EXPECT_LE(chunk_len * (sizeof(T1) + sizeof(T4)), 1024);
+
+    [[maybe_unused]] auto _ = arch.emplace_back(T1{.x = 0, .y = 0}, T4{.x = 0, .y = 0, .message = "0"});
+    const auto* first = &arch.get_component<T4>(0);
+    for (usize i{1}; i < 10 * chunk_len; ++i) {
+        _ = arch.emplace_back(T1{.x = static_cast<f32>(i), .y = 0}, T4{.x = 0, .y = 0, .message = std::to_string(i)});
+    }
+    EXPECT_EQ(first, &arch.get_component<T4>(0));
+    EXPECT_EQ(arch.len(), 10 * chunk_len);
+    EXPECT_GE(arch.cap(), arch.len());
+
+    usize runs{0};
+    usize total{0};
+    arch.for_each_run(chunk_len / 2, arch.len() - chunk_len / 2, [&](const usize col, const usize len) {
+        for (usize i{0}; i < len; ++i) {
+            EXPECT_EQ(static_cast<T1*>(arch.get_raw(col, arch.get_row(type_id<T1>())))[i].x, static_cast<f32>(col + i));
+        }
+        ++runs;
+        total += len;
+    });
+    EXPECT_EQ(runs, 10);
+    EXPECT_EQ(total, arch.len() - chunk_len / 2);
+
+    const auto last = arch.remove(0);
+    EXPECT_EQ(last, arch.len());
+    EXPECT_EQ(arch.get_component<T4>(0).message, std::to_string(last));
+    arch.swap(0, chunk_len + 1);
+    EXPECT_EQ(arch.get_component<T4>(chunk_len + 1).message, std::to_string(last));
+}
+
+TEST(ArchetypePackedTest, single_allocation_growth) {
+    Archetype arch(get_sorted_infos<T1, T2, T3, T4>(), StorageConfig{.storage = ArchetypeStorage::packed});
+    EXPECT_EQ(arch.storage_mode(), ArchetypeStorage::packed);
+    for (usize i{0}; i < 1000; ++i) {
+        [[maybe_unused]] auto _ = arch.emplace_back(T1{.x = static_cast<f32>(i), .y = 0}, T2{}, T3{.x = 0, .y = 0, .floats = {static_cast<f32>(i)}},
+                                                    T4{.x = 0, .y = 0, .message = std::to_string(i)});
+    }
+    EXPECT_EQ(arch.run_len(0), arch.run_len(999) + 999);
+
+    // Every row is aligned and the rows of the buffer do not overlap
+    std::vector<std::pair<const u8*, const u8*>> ranges;
+    for (usize row{0}; row < arch.data_row_count(); ++row) {
+        const auto* first = static_cast<const u8*>(arch.get_raw(0, row));
+        EXPECT_EQ(reinterpret_cast<std::uintptr_t>(first) % arch.type()[row].alignment, 0);
+        ranges.emplace_back(first, first + arch.cap() * arch.type()[row].size);
+    }
+    std::ranges::sort(ranges);
+    for (usize i{1}; i < ranges.size(); ++i) {
+        EXPECT_LE(ranges[i - 1].second, ranges[i].first);
+    }
+
+    EXPECT_EQ(arch.remove(0), 999);
+    EXPECT_EQ(arch.get_component<T4>(0).message, "999");
+    EXPECT_EQ(arch.get_component<T3>(500).floats, std::vector<f32>{500});
+    EXPECT_EQ(std::distance(arch.begin<T1>(), arch.end<T1>()), 999);
+    EXPECT_EQ(arch.begin<T1>()[1].x, 1);
+}
+
+TEST(ArchetypeMappedTest, growth_keeps_addresses) {
+    Archetype arch(get_sorted_infos<T1, T3, T4>(), StorageConfig{.storage = ArchetypeStorage::mapped, .mapped_bytes = 64 * 1024 * 1024, .mapped_threshold = 0});
+    if (arch.storage_mode() != ArchetypeStorage::mapped) {
+        GTEST_SKIP() << "Mapped storage is not supported on this platform";
+    }
+
+    [[maybe_unused]] auto _ = arch.emplace_back(T1{.x = 0, .y = 0}, T3{.x = 0, .y = 0, .floats = {0}}, T4{.x = 0, .y = 0, .message = "0"});
+    std::vector<const void*> starts;
+    for (usize row{0}; row < arch.data_row_count(); ++row) {
+        starts.push_back(arch.get_raw(0, row));
+    }
+    for (usize i{1}; i < 100'000; ++i) {
+        [[maybe_unused]] auto _ = arch.emplace_back(T1{.x = static_cast<f32>(i), .y = 0}, T3{.x = 0, .y = 0, .floats = {static_cast<f32>(i)}},
+                                                    T4{.x = 0, .y = 0, .message = std::to_string(i)});
+    }
+    for (usize row{0}; row < arch.data_row_count(); ++row) {
+        EXPECT_EQ(arch.get_raw(0, row), starts[row]);
+    }
+    EXPECT_EQ(arch.run_len(0), arch.run_len(99'999) + 99'999);
+    EXPECT_EQ(arch.get_component<T3>(77'777).floats, std::vector<f32>{77'777});
+
+    EXPECT_EQ(arch.remove(0), 99'999);
+    EXPECT_EQ(arch.get_component<T4>(0).message, "99999");
+    EXPECT_EQ(std::distance(arch.begin<T1>(), arch.end<T1>()), 99'999);
+
+    // A row that outgrows its reserved address space fails instead of moving
+    EXPECT_THROW(arch.reserve(64 * 1024 * 1024), std::bad_alloc);
+    EXPECT_EQ(arch.get_component<T4>(1).message, "1");
+}
+
+TEST(ArchetypeMappedTest, maps_rows_at_threshold) {
+    Archetype arch(get_sorted_infos<T1, T4>(), StorageConfig{.storage = ArchetypeStorage::mapped, .mapped_bytes = 64 * 1024 * 1024, .mapped_threshold = 1024});
+    EXPECT_EQ(arch.storage_mode(), ArchetypeStorage::contiguous);
+    for (usize i{0}; i < 500; ++i) {
+        [[maybe_unused]] auto _ = arch.emplace_back(T1{.x = static_cast<f32>(i), .y = 0}, T4{.x = 0, .y = 0, .message = std::to_string(i)});
+    }
+    EXPECT_EQ(arch.storage_mode(), ArchetypeStorage::contiguous);
+
+    for (usize i{500}; i < 2000; ++i) {
+        [[maybe_unused]] auto _ = arch.emplace_back(T1{.x = static_cast<f32>(i), .y = 0}, T4{.x = 0, .y = 0, .message = std::to_string(i)});
+    }
+    if (arch.storage_mode() != ArchetypeStorage::mapped) {
+        GTEST_SKIP() << "Mapped storage is not supported on this platform";
+    }
+    const void* start{arch.get_raw(0, 0)};
+    for (usize i{2000}; i < 5000; ++i) {
+        [[maybe_unused]] auto _ = arch.emplace_back(T1{.x = static_cast<f32>(i), .y = 0}, T4{.x = 0, .y = 0, .message = std::to_string(i)});
+    }
+    EXPECT_EQ(arch.get_raw(0, 0), start);
+    for (usize col{0}; col < arch.len(); ++col) {
+        EXPECT_EQ(arch.get_component<T1>(col).x, static_cast<f32>(col));
+        EXPECT_EQ(arch.get_component<T4>(col).message, std::to_string(col));
+    }
+}
+
+TEST(ArchetypeGrowthTest, incremental_growth) {
+    for (const auto storage : {ArchetypeStorage::contiguous, ArchetypeStorage::packed}) {
+        Archetype arch(get_sorted_infos<T1, T4>(), StorageConfig{.storage = storage, .migration_step = 16});
+        auto emplace = [&](const usize i) {
+            [[maybe_unused]] auto _ = arch.emplace_back(T1{.x = static_cast<f32>(i), .y = 0}, T4{.x = 0, .y = 0, .message = std::to_string(i)});
+        };
+        usize pushed{0};
+        while (arch.len() <= 16 or arch.len() < arch.cap()) {
+            emplace(pushed++);
+        }
+        EXPECT_FALSE(arch.growth_pending());
+
+        // The growth leaves the columns in the old buffers, which are moved in steps by the following pushes
+        emplace(pushed++);
+        EXPECT_TRUE(arch.growth_pending());
+        usize runs{0};
+        usize covered{0};
+        arch.for_each_run(0, arch.len(), [&](const usize col, const usize len) {
+            EXPECT_EQ(col, covered);
+            covered += len;
+            ++runs;
+        });
+        EXPECT_EQ(covered, arch.len());
+        EXPECT_EQ(runs, 3);
+        for (usize col{0}; col < arch.len(); ++col) {
+            EXPECT_EQ(arch.get_component<T4>(col).message, std::to_string(col));
+        }
+
+        // Swaps and removals work across both buffers
+        const usize last{arch.len() - 1};
+        arch.swap(0, last);
+        EXPECT_EQ(arch.get_component<T4>(0).message, std::to_string(last));
+        EXPECT_EQ(arch.get_component<T1>(last).x, 0);
+        EXPECT_EQ(arch.remove(0), last);
+        EXPECT_EQ(arch.get_component<T4>(0).message, "0");
+
+        while (arch.growth_pending()) {
+            emplace(pushed++);
+        }
+        EXPECT_LT(arch.len(), arch.cap());
+        for (usize col{1}; col < last; ++col) {
+            EXPECT_EQ(arch.get_component<T4>(col).message, std::to_string(col));
+        }
+
+        // Removing the columns that are left to move finishes the growth
+        while (arch.len() < arch.cap()) {
+            emplace(pushed++);
+        }
+        emplace(pushed++);
+        EXPECT_TRUE(arch.growth_pending());
+        while (arch.len() > 20) {
+            [[maybe_unused]] auto _ = arch.remove(arch.len() - 1);
+        }
+        EXPECT_FALSE(arch.growth_pending());
+        EXPECT_EQ(arch.get_component<T4>(19).message, "19");
+
+        emplace(pushed++);
+        arch.reserve(arch.cap() * 2);
+        EXPECT_TRUE(arch.growth_pending());
+        arch.finish_growth();
+        EXPECT_FALSE(arch.growth_pending());
+        EXPECT_EQ(std::distance(arch.begin<T1>(), arch.end<T1>()), 21);
+    }
+}
+
+TEST(ArchetypeTicksTest, remove_and_swap) {
+    u32 tick{1};
+    Archetype arch(get_sorted_infos<T1, T2>(), {}, &tick);
+    const usize row{arch.get_row(type_id<T1>())};
+    for (usize i{0}; i < 600; ++i) {
+        [[maybe_unused]] auto _ = arch.emplace_back(T1{}, T2{});
+    }
+    EXPECT_EQ(arch.added_tick(0, row), 1);
+
+    tick = 2;
+    arch.mark_written(0, arch.len(), row);
+    EXPECT_EQ(arch.changed_tick(599, row), 2);
+    EXPECT_EQ(arch.block_written_tick(0, row), 2);
+    EXPECT_EQ(arch.block_written_tick(2, row), 2);
+
+    tick = 3;
+    arch.mark_changed(599, row);
+    [[maybe_unused]] auto _ = arch.emplace_back(T1{}, T2{});
+    EXPECT_EQ(arch.added_tick(600, row), 3);
+    EXPECT_EQ(arch.remove(1), 600);
+    EXPECT_EQ(arch.added_tick(1, row), 3);
+    EXPECT_EQ(arch.changed_tick(0, row), 2);
+    arch.swap(1, 599);
+    EXPECT_EQ(arch.changed_tick(599, row), 3);
+    EXPECT_EQ(arch.changed_tick(1, row), 3);
+    EXPECT_EQ(arch.added_tick(1, row), 1);
+    EXPECT_EQ(arch.block_written_tick(0, row), 0);
+    EXPECT_EQ(arch.changed_tick(2, row), 2);
+}
+
+TEST(ArchetypeTagTest, tags_have_no_storage) {
+    const auto infos = get_sorted_infos<Tag, T3, T1>();
+    EXPECT_EQ(infos.back().id, type_id<Tag>());
+    EXPECT_EQ(infos.back().size, 0);
+
+    for (const auto storage : {ArchetypeStorage::contiguous, ArchetypeStorage::chunked, ArchetypeStorage::packed, ArchetypeStorage::mapped}) {
+        Archetype arch(infos, StorageConfig{.storage = storage, .mapped_threshold = 0});
+        EXPECT_EQ(arch.data_row_count(), 2);
+        EXPECT_TRUE(arch.has_component(type_id<Tag>()));
+        for (usize i{0}; i < 100; ++i) {
+            [[maybe_unused]] auto _ = arch.emplace_back(T1{.x = static_cast<f32>(i)}, Tag{}, T3{.x = 1, .y = 2, .floats = {static_cast<f32>(i)}});
+        }
+        EXPECT_EQ(arch.remove(3), 99);
+        arch.swap(0, 3);
+        EXPECT_EQ(arch.get_component<T1>(0).x, 99);
+        EXPECT_EQ(arch.get_component<T3>(3).floats, std::vector<f32>{0});
+        EXPECT_EQ(arch.len(), 99);
+    }
+
+    Archetype only_tags(get_sorted_infos<Tag>(), StorageConfig{.storage = ArchetypeStorage::chunked});
+    EXPECT_EQ(only_tags.storage_mode(), ArchetypeStorage::contiguous);
+    for (usize i{0}; i < 50; ++i) {
+        [[maybe_unused]] auto _ = only_tags.emplace_back(Tag{});
+    }
+    EXPECT_EQ(only_tags.remove(0), 49);
+    EXPECT_EQ(only_tags.len(), 49);
+}
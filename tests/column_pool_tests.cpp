@@ -0,0 +1,83 @@
+#include "column_pool.h"
+#include "world.h"
+
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace nid;
+
+namespace {
+struct Position {
+    f32 x{0}, y{0};
+};
+
+struct Health {
+    f64 value{100};
+};
+
+struct Name {
+    using is_sparse = void;
+    std::vector<char> text;
+};
+} // namespace
+
+TEST(ColumnPoolResourceTest, reuse_and_limit) {
+    ColumnPoolResource pool(4096);
+    void* first = pool.allocate(100, 8);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(first) % ColumnPoolResource::block_alignment, 0);
+    EXPECT_EQ(pool.bytes_in_use(), 128);
+
+    pool.deallocate(first, 100, 8);
+    EXPECT_EQ(pool.bytes_in_use(), 0);
+    EXPECT_EQ(pool.bytes_reserved(), 128);
+
+    // A block of the same class is reused instead of allocated
+    void* second = pool.allocate(120, 16);
+    EXPECT_EQ(second, first);
+    EXPECT_EQ(pool.bytes_reserved(), 128);
+
+    EXPECT_THROW([[maybe_unused]] void* ptr = pool.allocate(4000, 8), std::bad_alloc);
+    void* large = pool.allocate(2048, 8);
+    EXPECT_EQ(pool.bytes_in_use(), 128 + 2048);
+    pool.deallocate(large, 2048, 8);
+    pool.deallocate(second, 120, 16);
+    EXPECT_EQ(pool.bytes_in_use(), 0);
+
+    ColumnPoolResource unpooled;
+    void* huge = unpooled.allocate(2 * ColumnPoolResource::max_pooled_bytes, 8);
+    EXPECT_EQ(unpooled.bytes_reserved(), 2 * ColumnPoolResource::max_pooled_bytes);
+    unpooled.deallocate(huge, 2 * ColumnPoolResource::max_pooled_bytes, 8);
+    EXPECT_EQ(unpooled.bytes_reserved(), 0);
+}
+
+TEST(ColumnPoolResourceTest, world_storage) {
+    ColumnPoolResource pool;
+    for (const auto storage : {ArchetypeStorage::contiguous, ArchetypeStorage::chunked, ArchetypeStorage::packed}) {
+        {
+            World world(StorageConfig{.storage = storage, .resource = &pool});
+            const auto entities = world.spawn_n(10'000, Position{.x = 1, .y = 2});
+            world.add(entities[0], Name{.text = {'a'}});
+            const usize spawned{pool.bytes_in_use()};
+            EXPECT_GT(spawned, 10'000 * sizeof(Position));
+
+            for (usize i{0}; i < entities.size(); i += 2) {
+                world.despawn(entities[i]);
+            }
+            for (usize i{0}; i < 5'000; ++i) {
+                world.spawn(Position{.x = 3, .y = 4});
+            }
+            EXPECT_EQ(world.get<const Position>(entities[1]).y, 2);
+        }
+        EXPECT_EQ(pool.bytes_in_use(), 0);
+    }
+
+    // A capped world fails to grow instead of taking more memory and keeps its entities
+    ColumnPoolResource capped(64 * 1024);
+    World world(StorageConfig{.resource = &capped});
+    const auto entity = world.spawn(Position{.x = 5, .y = 6}, Health{});
+    EXPECT_THROW(world.spawn_n(100'000, Position{}, Health{}), std::bad_alloc);
+    EXPECT_EQ(world.get<const Position>(entity).x, 5);
+}
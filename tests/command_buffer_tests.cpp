@@ -0,0 +1,135 @@
+#include "command_buffer.h"
+#include "identifiers.h"
+#include "world.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace nid;
+
+namespace {
+struct T1 {
+    f32 x{0}, y{0};
+};
+
+struct T2 {
+    f32 x{0}, y{0}, z{0}, w{0};
+};
+
+struct T3 {
+    f32 x{0}, y{0};
+    std::vector<f32> floats;
+};
+
+struct T4 {
+    f64 x{0}, y{0};
+    std::string message;
+};
+
+class CommandBufferTest : public testing::Test {
+  protected:
+    World world;
+    CommandBuffer commands{world};
+    std::vector<EntityId> entities;
+
+    T1 t1{.x = 1, .y = 1};
+    T2 t2{.x = 2, .y = 2, .z = 2, .w = 2};
+    T3 t3{.x = 4, .y = 4, .floats = {1, 2}};
+    T4 t4{.x = 6, .y = 6, .message = "TestMessage"};
+
+    static constexpr usize num{32};
+
+    CommandBufferTest() {
+        for (usize i{0}; i < num; ++i) {
+            entities.emplace_back(world.spawn(t1));
+            entities.emplace_back(world.spawn(t1, t2));
+            entities.emplace_back(world.spawn(t1, t2, t3));
+        }
+    }
+
+    auto count_t1() -> usize {
+        usize count{0};
+        world.query<T1>().run([&](const usize len, [[maybe_unused]] T1* t_1) { count += len; });
+        return count;
+    }
+};
+} // namespace
+
+TEST_F(CommandBufferTest, spawn_during_query) {
+    world.query<T1, T2>().run([&](const usize len, T1* t_1, [[maybe_unused]] T2* t_2) {
+        for (usize i{0}; i < len; ++i) {
+            commands.spawn(T1{.x = t_1[i].x + 1, .y = 0});
+        }
+    });
+    EXPECT_EQ(commands.len(), 2 * num);
+    EXPECT_EQ(count_t1(), 3 * num);
+
+    commands.flush();
+    EXPECT_EQ(commands.len(), 0);
+    EXPECT_EQ(count_t1(), 5 * num);
+}
+
+TEST_F(CommandBufferTest, add_remove_despawn) {
+    for (usize i{0}; i < num; ++i) {
+        commands.add(entities[3 * i], t4);
+        commands.remove<T2>(entities[3 * i + 1]);
+        commands.despawn(entities[3 * i + 2]);
+    }
+    EXPECT_FALSE(world.has<T4>(entities[0]));
+
+    commands.flush();
+    for (usize i{0}; i < num; ++i) {
+        EXPECT_EQ(world.get<T4>(entities[3 * i]).message, t4.message);
+        EXPECT_FALSE(world.has<T2>(entities[3 * i + 1]));
+        EXPECT_FALSE(world.is_alive(entities[3 * i + 2]));
+    }
+    EXPECT_EQ(count_t1(), 2 * num);
+}
+
+TEST_F(CommandBufferTest, entity_order) {
+    const auto ent = entities[2];
+    commands.add(ent, t4);
+    commands.remove<T3>(ent);
+    commands.add(ent, T3{.x = 10, .y = 10, .floats = {10}});
+    commands.remove<T4>(ent);
+    commands.flush();
+
+    EXPECT_FALSE(world.has<T4>(ent));
+    EXPECT_EQ(world.get<T3>(ent).floats, std::vector<f32>{10});
+}
+
+TEST_F(CommandBufferTest, dead_entity) {
+    const auto ent = entities[0];
+    commands.despawn(ent);
+    commands.add(ent, t4);
+    commands.despawn(ent);
+    EXPECT_NO_THROW(commands.flush());
+    EXPECT_FALSE(world.is_alive(ent));
+}
+
+TEST_F(CommandBufferTest, arena_growth) {
+    for (usize round{0}; round < 2; ++round) {
+        for (usize i{0}; i < 4096; ++i) {
+            commands.spawn(t3, T4{.x = 0, .y = 0, .message = std::string(64, 'a')});
+        }
+        commands.flush();
+    }
+
+    usize count{0};
+    world.query<T3, T4>().run([&](const usize len, [[maybe_unused]] T3* t_3, T4* t_4) {
+        for (usize i{0}; i < len; ++i) {
+            EXPECT_EQ(t_4[i].message.size(), 64);
+        }
+        count += len;
+    });
+    EXPECT_EQ(count, 2 * 4096);
+}
+
+TEST_F(CommandBufferTest, unflushed) {
+    CommandBuffer local{world};
+    local.add(entities[0], t3, t4);
+    local.spawn(t4);
+    EXPECT_EQ(local.len(), 2);
+}
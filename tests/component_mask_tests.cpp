@@ -0,0 +1,59 @@
+#include "component_mask.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace nid;
+
+TEST(ComponentMaskTest, set_test_contains) {
+    ComponentMask mask;
+    mask.set(1);
+    mask.set(70);
+    EXPECT_TRUE(mask.test(1));
+    EXPECT_TRUE(mask.test(70));
+    EXPECT_FALSE(mask.test(2));
+    EXPECT_FALSE(mask.test(500));
+    EXPECT_EQ(mask.count(), 2);
+
+    ComponentMask sub;
+    sub.set(70);
+    EXPECT_TRUE(mask.contains(sub));
+    EXPECT_FALSE(sub.contains(mask));
+    EXPECT_TRUE(mask.contains(ComponentMask{}));
+
+    sub.set(1);
+    EXPECT_EQ(mask, sub);
+    sub.set(130);
+    EXPECT_FALSE(mask.contains(sub));
+}
+
+TEST(ComponentMaskTableTest, widen_and_match) {
+    ComponentMaskTable table;
+    std::vector<ComponentMask> masks(200);
+    for (usize i{0}; i < masks.size(); ++i) {
+        masks[i].set(i % 7);
+        masks[i].set(i);
+        table.push_back(masks[i]);
+    }
+    EXPECT_EQ(table.len(), masks.size());
+
+    ComponentMask required;
+    required.set(3);
+    std::vector<usize> matched;
+    table.for_each_match(required, [&](const usize i) { matched.push_back(i); });
+    for (usize i{0}; i < masks.size(); ++i) {
+        EXPECT_EQ(std::ranges::find(matched, i) != matched.end(), masks[i].contains(required));
+    }
+
+    required.set(150);
+    matched.clear();
+    table.for_each_match(required, [&](const usize i) { matched.push_back(i); });
+    EXPECT_EQ(matched, (std::vector<usize>{150}));
+
+    required.set(400);
+    matched.clear();
+    table.for_each_match(required, [&](const usize i) { matched.push_back(i); });
+    EXPECT_TRUE(matched.empty());
+}
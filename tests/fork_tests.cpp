@@ -0,0 +1,170 @@
+#include "world.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace nid;
+
+namespace {
+struct Position {
+    f32 x{0}, y{0};
+};
+
+struct Velocity {
+    f32 x{0}, y{0};
+};
+
+struct Frozen {
+    using is_enableable = void;
+    u32 turns{0};
+};
+
+struct Marked {
+    using is_sparse = void;
+    u32 by{0};
+};
+
+struct Name {
+    std::string text;
+};
+
+struct Enemy {};
+
+struct Unique {
+    std::unique_ptr<i32> value;
+};
+
+auto sum_x(World& world) -> f32 {
+    f32 sum{0};
+    world.query<const Position>().run([&](const usize len, const Position* positions) {
+        for (usize i{0}; i < len; ++i) {
+            sum += positions[i].x;
+        }
+    });
+    return sum;
+}
+} // namespace
+
+TEST(ForkTest, restores_written_blocks) {
+    for (const auto storage : {ArchetypeStorage::contiguous, ArchetypeStorage::chunked, ArchetypeStorage::packed, ArchetypeStorage::mapped}) {
+        World world(StorageConfig{.storage = storage, .mapped_threshold = 0});
+        const auto entities = world.spawn_n(5'000, Position{.x = 1, .y = 1}, Velocity{.x = 2, .y = 2}, Frozen{.turns = 3});
+        const auto named = world.spawn(Position{.x = 4}, Name{.text = "before"});
+        world.disable<Frozen>(entities[10]);
+        const f32 before{sum_x(world)};
+
+        const ForkId id{world.fork()};
+        world.query<Position, const Velocity>().run([](const usize len, Position* positions, const Velocity* velocities) {
+            for (usize i{0}; i < len; ++i) {
+                positions[i].x += velocities[i].x;
+            }
+        });
+        world.get<Velocity>(entities[4'321]).y = 100;
+        world.get<Name>(named).text = "after";
+        world.enable<Frozen>(entities[10]);
+        world.disable<Frozen>(entities[11]);
+        EXPECT_NE(sum_x(world), before);
+
+        world.restore(id);
+        EXPECT_EQ(world.fork_count(), 1);
+        EXPECT_EQ(sum_x(world), before);
+        EXPECT_EQ(world.get<const Velocity>(entities[4'321]).y, 2);
+        EXPECT_EQ(world.get<const Name>(named).text, "before");
+        EXPECT_FALSE(world.is_enabled<Frozen>(entities[10]));
+        EXPECT_TRUE(world.is_enabled<Frozen>(entities[11]));
+
+        // The fork stays alive and can be restored again
+        world.get<Position>(entities[0]).x = 50;
+        world.restore(id);
+        EXPECT_EQ(world.get<const Position>(entities[0]).x, 1);
+    }
+}
+
+TEST(ForkTest, restores_structural_changes) {
+    for (const auto storage : {ArchetypeStorage::contiguous, ArchetypeStorage::chunked}) {
+        World world(StorageConfig{.storage = storage});
+        const auto entities = world.spawn_n(1'000, Position{.x = 1}, Velocity{});
+        world.add(entities[5], Marked{.by = 1});
+        const ForkId id{world.fork()};
+
+        // A write before the first structural change of the table is rolled back with the copy of the table
+        world.get<Position>(entities[0]).x = 7;
+        world.despawn(entities[1]);
+        const auto spawned = world.spawn(Position{.x = 9}, Velocity{});
+        world.add(entities[2], Enemy{});
+        world.remove<Velocity>(entities[3]);
+        world.add(entities[4], Marked{.by = 2});
+        world.remove<Marked>(entities[5]);
+        world.spawn_n(100, Name{.text = "new archetype"});
+        auto enemies = world.query<const Position, const Enemy>();
+        world.add_all(enemies, Frozen{});
+
+        world.restore(id);
+        EXPECT_TRUE(world.is_alive(entities[1]));
+        EXPECT_FALSE(world.is_alive(spawned));
+        EXPECT_EQ(world.get<const Position>(entities[0]).x, 1);
+        EXPECT_FALSE(world.has<Enemy>(entities[2]));
+        EXPECT_TRUE(world.has<Velocity>(entities[3]));
+        EXPECT_FALSE(world.has<Marked>(entities[4]));
+        EXPECT_EQ(world.get<const Marked>(entities[5]).by, 1);
+        EXPECT_EQ(sum_x(world), 1'000);
+
+        usize named{0};
+        world.query<const Name>().run([&](const usize len, const Name*) { named += len; });
+        EXPECT_EQ(named, 0);
+
+        // The restored slots keep working, handles spawned after the fork are never alive again
+        world.despawn(entities[1]);
+        const auto recycled = world.spawn(Position{}, Velocity{});
+        EXPECT_FALSE(world.is_alive(entities[1]));
+        EXPECT_TRUE(world.is_alive(recycled));
+        EXPECT_EQ(sum_x(world), 999);
+    }
+}
+
+TEST(ForkTest, stacked_forks) {
+    World world;
+    const auto entity = world.spawn(Position{.x = 0});
+    const ForkId first{world.fork()};
+    world.get<Position>(entity).x = 1;
+    const ForkId second{world.fork()};
+    world.get<Position>(entity).x = 2;
+    const auto spawned = world.spawn(Position{.x = 3});
+    const ForkId third{world.fork()};
+    world.despawn(entity);
+    EXPECT_EQ(world.fork_count(), 3);
+
+    world.restore(second);
+    EXPECT_EQ(world.fork_count(), 2);
+    EXPECT_EQ(world.get<const Position>(entity).x, 1);
+    EXPECT_FALSE(world.is_alive(spawned));
+    EXPECT_THROW(world.restore(third), std::out_of_range);
+
+    world.get<Position>(entity).x = 5;
+    world.restore(first);
+    EXPECT_EQ(world.get<const Position>(entity).x, 0);
+
+    world.release_fork(first);
+    EXPECT_EQ(world.fork_count(), 0);
+    EXPECT_THROW(world.restore(first), std::out_of_range);
+    world.get<Position>(entity).x = 6;
+    EXPECT_EQ(world.get<const Position>(entity).x, 6);
+
+    // Releasing a fork also releases the older ones
+    const ForkId older{world.fork()};
+    const ForkId newer{world.fork()};
+    world.release_fork(older);
+    EXPECT_EQ(world.fork_count(), 1);
+    world.get<Position>(entity).x = 7;
+    world.restore(newer);
+    EXPECT_EQ(world.get<const Position>(entity).x, 6);
+}
+
+TEST(ForkTest, requires_copyable_components) {
+    World world;
+    world.spawn(Unique{.value = std::make_unique<i32>(1)});
+    EXPECT_THROW(world.fork(), std::logic_error);
+}
@@ -0,0 +1,64 @@
+#include "archetype.h"
+#include "signature.h"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace nid;
+
+TEST(SignatureTest, hash_is_order_sensitive) {
+    const std::array<ComponentId, 3> abc{1, 2, 3};
+    const std::array<ComponentId, 3> cba{3, 2, 1};
+    const std::array<ComponentId, 2> ab{1, 2};
+    EXPECT_NE(signature_hash(abc), signature_hash(cba));
+    EXPECT_NE(signature_hash(abc), signature_hash(ab));
+    EXPECT_NE(signature_hash({}), signature_hash(std::array<ComponentId, 1>{0}));
+    EXPECT_EQ(signature_hash(abc), signature_hash(std::vector<ComponentId>{1, 2, 3}));
+}
+
+TEST(SignatureTest, inline_and_heap_ids) {
+    const std::vector<ComponentId> small{5, 6};
+    const std::vector<ComponentId> large{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+
+    const Signature small_sig(small);
+    Signature large_sig(large);
+    EXPECT_TRUE(small_sig.matches(signature_hash(small), small));
+    EXPECT_TRUE(large_sig.matches(signature_hash(large), large));
+    EXPECT_FALSE(small_sig.matches(signature_hash(large), large));
+    EXPECT_FALSE(large_sig.matches(signature_hash(large), small));
+
+    const Signature moved(std::move(large_sig));
+    EXPECT_EQ(moved.hash(), signature_hash(large));
+    EXPECT_TRUE(std::ranges::equal(moved.ids(), large));
+
+    const Signature empty(std::span<const ComponentId>{});
+    EXPECT_TRUE(empty.matches(signature_hash({}), {}));
+    EXPECT_TRUE(empty.ids().empty());
+}
+
+TEST(SignatureTest, pack_signature_is_sorted) {
+    struct A {};
+    struct B {
+        int x;
+    };
+    struct C {
+        double y;
+    };
+
+    using Abc = PackSignature<A, B, C>;
+    using Cab = PackSignature<C, A, B>;
+    static_assert(Abc::ids == Cab::ids);
+    static_assert(Abc::hash == Cab::hash);
+    static_assert(Abc::hash == signature_hash(Abc::ids));
+
+    std::array<CompTypeInfo, 3> infos{get_component_info<B>(), get_component_info<C>(), get_component_info<A>()};
+    sort_component_list(infos);
+    for (usize i{0}; i < infos.size(); ++i) {
+        EXPECT_EQ(Abc::ids[i], infos[i].id);
+    }
+    EXPECT_NE((pack_sequence<A, B>()), (pack_sequence<B, A>()));
+    EXPECT_EQ((pack_sequence<A, B>()), (pack_sequence<const A&, B&&>()));
+}
@@ -0,0 +1,231 @@
+#include "snapshot.h"
+#include "world.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace nid;
+
+namespace {
+struct Position {
+    f32 x{0}, y{0};
+};
+
+struct Frozen {
+    using is_enableable = void;
+    u32 turns{0};
+};
+
+struct Label {
+    std::string text;
+
+    auto save(SnapshotWriter& out) const -> void {
+        out.write(u64{text.size()});
+        out.write_bytes(text.data(), text.size());
+    }
+
+    static auto load(SnapshotReader& in) -> Label {
+        const auto bytes = in.read_bytes(static_cast<usize>(in.read<u64>()));
+        return Label{.text = std::string(reinterpret_cast<const char*>(bytes.data()), bytes.size())};
+    }
+};
+
+struct Marked {
+    using is_sparse = void;
+    u32 by{0};
+};
+
+struct Enemy {};
+
+struct Unsaved {
+    std::vector<i32> values;
+};
+
+struct Saved {
+    std::vector<i32> values;
+
+    auto save(SnapshotWriter& out) const -> void {
+        out.write(u64{values.size()});
+        out.write_bytes(values.data(), values.size() * sizeof(i32));
+    }
+
+    static auto load(SnapshotReader& in) -> Saved {
+        Saved saved{.values = std::vector<i32>(static_cast<usize>(in.read<u64>()))};
+        const auto bytes = in.read_bytes(saved.values.size() * sizeof(i32));
+        std::copy_n(bytes.data(), bytes.size(), reinterpret_cast<std::byte*>(saved.values.data()));
+        return saved;
+    }
+};
+
+auto snapshot_path(const char* name) -> std::filesystem::path {
+    return std::filesystem::temp_directory_path() / name;
+}
+} // namespace
+
+TEST(SnapshotTest, round_trip) {
+    const auto path = snapshot_path("nidavellir_round_trip.snap");
+    for (const auto storage : {ArchetypeStorage::contiguous, ArchetypeStorage::chunked, ArchetypeStorage::packed, ArchetypeStorage::mapped}) {
+        std::vector<EntityId> entities;
+        EntityId labelled{0};
+        EntityId despawned{0};
+        {
+            World world(StorageConfig{.storage = storage, .mapped_threshold = 0});
+            entities = world.spawn_n(20'000, Position{.x = 1, .y = 2}, Frozen{.turns = 3});
+            for (usize i{0}; i < entities.size(); ++i) {
+                world.get<Position>(entities[i]).x = static_cast<f32>(i);
+            }
+            world.disable<Frozen>(entities[7]);
+            labelled = world.spawn(Position{.x = -1, .y = -1}, Label{.text = "boss"}, Enemy{});
+            world.add(entities[11], Marked{.by = 4});
+            despawned = world.spawn();
+            world.despawn(despawned);
+            world.save(path);
+        }
+
+        World world(StorageConfig{.storage = storage});
+        world.load<Position, Frozen, Label, Marked, Enemy>(path);
+        EXPECT_FALSE(world.is_alive(despawned));
+        EXPECT_EQ(world.get<const Position>(entities[12'345]).x, 12'345);
+        EXPECT_EQ(world.get<const Frozen>(entities[19'999]).turns, 3);
+        EXPECT_FALSE(world.is_enabled<Frozen>(entities[7]));
+        EXPECT_TRUE(world.is_enabled<Frozen>(entities[8]));
+        EXPECT_EQ(world.get<const Label>(labelled).text, "boss");
+        EXPECT_TRUE(world.has<Enemy>(labelled));
+        EXPECT_EQ(world.get<const Marked>(entities[11]).by, 4);
+        EXPECT_FALSE(world.has<Marked>(entities[12]));
+
+        usize matched{0};
+        auto query = world.query<const Position, const Frozen>();
+        query.run([&](const usize len, const Position*, const Frozen*) { matched += len; });
+        EXPECT_EQ(matched, entities.size() - 1);
+
+        // The loaded world keeps working like any other world, recycling the despawned slot first
+        const auto spawned = world.spawn(Position{.x = 5, .y = 5}, Frozen{});
+        EXPECT_EQ(entity_index(spawned), entity_index(despawned));
+        world.despawn(entities[0]);
+        world.add(entities[1], Label{.text = "moved"});
+        EXPECT_EQ(world.get<const Position>(entities[1]).x, 1);
+        EXPECT_EQ(world.get<const Position>(entities[19'999]).x, 19'999);
+        world.spawn_n(50'000, Position{}, Frozen{});
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(SnapshotTest, invalid_snapshots) {
+    const auto path = snapshot_path("nidavellir_invalid.snap");
+    {
+        World world;
+        world.spawn(Position{}, Label{.text = "text"});
+        world.save(path);
+    }
+    {
+        World world;
+        EXPECT_THROW(world.load<Position>(path), std::runtime_error);
+    }
+
+    // A truncated file is detected before any component is read past its end
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 2);
+    {
+        World world;
+        EXPECT_THROW((world.load<Position, Label>(path)), std::runtime_error);
+    }
+
+    {
+        World world;
+        world.spawn(Unsaved{.values = {1}});
+        EXPECT_THROW(world.save(path), std::runtime_error);
+    }
+
+    // A component with the same layout that can not be loaded is rejected instead of being called
+    {
+        World world;
+        world.spawn(Saved{.values = {1}});
+        world.save(path);
+    }
+    {
+        std::string bytes;
+        {
+            std::ifstream file(path, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        }
+        const u64 saved_id{type_id<Saved>()};
+        const u64 unsaved_id{type_id<Unsaved>()};
+        for (usize i{0}; i + sizeof(u64) <= bytes.size(); ++i) {
+            if (std::memcmp(bytes.data() + i, &saved_id, sizeof(u64)) == 0) {
+                std::memcpy(bytes.data() + i, &unsaved_id, sizeof(u64));
+            }
+        }
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+
+        World world;
+        EXPECT_THROW(world.load<Unsaved>(path), std::runtime_error);
+    }
+
+    // A large raw row that is cut off is not mapped past the end of the file
+    {
+        World world(StorageConfig{.storage = ArchetypeStorage::mapped, .mapped_threshold = 0});
+        world.spawn_n(20'000, Position{.x = 1, .y = 2});
+        world.save(path);
+    }
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 4096);
+    {
+        World world(StorageConfig{.storage = ArchetypeStorage::mapped, .mapped_threshold = 0});
+        EXPECT_THROW(world.load<Position>(path), std::runtime_error);
+    }
+
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << "not a snapshot";
+    {
+        World world;
+        EXPECT_THROW(world.load<Position>(path), std::runtime_error);
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(SnapshotTest, invalid_free_list) {
+    const auto path = snapshot_path("nidavellir_free_list.snap");
+    {
+        World world;
+        const auto entities = world.spawn_n(4, Position{.x = 1, .y = 2});
+        world.despawn(entities[1]);
+        world.despawn(entities[2]);
+        world.save(path);
+    }
+    std::string saved;
+    {
+        std::ifstream file(path, std::ios::binary);
+        saved.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    auto encode = [](const u64 count, const std::vector<u32>& values) {
+        std::string bytes(reinterpret_cast<const char*>(&count), sizeof(u64));
+        bytes.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(u32));
+        return bytes;
+    };
+    // The generations of the four slots are followed by the free list
+    const std::string generations{encode(4, {0, 1, 1, 0})};
+    const std::string free_list{encode(2, {1, 2})};
+    const auto at = saved.find(generations + free_list);
+    ASSERT_NE(at, std::string::npos);
+
+    auto load_with = [&](const std::string& replacement) {
+        std::string bytes{saved};
+        bytes.replace(at + generations.size(), free_list.size(), replacement);
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+        World world;
+        world.load<Position>(path);
+    };
+    EXPECT_NO_THROW(load_with(free_list));
+    EXPECT_THROW(load_with(encode(2, {1, 9})), std::runtime_error);
+    EXPECT_THROW(load_with(encode(2, {1, 1})), std::runtime_error);
+    EXPECT_THROW(load_with(encode(2, {1, 0})), std::runtime_error);
+    // Slot 2 is neither free nor placed in a table
+    EXPECT_THROW(load_with(encode(1, {1})), std::runtime_error);
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,60 @@
+#include "thread_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+using namespace nid;
+
+TEST(ThreadPoolTest, parallel_for_all_items) {
+    ThreadPool pool(4);
+    EXPECT_EQ(pool.thread_count(), 4);
+
+    std::vector<std::atomic<usize>> counts(10'000);
+    pool.parallel_for(counts.size(), [&](const usize i) { counts[i].fetch_add(1); });
+    for (const auto& count : counts) {
+        EXPECT_EQ(count.load(), 1);
+    }
+}
+
+TEST(ThreadPoolTest, repeated_loops) {
+    ThreadPool pool(3);
+    std::atomic<usize> sum{0};
+    for (usize round{0}; round < 200; ++round) {
+        pool.parallel_for(round, [&](const usize i) { sum.fetch_add(i); });
+    }
+
+    usize expected{0};
+    for (usize round{0}; round < 200; ++round) {
+        expected += round * (round == 0 ? 0 : round - 1) / 2;
+    }
+    EXPECT_EQ(sum.load(), expected);
+}
+
+TEST(ThreadPoolTest, uneven_work_is_stolen) {
+    ThreadPool pool(4);
+    std::vector<std::thread::id> owners(64);
+    pool.parallel_for(owners.size(), [&](const usize i) {
+        // The items of the first thread are slow, so the other threads have to steal them
+        if (i < owners.size() / 4) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        owners[i] = std::this_thread::get_id();
+    });
+
+    usize stolen{0};
+    for (usize i{1}; i < owners.size() / 4; ++i) {
+        stolen += owners[i] != owners[0] ? 1 : 0;
+    }
+    EXPECT_GT(stolen, 0);
+}
+
+TEST(ThreadPoolTest, single_thread) {
+    ThreadPool pool(1);
+    usize sum{0};
+    pool.parallel_for(100, [&](const usize i) { sum += i; });
+    EXPECT_EQ(sum, 4950);
+}
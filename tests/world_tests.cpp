@@ -1,6 +1,7 @@
 #include "identifiers.h"
 #include "world.h"
 
+#include <atomic>
 #include <stdexcept>
 
 #include "gtest/gtest.h"
@@ -91,6 +92,26 @@ struct T4 {
     std::string message;
 };
 
+struct Burning {
+    using is_sparse = void;
+    f32 damage{0};
+    std::string source;
+};
+
+struct Stunned {
+    using is_sparse = void;
+    u32 ticks{0};
+};
+
+struct Enemy {};
+
+struct Frozen {
+    using is_enableable = void;
+    u32 ticks{0};
+};
+
+struct Boss {};
+
 class EmptyWorldTest : public testing::Test {
   protected:
     World world;
@@ -208,6 +229,84 @@ TEST_F(WorldTest, get_comp_not_found) {
     EXPECT_THROW([[maybe_unused]] auto t_1 = world.get<T1>(ent), std::out_of_range);
 }
 
+TEST_F(WorldTest, get_many) {
+    auto changed = world.query<const T2>();
+    changed.filter<Changed<T2>>();
+    changed.run([](const usize, const T2*) {});
+
+    // Every fourth entity has only T1, the others are spread over three archetypes and requested out of order
+    std::vector<EntityId> ids;
+    for (usize i{entities.size() - 1}; i > 0; --i) {
+        if (i % 4 != 0) {
+            ids.push_back(entities[i]);
+        }
+    }
+    world.add(ids[0], Burning{.damage = 3, .source = "fire"}, Enemy{});
+    world.add(ids[1], Enemy{});
+    world.get<T2>(ids[2]).w = 42;
+
+    std::vector<ComponentPointers<const T1>> singles(ids.size());
+    world.get_many<const T1>(ids, singles);
+    for (usize i{0}; i < ids.size(); ++i) {
+        EXPECT_EQ(singles[i], &world.get<const T1>(ids[i]));
+    }
+
+    std::vector<ComponentPointers<T2, const T1>> pairs(ids.size());
+    world.get_many<T2, const T1>(ids, pairs);
+    EXPECT_EQ(std::get<0>(pairs[2])->w, 42);
+    EXPECT_EQ(std::get<1>(pairs[2]), &world.get<const T1>(ids[2]));
+    usize count{0};
+    changed.run([&](const usize len, const T2*) { count += len; });
+    EXPECT_EQ(count, ids.size());
+
+    std::vector<ComponentPointers<Burning, const Enemy>> extras(1);
+    world.get_many<Burning, const Enemy>(std::span(ids).first(1), extras);
+    EXPECT_THROW((world.get_many<Burning, const Enemy>(std::span(ids).subspan(1, 1), extras)), std::out_of_range);
+    world.add(ids[1], Burning{.damage = 4, .source = "fire"});
+    world.get_many<Burning, const Enemy>(std::span(ids).subspan(1, 1), extras);
+    EXPECT_EQ(std::get<0>(extras[0])->damage, 4);
+    EXPECT_EQ(std::get<1>(extras[0]), &world.get<const Enemy>(ids[1]));
+
+    // Missing components and dead entities throw like get
+    std::vector<ComponentPointers<const T2>> seconds(entities.size());
+    EXPECT_THROW(world.get_many<const T2>(entities, seconds), std::out_of_range);
+    world.despawn(ids[5]);
+    EXPECT_THROW(world.get_many<const T1>(ids, singles), std::out_of_range);
+}
+
+TEST_F(WorldTest, entity_ref) {
+    const auto ent = world.spawn(t1, t2, T4{.x = 20, .y = 30, .message = "RefTest"});
+    auto ref = world.entity_ref(ent);
+    EXPECT_EQ(ref.id(), ent);
+    EXPECT_TRUE((ref.has<T1, T2, T4>()));
+    EXPECT_FALSE(ref.has<T3>());
+    EXPECT_FALSE(ref.has<Burning>());
+    EXPECT_EQ(ref.get<const T4>().message, "RefTest");
+    auto [t_1, t_2] = ref.get<T1, const T2>();
+    t_1.x = 5;
+    EXPECT_EQ(world.get<const T1>(ent).x, 5);
+    EXPECT_EQ(&t_2, &world.get<const T2>(ent));
+    EXPECT_THROW([[maybe_unused]] auto& t_3 = ref.get<T3>(), std::out_of_range);
+
+    // Structural changes to other entities and to the entity itself move it, the reference follows
+    const auto first = world.spawn(t1, t2, t4);
+    world.despawn(entities[3]);
+    world.despawn(first);
+    EXPECT_EQ(ref.get<const T1>().x, 5);
+    world.add(ent, T3{.x = 7, .y = 7, .floats = {}}, Burning{.damage = 2, .source = "torch"});
+    EXPECT_TRUE((ref.has<T3, Burning>()));
+    EXPECT_EQ(ref.get<const T3>().x, 7);
+    EXPECT_EQ(ref.get<const Burning>().damage, 2);
+    world.remove<T2>(ent);
+    EXPECT_FALSE(ref.has<T2>());
+    EXPECT_EQ(ref.get<const T4>().message, "RefTest");
+
+    world.despawn(ent);
+    EXPECT_FALSE(ref.is_alive());
+    EXPECT_THROW([[maybe_unused]] auto has = ref.has<T1>(), std::out_of_range);
+    EXPECT_THROW([[maybe_unused]] auto ref2 = world.entity_ref(ent), std::out_of_range);
+}
+
 TEST_F(WorldTest, add) {
     const auto ent = world.spawn(t1, t2, t3);
     world.add(ent, t4);
@@ -307,4 +406,640 @@ TEST_F(WorldTest, has) {
     EXPECT_TRUE((world.has<T1, T2>(ent)));
     EXPECT_TRUE((world.has<T1>(ent)));
     EXPECT_FALSE((world.has<usize, u32, f32, i8>(ent)));
-}
\ No newline at end of file
+}
+TEST_F(WorldTest, query_run) {
+    usize count{0};
+    world.query<T1, T2>().run([&](const usize len, T1* t_1, T2* t_2) {
+        for (usize i{0}; i < len; ++i) {
+            EXPECT_EQ(t_1[i].x, t1.x);
+            EXPECT_EQ(t_2[i].x, t2.x);
+        }
+        count += len;
+    });
+    EXPECT_EQ(count, 3 * num);
+}
+
+TEST_F(WorldTest, query_rerun) {
+    auto query = world.query<T1>();
+    usize count1{0};
+    query.run([&](const usize len, [[maybe_unused]] T1* t_1) { count1 += len; });
+    usize count2{0};
+    query.run([&](const usize len, [[maybe_unused]] T1* t_1) { count2 += len; });
+    EXPECT_EQ(count1, 4 * num);
+    EXPECT_EQ(count1, count2);
+}
+
+TEST_F(WorldTest, query_new_archetype) {
+    auto query = world.query<T1, T3>();
+    usize count1{0};
+    query.run([&](const usize len, [[maybe_unused]] T1* t_1, [[maybe_unused]] T3* t_3) { count1 += len; });
+    EXPECT_EQ(count1, 2 * num);
+
+    const auto ent = world.spawn(t1, t3);
+    world.add(ent, usize{10});
+
+    usize count2{0};
+    usize tables{0};
+    query.run([&](const usize len, [[maybe_unused]] T1* t_1, [[maybe_unused]] T3* t_3) {
+        count2 += len;
+        ++tables;
+    });
+    EXPECT_EQ(count2, 2 * num + 1);
+    EXPECT_EQ(tables, 3);
+}
+
+TEST_F(WorldTest, query_optional) {
+    usize with_t3{0};
+    usize without_t3{0};
+    world.query<T1, T3>().select(1).optional().run([&](const usize len, [[maybe_unused]] T1* t_1, T3* t_3) {
+        if (t_3 != nullptr) {
+            with_t3 += len;
+        } else {
+            without_t3 += len;
+        }
+    });
+    EXPECT_EQ(with_t3, 2 * num);
+    EXPECT_EQ(without_t3, 2 * num);
+}
+
+TEST_F(WorldTest, add_remove_repeated) {
+    const auto ent = world.spawn(t1, t3);
+    for (usize i{0}; i < 100; ++i) {
+        world.add(ent, T4{.x = static_cast<f64>(i), .y = 0, .message = "Repeated"});
+        EXPECT_EQ(world.get<T4>(ent).x, static_cast<f64>(i));
+        EXPECT_EQ(world.get<T3>(ent).floats, t3.floats);
+
+        world.remove<T4>(ent);
+        EXPECT_FALSE(world.has<T4>(ent));
+        EXPECT_EQ(world.get<T3>(ent).floats, t3.floats);
+    }
+
+    for (usize i{0}; i < num; ++i) {
+        const auto& [t_1, t_2, t_3, t_4] = world.get<T1, T2, T3, T4>(entities[4 * i + 3]);
+        EXPECT_EQ(t_3.x, static_cast<f32>(i));
+        EXPECT_EQ(t_4.message, t4.message);
+    }
+}
+
+TEST_F(WorldTest, remove_keeps_others) {
+    for (usize i{0}; i < num; ++i) {
+        world.remove<T1>(entities[4 * i + 3]);
+    }
+
+    for (usize i{0}; i < num; ++i) {
+        const auto ent = entities[4 * i + 3];
+        EXPECT_FALSE(world.has<T1>(ent));
+        const auto& [t_2, t_3, t_4] = world.get<T2, T3, T4>(ent);
+        EXPECT_EQ(t_2.x, t2.x);
+        EXPECT_EQ(t_3.floats, std::vector<f32>{static_cast<f32>(i)});
+        EXPECT_EQ(t_4.message, t4.message);
+    }
+}
+
+TEST_F(WorldTest, despawn_stale_handle) {
+    const auto ent = entities.back();
+    world.despawn(ent);
+    EXPECT_FALSE(world.is_alive(ent));
+    EXPECT_THROW([[maybe_unused]] auto& t_1 = world.get<T1>(ent), std::out_of_range);
+    EXPECT_THROW([[maybe_unused]] auto h = world.has<T1>(ent), std::out_of_range);
+    EXPECT_THROW(world.add(ent, t2), std::out_of_range);
+
+    const auto recycled = world.spawn(t1);
+    EXPECT_EQ(entity_index(recycled), entity_index(ent));
+    EXPECT_NE(recycled, ent);
+    EXPECT_TRUE(world.is_alive(recycled));
+    EXPECT_FALSE(world.is_alive(ent));
+    EXPECT_THROW(world.despawn(ent), std::out_of_range);
+}
+
+TEST_F(WorldTest, despawn_moves_last) {
+    for (usize i{0}; i < num - 1; ++i) {
+        world.despawn(entities[4 * i + 3]);
+    }
+
+    const auto& t_3 = world.get<T3>(entities[4 * (num - 1) + 3]);
+    EXPECT_EQ(t_3.floats, std::vector<f32>{static_cast<f32>(num - 1)});
+
+    usize count{0};
+    world.query<T4>().run([&](const usize len, [[maybe_unused]] T4* t_4) { count += len; });
+    EXPECT_EQ(count, 1);
+}
+
+TEST_F(EmptyWorldTest, spawn_despawn_churn) {
+    std::vector<EntityId> live;
+    for (usize i{0}; i < num; ++i) {
+        live.push_back(world.spawn(t1));
+    }
+
+    for (usize round{0}; round < 100; ++round) {
+        for (const auto ent : live) {
+            world.despawn(ent);
+        }
+        for (auto& ent : live) {
+            ent = world.spawn(t1, t2);
+            EXPECT_LT(entity_index(ent), num);
+        }
+    }
+}
+
+TEST_F(WorldTest, spawn_n) {
+    const auto batch = world.spawn_n(1000, t1, t4);
+    EXPECT_EQ(batch.size(), 1000);
+    for (const auto ent : batch) {
+        const auto& [t_1, t_4] = world.get<T1, T4>(ent);
+        EXPECT_EQ(t_1.x, t1.x);
+        EXPECT_EQ(t_4.message, t4.message);
+    }
+
+    usize count{0};
+    world.query<T1, T4>().run([&](const usize len, [[maybe_unused]] T1* t_1, [[maybe_unused]] T4* t_4) { count += len; });
+    EXPECT_EQ(count, 1000 + num);
+}
+
+TEST_F(WorldTest, spawn_n_recycled) {
+    for (usize i{0}; i < num; ++i) {
+        world.despawn(entities[4 * i]);
+    }
+
+    const auto batch = world.spawn_n(2 * num, t2);
+    usize recycled{0};
+    for (const auto ent : batch) {
+        EXPECT_TRUE(world.is_alive(ent));
+        EXPECT_EQ(world.get<T2>(ent).w, t2.w);
+        recycled += entity_index(ent) < 4 * num ? 1 : 0;
+    }
+    EXPECT_EQ(recycled, num);
+}
+
+TEST_F(EmptyWorldTest, spawn_batch_spans) {
+    std::vector<T1> t1s(100);
+    std::vector<T3> t3s(100);
+    for (usize i{0}; i < 100; ++i) {
+        t1s[i].x = static_cast<f32>(i);
+        t3s[i].floats = {static_cast<f32>(i)};
+    }
+
+    const auto batch = world.spawn_batch<T1, T3>(t1s, t3s);
+    ASSERT_EQ(batch.size(), 100);
+    for (usize i{0}; i < 100; ++i) {
+        const auto& [t_1, t_3] = world.get<T1, T3>(batch[i]);
+        EXPECT_EQ(t_1.x, static_cast<f32>(i));
+        EXPECT_EQ(t_3.floats, t3s[i].floats);
+    }
+}
+
+TEST_F(EmptyWorldTest, spawn_batch_generator) {
+    const auto batch = world.spawn_batch<T2, T4>(100, [](const usize i) {
+        return std::tuple{T2{.x = static_cast<f32>(i)}, T4{.x = 0, .y = 0, .message = std::to_string(i)}};
+    });
+    ASSERT_EQ(batch.size(), 100);
+    for (usize i{0}; i < 100; ++i) {
+        const auto& [t_2, t_4] = world.get<T2, T4>(batch[i]);
+        EXPECT_EQ(t_2.x, static_cast<f32>(i));
+        EXPECT_EQ(t_4.message, std::to_string(i));
+    }
+}
+
+TEST_F(WorldTest, query_run_parallel) {
+    ThreadPool pool(4);
+    world.set_thread_pool(&pool);
+    world.spawn_n(10'000, t1, t2);
+
+    std::atomic<usize> count{0};
+    world.query<T1, T2>().run_parallel(
+        [&](const usize len, T1* t_1, T2* t_2) {
+            for (usize i{0}; i < len; ++i) {
+                t_1[i].x += t_2[i].x;
+            }
+            count.fetch_add(len);
+        },
+        64);
+    EXPECT_EQ(count.load(), 10'000 + 3 * num);
+
+    world.query<T1>().run([&](const usize len, T1* t_1) {
+        for (usize i{0}; i < len; ++i) {
+            EXPECT_TRUE(t_1[i].x == t1.x or t_1[i].x == t1.x + t2.x);
+        }
+    });
+
+    usize changed{0};
+    world.query<T1, T2>().run([&](const usize len, T1* t_1, [[maybe_unused]] T2* t_2) {
+        for (usize i{0}; i < len; ++i) {
+            changed += t_1[i].x == t1.x + t2.x ? 1 : 0;
+        }
+    });
+    EXPECT_EQ(changed, 10'000 + 3 * num);
+}
+
+TEST(ChunkedWorldTest, spawn_query_move) {
+    World world(StorageConfig{.storage = ArchetypeStorage::chunked, .chunk_bytes = 1024});
+    std::vector<EntityId> ents = world.spawn_n(1000, T1{.x = 1, .y = 1}, T2{.x = 2, .y = 2, .z = 2, .w = 2});
+    for (usize i{0}; i < 100; ++i) {
+        ents.push_back(world.spawn(T1{.x = 1, .y = 1}, T2{.x = 2, .y = 2, .z = 2, .w = 2}));
+    }
+
+    usize count{0};
+    usize runs{0};
+    world.query<T1, T2>().run([&](const usize len, T1* t_1, T2* t_2) {
+        for (usize i{0}; i < len; ++i) {
+            t_1[i].x += t_2[i].x;
+        }
+        count += len;
+        ++runs;
+    });
+    EXPECT_EQ(count, 1100);
+    EXPECT_GT(runs, 1);
+
+    for (usize i{0}; i < ents.size(); i += 3) {
+        world.add(ents[i], T4{.x = 0, .y = 0, .message = std::to_string(i)});
+    }
+    usize despawned{0};
+    for (usize i{1}; i < ents.size(); i += 3) {
+        world.despawn(ents[i]);
+        ++despawned;
+    }
+    for (usize i{0}; i < ents.size(); i += 3) {
+        EXPECT_EQ(world.get<T1>(ents[i]).x, 3);
+        EXPECT_EQ(world.get<T4>(ents[i]).message, std::to_string(i));
+    }
+    for (usize i{2}; i < ents.size(); i += 3) {
+        EXPECT_EQ(world.get<T1>(ents[i]).x, 3);
+    }
+
+    count = 0;
+    world.query<T1>().run([&](const usize len, [[maybe_unused]] T1* t_1) { count += len; });
+    EXPECT_EQ(count, ents.size() - despawned);
+}
+
+TEST(ChunkedWorldTest, spawn_batch_generator_spans_chunks) {
+    World world(StorageConfig{.storage = ArchetypeStorage::chunked, .chunk_bytes = 1024});
+    world.spawn(T2{.x = -1}, T4{.x = 0, .y = 0, .message = "first"});
+    const auto batch = world.spawn_batch<T2, T4>(500, [](const usize i) {
+        return std::tuple{T2{.x = static_cast<f32>(i)}, T4{.x = 0, .y = 0, .message = std::to_string(i)}};
+    });
+    ASSERT_EQ(batch.size(), 500);
+    for (usize i{0}; i < 500; ++i) {
+        const auto& [t_2, t_4] = world.get<T2, T4>(batch[i]);
+        EXPECT_EQ(t_2.x, static_cast<f32>(i));
+        EXPECT_EQ(t_4.message, std::to_string(i));
+    }
+
+    usize runs{0};
+    world.query<const T2>().run([&]([[maybe_unused]] const usize len, [[maybe_unused]] const T2* t_2) { ++runs; });
+    EXPECT_GT(runs, 2);
+}
+
+TEST_F(WorldTest, query_changed_filter) {
+    auto changed = world.query<const T1>();
+    changed.filter<Changed<T1>>();
+    usize count{0};
+    changed.run([&](const usize len, [[maybe_unused]] const T1* t_1) { count += len; });
+    EXPECT_EQ(count, 4 * num);
+
+    count = 0;
+    changed.run([&](const usize len, [[maybe_unused]] const T1* t_1) { count += len; });
+    EXPECT_EQ(count, 0);
+
+    world.get<T1>(entities[5]).x = 100;
+    world.add(entities[9], T1{.x = 200, .y = 0});
+    [[maybe_unused]] const auto& read = world.get<const T1>(entities[13]);
+    std::vector<f32> seen;
+    changed.run([&](const usize len, const T1* t_1) {
+        for (usize i{0}; i < len; ++i) {
+            seen.push_back(t_1[i].x);
+        }
+    });
+    std::ranges::sort(seen);
+    EXPECT_EQ(seen, (std::vector<f32>{100, 200}));
+
+    // A mutable query marks everything it visits
+    world.query<T1, T2>().run([]([[maybe_unused]] const usize len, [[maybe_unused]] T1* t_1, [[maybe_unused]] T2* t_2) {});
+    count = 0;
+    changed.run([&](const usize len, [[maybe_unused]] const T1* t_1) { count += len; });
+    EXPECT_EQ(count, 3 * num);
+
+    // Moving an entity to another table keeps the ticks of its components
+    world.add(entities[0], t4);
+    world.remove<T4>(entities[3]);
+    count = 0;
+    changed.run([&](const usize len, [[maybe_unused]] const T1* t_1) { count += len; });
+    EXPECT_EQ(count, 0);
+}
+
+TEST_F(WorldTest, query_added_filter) {
+    auto added = world.query<const T1, const T2>();
+    added.filter<Added<T2>>();
+    usize count{0};
+    added.run([&](const usize len, [[maybe_unused]] const T1* t_1, [[maybe_unused]] const T2* t_2) { count += len; });
+    EXPECT_EQ(count, 3 * num);
+
+    world.add(entities[0], t2);
+    world.get<T2>(entities[1]).x = 10;
+    world.spawn_n(600, t1, t2);
+    count = 0;
+    added.run([&](const usize len, [[maybe_unused]] const T1* t_1, [[maybe_unused]] const T2* t_2) { count += len; });
+    EXPECT_EQ(count, 601);
+
+    auto both = world.query<const T1, const T2>();
+    both.filter<Added<T1>, Changed<T2>>();
+    both.run([]([[maybe_unused]] const usize len, [[maybe_unused]] const T1* t_1, [[maybe_unused]] const T2* t_2) {});
+    world.add(entities[4], t2);
+    world.get<T2>(entities[1]).x = 20;
+    count = 0;
+    both.run([&](const usize len, [[maybe_unused]] const T1* t_1, [[maybe_unused]] const T2* t_2) { count += len; });
+    EXPECT_EQ(count, 0);
+}
+
+TEST(WorldRegistryTest, independent_indices) {
+    World first;
+    World second;
+    const auto a = first.spawn(T1{.x = 1, .y = 1}, T2{.x = 2, .y = 2, .z = 2, .w = 2});
+    const auto b = second.spawn(T4{.x = 3, .y = 3, .message = "second"});
+    second.add(b, T2{.x = 4, .y = 4, .z = 4, .w = 4});
+
+    EXPECT_TRUE(first.has<T1>(a));
+    EXPECT_FALSE(first.has<T4>(a));
+    EXPECT_FALSE(second.has<T1>(b));
+    EXPECT_TRUE((second.has<T2, T4>(b)));
+    EXPECT_EQ(first.get<T2>(a).x, 2);
+    EXPECT_EQ(second.get<T2>(b).x, 4);
+    EXPECT_EQ(second.get<T4>(b).message, "second");
+    EXPECT_THROW([[maybe_unused]] auto& t_3 = first.get<T3>(a), std::out_of_range);
+}
+
+TEST_F(WorldTest, sparse_add_remove) {
+    const auto entity = entities[3];
+    const T3* t_3 = &world.get<const T3>(entity);
+
+    // Adding and removing sparse components leaves the table components in place
+    world.add(entity, Burning{.damage = 2, .source = "torch"});
+    world.add(entity, Stunned{.ticks = 3}, Burning{.damage = 5, .source = "lava"});
+    EXPECT_EQ(&world.get<const T3>(entity), t_3);
+    EXPECT_TRUE((world.has<T1, Burning, Stunned>(entity)));
+    EXPECT_FALSE(world.has<Burning>(entities[2]));
+    EXPECT_EQ(world.get<Burning>(entity).source, "lava");
+    EXPECT_EQ((std::get<1>(world.get<const T4, const Stunned>(entity)).ticks), 3);
+
+    world.remove<Burning>(entity);
+    EXPECT_EQ(&world.get<const T3>(entity), t_3);
+    EXPECT_FALSE(world.has<Burning>(entity));
+    EXPECT_THROW([[maybe_unused]] auto& burning = world.get<Burning>(entity), std::out_of_range);
+
+    // Mixed packs move the entity for the table components only
+    world.add(entities[0], T2{.x = 7, .y = 7, .z = 7, .w = 7}, Burning{.damage = 1, .source = "spark"});
+    EXPECT_EQ(world.get<T2>(entities[0]).x, 7);
+    EXPECT_EQ(world.get<Burning>(entities[0]).damage, 1);
+    world.remove<T2, Burning>(entities[0]);
+    EXPECT_FALSE((world.has<T2>(entities[0]) or world.has<Burning>(entities[0])));
+
+    const auto spawned = world.spawn(t1, Stunned{.ticks = 9});
+    EXPECT_EQ(world.get<Stunned>(spawned).ticks, 9);
+    EXPECT_EQ(world.get<T1>(spawned).x, 1);
+
+    // A recycled slot does not inherit the sparse components of the despawned entity
+    world.despawn(spawned);
+    const auto recycled = world.spawn(t1);
+    EXPECT_FALSE(world.has<Stunned>(recycled));
+    EXPECT_TRUE(world.has<Stunned>(entity));
+}
+
+TEST_F(WorldTest, sparse_query_join) {
+    for (usize i{0}; i < entities.size(); i += 3) {
+        world.add(entities[i], Burning{.damage = static_cast<f32>(i), .source = "fire"});
+    }
+
+    usize count{0};
+    f32 damage{0};
+    world.query<const T2, Burning>().run([&](const usize len, const T2* t_2, Burning* burning) {
+        EXPECT_EQ(len, 1);
+        EXPECT_EQ(t_2->x, 2);
+        burning->damage += 1;
+        damage += burning->damage;
+        ++count;
+    });
+
+    usize expected_count{0};
+    f32 expected_damage{0};
+    for (usize i{0}; i < entities.size(); i += 3) {
+        if (world.has<T2>(entities[i])) {
+            ++expected_count;
+            expected_damage += static_cast<f32>(i) + 1;
+            EXPECT_EQ(world.get<const Burning>(entities[i]).damage, static_cast<f32>(i) + 1);
+        }
+    }
+    EXPECT_EQ(count, expected_count);
+    EXPECT_EQ(damage, expected_damage);
+
+    // An optional sparse component is visited through the tables
+    usize burning_count{0};
+    count = 0;
+    auto optional = world.query<const T1, const Burning>();
+    optional.select(1).optional();
+    optional.run([&](const usize len, [[maybe_unused]] const T1* t_1, const Burning* burning) {
+        count += len;
+        burning_count += burning != nullptr ? 1 : 0;
+    });
+    EXPECT_EQ(count, entities.size());
+    EXPECT_EQ(burning_count, (entities.size() + 2) / 3);
+}
+
+TEST_F(WorldTest, tag_components) {
+    for (usize i{0}; i < entities.size(); i += 2) {
+        world.add(entities[i], Enemy{});
+    }
+    world.add(entities[1], Enemy{}, Boss{});
+    const auto spawned = world.spawn(Boss{}, t1, Enemy{});
+    const auto batch = world.spawn_n(10, Enemy{}, t2);
+
+    EXPECT_TRUE((world.has<Enemy, Boss, T1>(spawned)));
+    EXPECT_TRUE((world.has<Enemy, T2>(batch[3])));
+    EXPECT_EQ(world.get<T2>(batch[9]).w, 2);
+    EXPECT_EQ(&world.get<Enemy>(entities[0]), &world.get<Enemy>(entities[2]));
+    EXPECT_THROW([[maybe_unused]] auto& enemy = world.get<Enemy>(entities[3]), std::out_of_range);
+
+    usize count{0};
+    world.query<const T1, Enemy>().run([&](const usize len, const T1* t_1, Enemy* enemy) {
+        EXPECT_NE(enemy, nullptr);
+        EXPECT_EQ(t_1[len - 1].y, 1);
+        count += len;
+    });
+    EXPECT_EQ(count, entities.size() / 2 + 2);
+
+    usize bosses{0};
+    count = 0;
+    auto optional = world.query<const Enemy, const Boss>();
+    optional.select(1).optional();
+    optional.run([&](const usize len, [[maybe_unused]] const Enemy* enemy, const Boss* boss) {
+        count += len;
+        bosses += boss != nullptr ? len : 0;
+    });
+    EXPECT_EQ(count, entities.size() / 2 + 2 + batch.size());
+    EXPECT_EQ(bosses, 2);
+
+    // Removing a tag moves the data of the entity but keeps its values
+    world.remove<Enemy>(entities[2]);
+    EXPECT_FALSE(world.has<Enemy>(entities[2]));
+    EXPECT_EQ(world.get<const T2>(entities[2]).z, 2);
+    EXPECT_EQ(world.get<T3>(entities[2]).floats, (std::vector<f32>{1, 2}));
+    world.remove<Enemy, Boss>(spawned);
+    EXPECT_EQ(world.get<T1>(spawned).x, 1);
+}
+
+TEST_F(WorldTest, enableable_components) {
+    std::vector<EntityId> entities;
+    for (u32 i{0}; i < 200; ++i) {
+        entities.push_back(world.spawn(t1, Frozen{.ticks = i}));
+    }
+    for (usize i{0}; i < entities.size(); i += 3) {
+        world.disable<Frozen>(entities[i]);
+    }
+    EXPECT_FALSE(world.is_enabled<Frozen>(entities[0]));
+    EXPECT_TRUE(world.is_enabled<Frozen>(entities[1]));
+    EXPECT_EQ(world.get<Frozen>(entities[3]).ticks, 3);
+    EXPECT_THROW(world.disable<Frozen>(world.spawn(t1)), std::out_of_range);
+
+    auto sum_enabled = [&] {
+        u64 sum{0};
+        usize count{0};
+        world.query<const Frozen, const T1>().run([&](const usize len, const Frozen* frozen, [[maybe_unused]] const T1* t_1) {
+            for (usize i{0}; i < len; ++i) {
+                sum += frozen[i].ticks;
+            }
+            count += len;
+        });
+        return std::pair{count, sum};
+    };
+    u64 expected_sum{0};
+    usize expected_count{0};
+    for (u32 i{0}; i < 200; ++i) {
+        if (i % 3 != 0) {
+            expected_sum += i;
+            ++expected_count;
+        }
+    }
+    EXPECT_EQ(sum_enabled(), std::pair(expected_count, expected_sum));
+
+    // Moving an entity to another archetype and filling its hole keeps the bits
+    world.add(entities[0], t2);
+    world.add(entities[1], t2);
+    EXPECT_FALSE(world.is_enabled<Frozen>(entities[0]));
+    EXPECT_TRUE(world.is_enabled<Frozen>(entities[1]));
+    EXPECT_FALSE(world.is_enabled<Frozen>(entities[198]));
+    world.despawn(entities[2]);
+    EXPECT_FALSE(world.is_enabled<Frozen>(entities[99]));
+    EXPECT_EQ(sum_enabled(), std::pair(expected_count - 1, expected_sum - 2));
+
+    world.enable<Frozen>(entities[0]);
+    EXPECT_EQ(sum_enabled(), std::pair(expected_count, expected_sum - 2));
+
+    // A disabled optional component is passed as nullptr
+    usize with_t1{0};
+    world.query<const T1>().run([&](const usize len, [[maybe_unused]] const T1* t_1) { with_t1 += len; });
+    usize with_frozen{0};
+    usize count{0};
+    auto optional = world.query<const T1, const Frozen>();
+    optional.select(1).optional();
+    optional.run([&](const usize len, [[maybe_unused]] const T1* t_1, const Frozen* frozen) {
+        count += len;
+        with_frozen += frozen != nullptr ? len : 0;
+    });
+    EXPECT_EQ(count, with_t1);
+    EXPECT_EQ(with_frozen, expected_count);
+}
+
+TEST(WorldBulkTest, add_remove_despawn_all) {
+    for (const auto storage : {ArchetypeStorage::contiguous, ArchetypeStorage::chunked, ArchetypeStorage::packed, ArchetypeStorage::mapped}) {
+        World world(StorageConfig{.storage = storage, .mapped_threshold = 0});
+        const T1 t1{.x = 1, .y = 1};
+        const T2 t2{.x = 2, .y = 2, .z = 2, .w = 2};
+        const T3 t3{.x = 4, .y = 4, .floats = {1, 2}};
+
+        // {T1, T2, T4} is not empty, {T1, T3, T4} and {T1, T2, T4, Frozen} are
+        const auto with_t4 = world.spawn_n(5, t1, t2, T4{.x = 1, .y = 1, .message = "old"});
+        const auto with_t2 = world.spawn_n(300, t1, t2);
+        const auto with_t3 = world.spawn_n(50, t1, t3);
+        const auto frozen = world.spawn_n(20, t1, t2, Frozen{.ticks = 3});
+        const auto without_t1 = world.spawn_n(10, t2);
+        for (usize i{0}; i < frozen.size(); i += 2) {
+            world.disable<Frozen>(frozen[i]);
+        }
+
+        auto with_t1 = world.query<const T1>();
+        EXPECT_EQ(world.add_all(with_t1, T4{.x = 7, .y = 7, .message = "bulk"}, Burning{.damage = 1, .source = "lava"}), 375);
+        for (const auto* group : {&with_t4, &with_t2, &with_t3, &frozen}) {
+            for (const auto entity : *group) {
+                EXPECT_EQ(world.get<const T4>(entity).message, "bulk");
+                EXPECT_EQ(world.get<const Burning>(entity).source, "lava");
+                EXPECT_EQ(world.get<const T1>(entity).x, 1);
+            }
+        }
+        EXPECT_EQ(world.get<const T2>(with_t2[299]).w, 2);
+        EXPECT_EQ(world.get<const T3>(with_t3[49]).floats, (std::vector<f32>{1, 2}));
+        EXPECT_FALSE(world.is_enabled<Frozen>(frozen[0]));
+        EXPECT_TRUE(world.is_enabled<Frozen>(frozen[1]));
+        EXPECT_EQ(world.get<const Frozen>(frozen[19]).ticks, 3);
+        EXPECT_FALSE((world.has<T4>(without_t1[0])));
+
+        usize count{0};
+        world.query<const T1, const T4>().run([&](const usize len, const T1*, const T4*) { count += len; });
+        EXPECT_EQ(count, 375);
+
+        auto with_t2_query = world.query<const T2>();
+        EXPECT_EQ((world.remove_all<T2, Burning>(with_t2_query)), 335);
+        EXPECT_FALSE((world.has<T2>(with_t2[0])));
+        EXPECT_FALSE((world.has<Burning>(with_t2[0])));
+        EXPECT_TRUE((world.has<T1, T4>(with_t2[0])));
+        EXPECT_TRUE((world.has<Burning>(with_t3[0])));
+        EXPECT_EQ(world.get<const T1>(frozen[4]).y, 1);
+
+        auto with_t4_query = world.query<const T4>();
+        EXPECT_EQ(world.despawn_all(with_t4_query), 375);
+        EXPECT_FALSE(world.is_alive(with_t3[0]));
+        EXPECT_FALSE(world.is_alive(frozen[19]));
+        EXPECT_TRUE(world.is_alive(without_t1[9]));
+
+        count = 0;
+        world.query<const Burning>().run([&](const usize len, const Burning*) { count += len; });
+        EXPECT_EQ(count, 0);
+
+        const auto respawned = world.spawn(t1, T4{.x = 2, .y = 2, .message = "new"});
+        EXPECT_EQ(world.get<const T4>(respawned).message, "new");
+        EXPECT_EQ(world.despawn_all(with_t4_query), 1);
+    }
+}
+
+TEST(WorldBulkTest, incremental_growth) {
+    World world(StorageConfig{.migration_step = 4});
+    std::vector<EntityId> entities;
+    for (usize i{0}; i < 82; ++i) {
+        entities.push_back(world.spawn(T1{.x = static_cast<f32>(i), .y = 0}, T4{.x = 0, .y = 0, .message = std::to_string(i)}));
+    }
+    auto expect_components = [&] {
+        for (usize i{0}; i < entities.size(); ++i) {
+            EXPECT_EQ(world.get<const T1>(entities[i]).x, static_cast<f32>(i));
+            EXPECT_EQ(world.get<const T4>(entities[i]).message, std::to_string(i));
+        }
+    };
+
+    // The tables are moved while their last growth is still pending
+    const ForkId id{world.fork()};
+    auto with_t1 = world.query<const T1>();
+    EXPECT_EQ(world.add_all(with_t1, T2{.x = 1, .y = 1, .z = 1, .w = 1}), 82);
+    expect_components();
+
+    std::vector<EntityId> spawned;
+    for (usize i{0}; i < 82; ++i) {
+        spawned.push_back(world.spawn(T1{.x = -1, .y = 0}, T4{.x = 0, .y = 0, .message = "spawned"}));
+    }
+    auto with_t2 = world.query<const T2>();
+    EXPECT_EQ(world.remove_all<T2>(with_t2), 82);
+    expect_components();
+    EXPECT_EQ(world.get<const T4>(spawned[81]).message, "spawned");
+
+    world.restore(id);
+    expect_components();
+    EXPECT_FALSE(world.is_alive(spawned[0]));
+    usize count{0};
+    world.query<const T1, const T4>().run([&](const usize len, const T1*, const T4*) { count += len; });
+    EXPECT_EQ(count, 82);
+}